@@ -12,6 +12,12 @@ namespace kestr::engine {
         std::string project_root;
     };
 
+    // How embedding vectors are compared
+    enum class Metric {
+        L2,     // Euclidean distance on the raw vectors
+        Cosine  // Inner product on unit-normalized vectors
+    };
+
     struct SearchFilters {
         std::string type_filter;
         std::string language;
@@ -28,6 +34,9 @@ namespace kestr::engine {
         std::string symbol_type;
         std::string project_root;
         std::string language;
+
+        // SHA-256 of content, used to skip re-embedding unchanged chunks
+        std::string content_hash;
     };
 
 }
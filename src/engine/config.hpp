@@ -12,7 +12,7 @@ namespace kestr::engine {
         enum class MemoryMode {
             RAM,    // Load all vectors into memory (Fastest)
             HYBRID, // Load limited subset into memory
-            DISK    // Do not load vectors (Keyword search only, lowest RAM)
+            DISK    // Serve the vector index from a memory-mapped file (lowest RAM)
         };
 
         MemoryMode memory_mode = MemoryMode::RAM;
@@ -22,6 +22,50 @@ namespace kestr::engine {
         std::string openai_key = "";
         std::vector<std::string> watch_paths;
 
+        // Indexing pipeline thread counts per stage (0 = pick from hardware_concurrency)
+        size_t read_threads = 0;
+        size_t parse_threads = 0;
+        size_t embed_threads = 0;
+
+        // Content-addressed embedding cache: rows kept in SQLite (0 = off) and vectors kept in RAM
+        size_t embedding_cache_limit = 200000;
+        size_t embedding_cache_size = 10000;
+
+        // ONNX Runtime profile for the local embedder (see OnnxOptions)
+        size_t onnx_intra_op_threads = 0;
+        size_t onnx_inter_op_threads = 1;
+        bool onnx_allow_spinning = false;
+        bool onnx_memory_arena = true;
+        size_t onnx_workers = 1;
+        bool onnx_save_optimized = true;
+        size_t onnx_max_tokens = 256;
+        // Use model.int8.onnx (written by `kestrd prepare-model`) when it exists
+        bool onnx_quantized = true;
+        // Query text -> embedding, and query + limit + filters -> result IDs until the next commit (0 = off)
+        size_t query_cache_size = 1000;
+        size_t result_cache_size = 1000;
+        // Threads that search the per-project index shards in parallel (0 = one per core)
+        size_t search_threads = 0;
+
+        // Seconds between HNSW snapshot checkpoints (0 = only on shutdown)
+        size_t snapshot_interval = 300;
+
+        // Vector storage in the librarian: "none" (fp32) or "int8" (scalar quantized)
+        std::string vector_quantization = "none";
+        // Quantized search fetches k * rerank_factor candidates and reranks them in fp32 (0 = off)
+        size_t rerank_factor = 4;
+
+        // Similarity for semantic search: "auto" (what the embedder was trained for), "cosine" or "l2"
+        std::string vector_metric = "auto";
+
+        // Vector index backend: "hnsw" (graph) or "ivfpq" (inverted lists of product-quantized codes)
+        std::string index_backend = "hnsw";
+        // HNSW shards with fewer chunks than this are searched by an exact scan until they grow past it (0 = never)
+        size_t exact_search_limit = 20000;
+        size_t ivf_nlist = 1024;  // Coarse clusters
+        size_t ivf_nprobe = 16;   // Clusters scanned per query
+        size_t pq_m = 32;         // Bytes per stored vector
+
         static Config load(const std::filesystem::path& path) {
             Config cfg;
             if (!std::filesystem::exists(path)) return cfg;
@@ -40,6 +84,31 @@ namespace kestr::engine {
                 if (j.contains("embedding_backend")) cfg.embedding_backend = j["embedding_backend"];
                 if (j.contains("openai_key")) cfg.openai_key = j["openai_key"];
                 if (j.contains("watch_paths")) cfg.watch_paths = j["watch_paths"].get<std::vector<std::string>>();
+                if (j.contains("read_threads")) cfg.read_threads = j["read_threads"];
+                if (j.contains("parse_threads")) cfg.parse_threads = j["parse_threads"];
+                if (j.contains("embed_threads")) cfg.embed_threads = j["embed_threads"];
+                if (j.contains("embedding_cache_limit")) cfg.embedding_cache_limit = j["embedding_cache_limit"];
+                if (j.contains("embedding_cache_size")) cfg.embedding_cache_size = j["embedding_cache_size"];
+                if (j.contains("onnx_intra_op_threads")) cfg.onnx_intra_op_threads = j["onnx_intra_op_threads"];
+                if (j.contains("onnx_inter_op_threads")) cfg.onnx_inter_op_threads = j["onnx_inter_op_threads"];
+                if (j.contains("onnx_allow_spinning")) cfg.onnx_allow_spinning = j["onnx_allow_spinning"];
+                if (j.contains("onnx_memory_arena")) cfg.onnx_memory_arena = j["onnx_memory_arena"];
+                if (j.contains("onnx_workers")) cfg.onnx_workers = j["onnx_workers"];
+                if (j.contains("onnx_save_optimized")) cfg.onnx_save_optimized = j["onnx_save_optimized"];
+                if (j.contains("onnx_max_tokens")) cfg.onnx_max_tokens = j["onnx_max_tokens"];
+                if (j.contains("onnx_quantized")) cfg.onnx_quantized = j["onnx_quantized"];
+                if (j.contains("query_cache_size")) cfg.query_cache_size = j["query_cache_size"];
+                if (j.contains("result_cache_size")) cfg.result_cache_size = j["result_cache_size"];
+                if (j.contains("search_threads")) cfg.search_threads = j["search_threads"];
+                if (j.contains("snapshot_interval")) cfg.snapshot_interval = j["snapshot_interval"];
+                if (j.contains("vector_quantization")) cfg.vector_quantization = j["vector_quantization"];
+                if (j.contains("rerank_factor")) cfg.rerank_factor = j["rerank_factor"];
+                if (j.contains("vector_metric")) cfg.vector_metric = j["vector_metric"];
+                if (j.contains("index_backend")) cfg.index_backend = j["index_backend"];
+                if (j.contains("exact_search_limit")) cfg.exact_search_limit = j["exact_search_limit"];
+                if (j.contains("ivf_nlist")) cfg.ivf_nlist = j["ivf_nlist"];
+                if (j.contains("ivf_nprobe")) cfg.ivf_nprobe = j["ivf_nprobe"];
+                if (j.contains("pq_m")) cfg.pq_m = j["pq_m"];
             } catch (...) {}
             return cfg;
         }
@@ -53,6 +122,31 @@ namespace kestr::engine {
             j["embedding_backend"] = embedding_backend;
             if (!openai_key.empty()) j["openai_key"] = openai_key;
             j["watch_paths"] = watch_paths;
+            j["read_threads"] = read_threads;
+            j["parse_threads"] = parse_threads;
+            j["embed_threads"] = embed_threads;
+            j["embedding_cache_limit"] = embedding_cache_limit;
+            j["embedding_cache_size"] = embedding_cache_size;
+            j["onnx_intra_op_threads"] = onnx_intra_op_threads;
+            j["onnx_inter_op_threads"] = onnx_inter_op_threads;
+            j["onnx_allow_spinning"] = onnx_allow_spinning;
+            j["onnx_memory_arena"] = onnx_memory_arena;
+            j["onnx_workers"] = onnx_workers;
+            j["onnx_save_optimized"] = onnx_save_optimized;
+            j["onnx_max_tokens"] = onnx_max_tokens;
+            j["onnx_quantized"] = onnx_quantized;
+            j["query_cache_size"] = query_cache_size;
+            j["result_cache_size"] = result_cache_size;
+            j["search_threads"] = search_threads;
+            j["snapshot_interval"] = snapshot_interval;
+            j["vector_quantization"] = vector_quantization;
+            j["rerank_factor"] = rerank_factor;
+            j["vector_metric"] = vector_metric;
+            j["index_backend"] = index_backend;
+            j["exact_search_limit"] = exact_search_limit;
+            j["ivf_nlist"] = ivf_nlist;
+            j["ivf_nprobe"] = ivf_nprobe;
+            j["pq_m"] = pq_m;
 
             std::ofstream f(path);
             f << j.dump(4);
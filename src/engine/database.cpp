@@ -2,6 +2,9 @@
 #include <iostream>
 #include <chrono>
 #include <cstring>
+#include <cstdlib>
+#include <unordered_map>
+#include <algorithm>
 
 namespace kestr::engine {
 
@@ -18,11 +21,32 @@ namespace kestr::engine {
 
     void Database::close() {
         if (m_db) {
+            finalize_statements();
             sqlite3_close(m_db);
             m_db = nullptr;
         }
     }
 
+    Database::Statement Database::prepare(const std::string& sql) {
+        auto it = m_statements.find(sql);
+        if (it != m_statements.end()) return Statement(it->second);
+
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v3(m_db, sql.c_str(), -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK) {
+            std::cerr << "[Database] Prepare failed: " << sqlite3_errmsg(m_db) << "\n";
+            return Statement(nullptr);
+        }
+        m_statements.emplace(sql, stmt);
+        return Statement(stmt);
+    }
+
+    void Database::finalize_statements() {
+        for (auto& [sql, stmt] : m_statements) {
+            sqlite3_finalize(stmt);
+        }
+        m_statements.clear();
+    }
+
     bool Database::initialize_schema() {
         // Enable WAL mode and optimize for performance
         sqlite3_exec(m_db, "PRAGMA journal_mode=WAL;", nullptr, nullptr, nullptr);
@@ -51,6 +75,8 @@ namespace kestr::engine {
             "  project_root TEXT,"
             "  language TEXT,"
             "  embedding BLOB,"
+            "  content_hash TEXT,"
+            "  generation INTEGER,"
             "  FOREIGN KEY(file_id) REFERENCES files(id) ON DELETE CASCADE"
             ");"
             "CREATE TABLE IF NOT EXISTS symbol_links ("
@@ -60,6 +86,18 @@ namespace kestr::engine {
             "  link_type TEXT,"
             "  FOREIGN KEY(from_chunk_id) REFERENCES chunks(id) ON DELETE CASCADE"
             ");"
+            "CREATE TABLE IF NOT EXISTS chunk_tombstones ("
+            "  chunk_id INTEGER PRIMARY KEY,"
+            "  generation INTEGER"
+            ");"
+            "CREATE TABLE IF NOT EXISTS meta ("
+            "  key TEXT PRIMARY KEY,"
+            "  value TEXT"
+            ");"
+            "CREATE TABLE IF NOT EXISTS embedding_cache ("
+            "  key TEXT PRIMARY KEY,"
+            "  embedding BLOB"
+            ");"
             "CREATE VIRTUAL TABLE IF NOT EXISTS chunks_fts USING fts5(content);";
         char* err_msg = nullptr;
         if (sqlite3_exec(m_db, sql, nullptr, nullptr, &err_msg) != SQLITE_OK) {
@@ -74,7 +112,9 @@ namespace kestr::engine {
             "ALTER TABLE chunks ADD COLUMN symbol_type TEXT;",
             "ALTER TABLE chunks ADD COLUMN project_root TEXT;",
             "ALTER TABLE chunks ADD COLUMN language TEXT;",
-            "ALTER TABLE files ADD COLUMN project_root TEXT;"
+            "ALTER TABLE files ADD COLUMN project_root TEXT;",
+            "ALTER TABLE chunks ADD COLUMN content_hash TEXT;",
+            "ALTER TABLE chunks ADD COLUMN generation INTEGER;"
         };
 
         for (const char* m_sql : migration_sql) {
@@ -82,41 +122,44 @@ namespace kestr::engine {
             // We ignore errors here because the columns might already exist
         }
 
+        sqlite3_exec(m_db, "CREATE INDEX IF NOT EXISTS idx_chunks_file ON chunks(file_id);", nullptr, nullptr, nullptr);
+        sqlite3_exec(m_db, "CREATE INDEX IF NOT EXISTS idx_chunks_generation ON chunks(generation);", nullptr, nullptr, nullptr);
+
+        // Generations start at 1 so rows written before the column existed (NULL) sort first
+        m_generation = std::max<int64_t>(1, std::strtoll(get_meta("generation", "1").c_str(), nullptr, 10));
         return true;
     }
 
     bool Database::check_metadata(const std::filesystem::path& path, std::uintmax_t size, int64_t mtime) {
-        const char* sql = "SELECT size, last_modified FROM files WHERE path = ?;";
-        sqlite3_stmt* stmt;
         bool changed = true;
-
-        if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
-            sqlite3_bind_text(stmt, 1, path.string().c_str(), -1, SQLITE_STATIC);
-            if (sqlite3_step(stmt) == SQLITE_ROW) {
-                std::uintmax_t db_size = sqlite3_column_int64(stmt, 0);
-                int64_t db_mtime = sqlite3_column_int64(stmt, 1);
-                changed = (db_size != size || db_mtime != mtime);
+        std::string path_str = path.string();
+
+        if (auto stmt = prepare("SELECT size, last_modified, is_indexed FROM files WHERE path = ?;")) {
+            sqlite3_bind_text(stmt.get(), 1, path_str.c_str(), -1, SQLITE_STATIC);
+            if (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+                std::uintmax_t db_size = sqlite3_column_int64(stmt.get(), 0);
+                int64_t db_mtime = sqlite3_column_int64(stmt.get(), 1);
+                // Not indexed: its write never committed, or the chunks were wiped for a new model
+                bool indexed = sqlite3_column_int(stmt.get(), 2) != 0;
+                changed = (db_size != size || db_mtime != mtime || !indexed);
             }
-            sqlite3_finalize(stmt);
         }
         return changed;
     }
 
     bool Database::needs_indexing(const std::filesystem::path& path, const std::string& current_hash) {
-        const char* sql = "SELECT hash FROM files WHERE path = ?;";
-        sqlite3_stmt* stmt;
         bool needs = true;
+        std::string path_str = path.string();
 
-        if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
-            sqlite3_bind_text(stmt, 1, path.string().c_str(), -1, SQLITE_STATIC);
-            if (sqlite3_step(stmt) == SQLITE_ROW) {
-                const unsigned char* text = sqlite3_column_text(stmt, 0);
+        if (auto stmt = prepare("SELECT hash FROM files WHERE path = ?;")) {
+            sqlite3_bind_text(stmt.get(), 1, path_str.c_str(), -1, SQLITE_STATIC);
+            if (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+                const unsigned char* text = sqlite3_column_text(stmt.get(), 0);
                 if (text) {
                     std::string db_hash = reinterpret_cast<const char*>(text);
                     needs = (db_hash != current_hash);
                 }
             }
-            sqlite3_finalize(stmt);
         }
         return needs;
     }
@@ -132,130 +175,300 @@ namespace kestr::engine {
             "is_indexed = 0, "
             "project_root = excluded.project_root;";
 
-        sqlite3_stmt* stmt;
-        if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) != SQLITE_OK) return false;
+        auto stmt = prepare(sql);
+        if (!stmt) return false;
 
-        sqlite3_bind_text(stmt, 1, info.path.string().c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 2, info.hash.c_str(), -1, SQLITE_STATIC);
+        std::string path_str = info.path.string();
+        sqlite3_bind_text(stmt.get(), 1, path_str.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt.get(), 2, info.hash.c_str(), -1, SQLITE_STATIC);
         
         auto duration = info.last_write_time.time_since_epoch();
         auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
-        sqlite3_bind_int64(stmt, 3, millis);
-        sqlite3_bind_int64(stmt, 4, info.size);
-        sqlite3_bind_text(stmt, 5, info.project_root.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int64(stmt.get(), 3, millis);
+        sqlite3_bind_int64(stmt.get(), 4, info.size);
+        sqlite3_bind_text(stmt.get(), 5, info.project_root.c_str(), -1, SQLITE_STATIC);
 
-        bool success = (sqlite3_step(stmt) == SQLITE_DONE);
-        sqlite3_finalize(stmt);
-        return success;
+        return sqlite3_step(stmt.get()) == SQLITE_DONE;
     }
 
     bool Database::set_indexed_status(const std::filesystem::path& path, bool indexed) {
-        const char* sql = "UPDATE files SET is_indexed = ? WHERE path = ?;";
-        sqlite3_stmt* stmt;
-        if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) != SQLITE_OK) return false;
+        auto stmt = prepare("UPDATE files SET is_indexed = ? WHERE path = ?;");
+        if (!stmt) return false;
 
-        sqlite3_bind_int(stmt, 1, indexed ? 1 : 0);
-        sqlite3_bind_text(stmt, 2, path.string().c_str(), -1, SQLITE_STATIC);
+        std::string path_str = path.string();
+        sqlite3_bind_int(stmt.get(), 1, indexed ? 1 : 0);
+        sqlite3_bind_text(stmt.get(), 2, path_str.c_str(), -1, SQLITE_STATIC);
 
-        bool success = (sqlite3_step(stmt) == SQLITE_DONE);
-        sqlite3_finalize(stmt);
-        return success;
+        return sqlite3_step(stmt.get()) == SQLITE_DONE;
     }
 
-    bool Database::remove_file(const std::filesystem::path& path) {
-        // First, remove from FTS table to maintain consistency
-        const char* fts_cleanup_sql = 
-            "DELETE FROM chunks_fts WHERE rowid IN ("
-            "  SELECT c.id FROM chunks c "
-            "  JOIN files f ON c.file_id = f.id "
-            "  WHERE f.path = ?"
-            ");";
-        sqlite3_stmt* fts_stmt;
-        if (sqlite3_prepare_v2(m_db, fts_cleanup_sql, -1, &fts_stmt, nullptr) == SQLITE_OK) {
-            sqlite3_bind_text(fts_stmt, 1, path.string().c_str(), -1, SQLITE_STATIC);
-            sqlite3_step(fts_stmt);
-            sqlite3_finalize(fts_stmt);
-        }
+    bool Database::remove_file(const std::filesystem::path& path, std::vector<int64_t>* removed_ids) {
+        // Savepoints nest, so this stays atomic both standalone and inside a writer transaction
+        sqlite3_exec(m_db, "SAVEPOINT remove_file;", nullptr, nullptr, nullptr);
 
-        const char* sql = "DELETE FROM files WHERE path = ?;";
-        sqlite3_stmt* stmt;
-        if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) != SQLITE_OK) return false;
+        auto ids = delete_file_chunks(path);
 
-        sqlite3_bind_text(stmt, 1, path.string().c_str(), -1, SQLITE_STATIC);
+        bool success = false;
+        std::string path_str = path.string();
+        if (auto stmt = prepare("DELETE FROM files WHERE path = ?;")) {
+            sqlite3_bind_text(stmt.get(), 1, path_str.c_str(), -1, SQLITE_STATIC);
+            success = (sqlite3_step(stmt.get()) == SQLITE_DONE);
+        }
 
-        bool success = (sqlite3_step(stmt) == SQLITE_DONE);
-        sqlite3_finalize(stmt);
+        if (success) {
+            sqlite3_exec(m_db, "RELEASE remove_file;", nullptr, nullptr, nullptr);
+            if (removed_ids) *removed_ids = std::move(ids);
+        } else {
+            sqlite3_exec(m_db, "ROLLBACK TO remove_file; RELEASE remove_file;", nullptr, nullptr, nullptr);
+        }
         return success;
     }
 
+    std::vector<int64_t> Database::delete_file_chunks(const std::filesystem::path& path) {
+        std::vector<int64_t> ids;
+        std::string path_str = path.string();
+
+        if (auto stmt = prepare("SELECT c.id FROM chunks c JOIN files f ON c.file_id = f.id WHERE f.path = ?;")) {
+            sqlite3_bind_text(stmt.get(), 1, path_str.c_str(), -1, SQLITE_STATIC);
+            while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+                ids.push_back(sqlite3_column_int64(stmt.get(), 0));
+            }
+        }
+        if (ids.empty()) return ids;
+
+        // Record the deletions so a stale vector index snapshot can replay them
+        if (auto stmt = prepare("INSERT OR REPLACE INTO chunk_tombstones (chunk_id, generation) "
+                                "SELECT c.id, ? FROM chunks c JOIN files f ON c.file_id = f.id WHERE f.path = ?;")) {
+            sqlite3_bind_int64(stmt.get(), 1, m_generation);
+            sqlite3_bind_text(stmt.get(), 2, path_str.c_str(), -1, SQLITE_STATIC);
+            sqlite3_step(stmt.get());
+        }
+
+        // Foreign keys are not enforced, so the FTS mirror and links are cleaned up explicitly
+        const char* cleanup_sql[] = {
+            "DELETE FROM chunks_fts WHERE rowid IN ("
+            "  SELECT c.id FROM chunks c JOIN files f ON c.file_id = f.id WHERE f.path = ?);",
+            "DELETE FROM symbol_links WHERE from_chunk_id IN ("
+            "  SELECT c.id FROM chunks c JOIN files f ON c.file_id = f.id WHERE f.path = ?);",
+            "DELETE FROM chunks WHERE file_id = (SELECT id FROM files WHERE path = ?);"
+        };
+        for (const char* sql : cleanup_sql) {
+            if (auto stmt = prepare(sql)) {
+                sqlite3_bind_text(stmt.get(), 1, path_str.c_str(), -1, SQLITE_STATIC);
+                sqlite3_step(stmt.get());
+            }
+        }
+        return ids;
+    }
+
     void Database::begin_transaction() {
         sqlite3_exec(m_db, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr);
     }
 
-    void Database::commit_transaction() {
-        sqlite3_exec(m_db, "COMMIT;", nullptr, nullptr, nullptr);
+    bool Database::commit_transaction() {
+        char* err_msg = nullptr;
+        if (sqlite3_exec(m_db, "COMMIT;", nullptr, nullptr, &err_msg) != SQLITE_OK) {
+            std::cerr << "[Database] Commit failed: " << (err_msg ? err_msg : "unknown") << "\n";
+            sqlite3_free(err_msg);
+            return false;
+        }
+        return true;
     }
 
-    std::vector<int64_t> Database::insert_chunks(const std::filesystem::path& file_path, const std::vector<Chunk>& chunks, const std::vector<std::vector<float>>& embeddings) {
-        std::vector<int64_t> ids;
-        const char* id_sql = "SELECT id FROM files WHERE path = ?;";
-        sqlite3_stmt* id_stmt;
-        int64_t file_id = -1;
+    void Database::rollback_transaction() {
+        sqlite3_exec(m_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+    }
+
+    void Database::savepoint(const std::string& name) {
+        sqlite3_exec(m_db, ("SAVEPOINT " + name + ";").c_str(), nullptr, nullptr, nullptr);
+    }
 
-        if (sqlite3_prepare_v2(m_db, id_sql, -1, &id_stmt, nullptr) == SQLITE_OK) {
-            sqlite3_bind_text(id_stmt, 1, file_path.string().c_str(), -1, SQLITE_STATIC);
-            if (sqlite3_step(id_stmt) == SQLITE_ROW) {
-                file_id = sqlite3_column_int64(id_stmt, 0);
+    void Database::end_savepoint(const std::string& name, bool keep) {
+        std::string sql = keep ? "RELEASE " + name + ";" : "ROLLBACK TO " + name + "; RELEASE " + name + ";";
+        sqlite3_exec(m_db, sql.c_str(), nullptr, nullptr, nullptr);
+    }
+
+    int64_t Database::file_id_for(const std::filesystem::path& file_path) {
+        int64_t file_id = -1;
+        std::string path_str = file_path.string();
+        if (auto id_stmt = prepare("SELECT id FROM files WHERE path = ?;")) {
+            sqlite3_bind_text(id_stmt.get(), 1, path_str.c_str(), -1, SQLITE_STATIC);
+            if (sqlite3_step(id_stmt.get()) == SQLITE_ROW) {
+                file_id = sqlite3_column_int64(id_stmt.get(), 0);
             }
-            sqlite3_finalize(id_stmt);
         }
+        return file_id;
+    }
 
-        if (file_id == -1) return ids;
+    std::vector<int64_t> Database::insert_rows(int64_t file_id, const std::vector<Chunk>& chunks, const std::vector<std::vector<float>>& embeddings) {
+        std::vector<int64_t> ids(chunks.size(), -1);
 
-        const char* sql = "INSERT INTO chunks (file_id, content, start_line, end_line, symbol_name, symbol_type, project_root, language, embedding) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?);";
-        sqlite3_stmt* stmt;
-        if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) != SQLITE_OK) return ids;
+        auto stmt = prepare("INSERT INTO chunks (file_id, content, start_line, end_line, symbol_name, symbol_type, project_root, language, embedding, content_hash, generation) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);");
+        auto fts_stmt = prepare("INSERT INTO chunks_fts(rowid, content) VALUES (?, ?);");
+        if (!stmt || !fts_stmt) return ids;
 
         for (size_t i = 0; i < chunks.size(); ++i) {
             const auto& chunk = chunks[i];
             const auto& embedding = (i < embeddings.size()) ? embeddings[i] : std::vector<float>();
 
-            sqlite3_bind_int64(stmt, 1, file_id);
-            sqlite3_bind_text(stmt, 2, chunk.content.c_str(), -1, SQLITE_STATIC);
-            sqlite3_bind_int(stmt, 3, chunk.start_line);
-            sqlite3_bind_int(stmt, 4, chunk.end_line);
-            sqlite3_bind_text(stmt, 5, chunk.symbol_name.c_str(), -1, SQLITE_STATIC);
-            sqlite3_bind_text(stmt, 6, chunk.symbol_type.c_str(), -1, SQLITE_STATIC);
-            sqlite3_bind_text(stmt, 7, chunk.project_root.c_str(), -1, SQLITE_STATIC);
-            sqlite3_bind_text(stmt, 8, chunk.language.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_int64(stmt.get(), 1, file_id);
+            sqlite3_bind_text(stmt.get(), 2, chunk.content.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_int(stmt.get(), 3, chunk.start_line);
+            sqlite3_bind_int(stmt.get(), 4, chunk.end_line);
+            sqlite3_bind_text(stmt.get(), 5, chunk.symbol_name.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_text(stmt.get(), 6, chunk.symbol_type.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_text(stmt.get(), 7, chunk.project_root.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_text(stmt.get(), 8, chunk.language.c_str(), -1, SQLITE_STATIC);
             
             if (!embedding.empty()) {
-                sqlite3_bind_blob(stmt, 9, embedding.data(), embedding.size() * sizeof(float), SQLITE_STATIC);
+                sqlite3_bind_blob(stmt.get(), 9, embedding.data(), embedding.size() * sizeof(float), SQLITE_STATIC);
+            } else {
+                sqlite3_bind_null(stmt.get(), 9);
+            }
+            if (!chunk.content_hash.empty()) {
+                sqlite3_bind_text(stmt.get(), 10, chunk.content_hash.c_str(), -1, SQLITE_STATIC);
             } else {
-                sqlite3_bind_null(stmt, 9);
+                sqlite3_bind_null(stmt.get(), 10);
             }
+            sqlite3_bind_int64(stmt.get(), 11, m_generation);
 
-            if (sqlite3_step(stmt) == SQLITE_DONE) {
+            if (sqlite3_step(stmt.get()) == SQLITE_DONE) {
                 int64_t chunk_id = sqlite3_last_insert_rowid(m_db);
-                ids.push_back(chunk_id);
+                ids[i] = chunk_id;
                 
                 // Mirror to FTS table
-                const char* fts_sql = "INSERT INTO chunks_fts(rowid, content) VALUES (?, ?);";
-                sqlite3_stmt* fts_stmt;
-                if (sqlite3_prepare_v2(m_db, fts_sql, -1, &fts_stmt, nullptr) == SQLITE_OK) {
-                    sqlite3_bind_int64(fts_stmt, 1, chunk_id);
-                    sqlite3_bind_text(fts_stmt, 2, chunk.content.c_str(), -1, SQLITE_STATIC);
-                    sqlite3_step(fts_stmt);
-                    sqlite3_finalize(fts_stmt);
-                }
+                sqlite3_bind_int64(fts_stmt.get(), 1, chunk_id);
+                sqlite3_bind_text(fts_stmt.get(), 2, chunk.content.c_str(), -1, SQLITE_STATIC);
+                sqlite3_step(fts_stmt.get());
+                sqlite3_reset(fts_stmt.get());
             }
-            sqlite3_reset(stmt);
+            sqlite3_reset(stmt.get());
         }
 
-        sqlite3_finalize(stmt);
         return ids;
     }
 
+    std::vector<int64_t> Database::insert_chunks(const std::filesystem::path& file_path, const std::vector<Chunk>& chunks, const std::vector<std::vector<float>>& embeddings) {
+        std::vector<int64_t> ids;
+        int64_t file_id = file_id_for(file_path);
+        if (file_id == -1) return ids;
+
+        for (int64_t id : insert_rows(file_id, chunks, embeddings)) {
+            if (id != -1) ids.push_back(id);
+        }
+        return ids;
+    }
+
+    std::unordered_map<std::string, size_t> Database::get_embedded_chunk_hashes(const std::filesystem::path& file_path) {
+        std::unordered_map<std::string, size_t> hashes;
+        const char* sql = "SELECT c.content_hash FROM chunks c JOIN files f ON c.file_id = f.id "
+                          "WHERE f.path = ? AND c.content_hash IS NOT NULL AND c.embedding IS NOT NULL;";
+        std::string path_str = file_path.string();
+        if (auto stmt = prepare(sql)) {
+            sqlite3_bind_text(stmt.get(), 1, path_str.c_str(), -1, SQLITE_STATIC);
+            while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+                ++hashes[reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 0))];
+            }
+        }
+        return hashes;
+    }
+
+    ChunkSyncResult Database::sync_file_chunks(const std::filesystem::path& file_path, const std::vector<Chunk>& chunks, const std::vector<std::vector<float>>& embeddings) {
+        ChunkSyncResult result;
+        int64_t file_id = file_id_for(file_path);
+        if (file_id == -1) return result;
+
+        // Existing rows of this file, grouped by content hash so duplicates are reused one by one.
+        // Rows with a vector sort last and are taken first, since the caller only embedded
+        // the copies beyond the number of stored vectors.
+        std::unordered_map<std::string, std::vector<std::pair<int64_t, bool>>> reusable;
+        if (auto stmt = prepare("SELECT id, content_hash, embedding IS NOT NULL AS has_vector FROM chunks "
+                                "WHERE file_id = ? ORDER BY has_vector, id;")) {
+            sqlite3_bind_int64(stmt.get(), 1, file_id);
+            while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+                int64_t id = sqlite3_column_int64(stmt.get(), 0);
+                const char* hash = reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 1));
+                if (hash) reusable[hash].emplace_back(id, sqlite3_column_int(stmt.get(), 2) != 0);
+                else result.removed_ids.push_back(id);
+            }
+        }
+
+        // Links are re-derived from the new version of the file by the caller
+        if (auto stmt = prepare("DELETE FROM symbol_links WHERE from_chunk_id IN (SELECT id FROM chunks WHERE file_id = ?);")) {
+            sqlite3_bind_int64(stmt.get(), 1, file_id);
+            sqlite3_step(stmt.get());
+        }
+
+        result.ids.assign(chunks.size(), -1);
+        std::vector<size_t> fresh;
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            const auto& chunk = chunks[i];
+            bool has_embedding = i < embeddings.size() && !embeddings[i].empty();
+            auto it = chunk.content_hash.empty() ? reusable.end() : reusable.find(chunk.content_hash);
+            if (it == reusable.end() || it->second.empty()) {
+                if (!has_embedding) result.unembedded.push_back(i);
+                fresh.push_back(i);
+                continue;
+            }
+
+            // Unchanged content: keep the row (and its vector), only refresh position and metadata
+            auto [id, has_vector] = it->second.back();
+            it->second.pop_back();
+            if (!has_vector && !has_embedding) result.unembedded.push_back(i);
+            if (auto stmt = prepare("UPDATE chunks SET start_line = ?, end_line = ?, symbol_name = ?, symbol_type = ?, project_root = ?, language = ?, generation = ? WHERE id = ?;")) {
+                sqlite3_bind_int(stmt.get(), 1, chunk.start_line);
+                sqlite3_bind_int(stmt.get(), 2, chunk.end_line);
+                sqlite3_bind_text(stmt.get(), 3, chunk.symbol_name.c_str(), -1, SQLITE_STATIC);
+                sqlite3_bind_text(stmt.get(), 4, chunk.symbol_type.c_str(), -1, SQLITE_STATIC);
+                sqlite3_bind_text(stmt.get(), 5, chunk.project_root.c_str(), -1, SQLITE_STATIC);
+                sqlite3_bind_text(stmt.get(), 6, chunk.language.c_str(), -1, SQLITE_STATIC);
+                sqlite3_bind_int64(stmt.get(), 7, m_generation);
+                sqlite3_bind_int64(stmt.get(), 8, id);
+                sqlite3_step(stmt.get());
+            }
+            if (has_embedding) {
+                if (auto stmt = prepare("UPDATE chunks SET embedding = ? WHERE id = ?;")) {
+                    sqlite3_bind_blob(stmt.get(), 1, embeddings[i].data(), embeddings[i].size() * sizeof(float), SQLITE_STATIC);
+                    sqlite3_bind_int64(stmt.get(), 2, id);
+                    sqlite3_step(stmt.get());
+                }
+            }
+            result.ids[i] = id;
+            ++result.reused;
+        }
+
+        for (auto& [hash, rows] : reusable) {
+            for (const auto& row : rows) result.removed_ids.push_back(row.first);
+        }
+        for (int64_t id : result.removed_ids) {
+            for (const char* sql : {"DELETE FROM chunks_fts WHERE rowid = ?;", "DELETE FROM chunks WHERE id = ?;"}) {
+                if (auto stmt = prepare(sql)) {
+                    sqlite3_bind_int64(stmt.get(), 1, id);
+                    sqlite3_step(stmt.get());
+                }
+            }
+            if (auto stmt = prepare("INSERT OR REPLACE INTO chunk_tombstones (chunk_id, generation) VALUES (?, ?);")) {
+                sqlite3_bind_int64(stmt.get(), 1, id);
+                sqlite3_bind_int64(stmt.get(), 2, m_generation);
+                sqlite3_step(stmt.get());
+            }
+        }
+
+        std::vector<Chunk> fresh_chunks;
+        std::vector<std::vector<float>> fresh_embeddings;
+        fresh_chunks.reserve(fresh.size());
+        fresh_embeddings.reserve(fresh.size());
+        for (size_t i : fresh) {
+            fresh_chunks.push_back(chunks[i]);
+            fresh_embeddings.push_back(i < embeddings.size() ? embeddings[i] : std::vector<float>());
+        }
+        auto fresh_ids = insert_rows(file_id, fresh_chunks, fresh_embeddings);
+        for (size_t k = 0; k < fresh.size(); ++k) {
+            result.ids[fresh[k]] = fresh_ids[k];
+        }
+        return result;
+    }
+
     bool Database::insert_chunk(const std::filesystem::path& file_path, const Chunk& chunk, const std::vector<float>& embedding) {
         return !insert_chunks(file_path, {chunk}, {embedding}).empty();
     }
@@ -273,8 +486,9 @@ namespace kestr::engine {
         
         sql += " ORDER BY rank LIMIT ?;";
 
-        sqlite3_stmt* stmt;
-        if (sqlite3_prepare_v2(m_db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK) {
+        // Each filter combination is a distinct SQL string, so each gets its own cached statement
+        if (auto stmt_handle = prepare(sql)) {
+            sqlite3_stmt* stmt = stmt_handle.get();
             int bind_idx = 1;
             sqlite3_bind_text(stmt, bind_idx++, text.c_str(), -1, SQLITE_STATIC);
             
@@ -297,7 +511,6 @@ namespace kestr::engine {
                 if (const char* val = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 7))) chunk.language = val;
                 results.push_back({id, chunk});
             }
-            sqlite3_finalize(stmt);
         }
         return results;
     }
@@ -307,24 +520,43 @@ namespace kestr::engine {
     }
 
     Chunk Database::get_chunk(int64_t id) {
-        Chunk chunk;
-        const char* sql = "SELECT content, start_line, end_line, symbol_name, symbol_type, project_root, language FROM chunks WHERE id = ?;";
-        sqlite3_stmt* stmt;
-        if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
-            sqlite3_bind_int64(stmt, 1, id);
-            if (sqlite3_step(stmt) == SQLITE_ROW) {
-                const char* content_ptr = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        return get_chunks({id})[0];
+    }
+
+    std::vector<Chunk> Database::get_chunks(const std::vector<int64_t>& ids) {
+        // A fixed-width IN list keeps this to one cached statement; unused slots are bound to NULL
+        constexpr size_t kIdsPerStatement = 32;
+        static const std::string sql = [] {
+            std::string s = "SELECT id, content, start_line, end_line, symbol_name, symbol_type, project_root, language FROM chunks WHERE id IN (?";
+            for (size_t i = 1; i < kIdsPerStatement; ++i) s += ", ?";
+            return s + ");";
+        }();
+
+        std::vector<Chunk> chunks(ids.size());
+        std::unordered_map<int64_t, std::vector<size_t>> slots; // The same ID may be asked for twice
+        for (size_t i = 0; i < ids.size(); ++i) slots[ids[i]].push_back(i);
+
+        for (size_t begin = 0; begin < ids.size(); begin += kIdsPerStatement) {
+            auto stmt_handle = prepare(sql);
+            if (!stmt_handle) break;
+            sqlite3_stmt* stmt = stmt_handle.get();
+            size_t end = std::min(ids.size(), begin + kIdsPerStatement);
+            for (size_t i = begin; i < end; ++i) sqlite3_bind_int64(stmt, static_cast<int>(i - begin + 1), ids[i]);
+
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                Chunk chunk;
+                const char* content_ptr = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
                 if (content_ptr) chunk.content = content_ptr;
-                chunk.start_line = sqlite3_column_int(stmt, 1);
-                chunk.end_line = sqlite3_column_int(stmt, 2);
-                if (const char* val = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3))) chunk.symbol_name = val;
-                if (const char* val = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4))) chunk.symbol_type = val;
-                if (const char* val = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5))) chunk.project_root = val;
-                if (const char* val = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6))) chunk.language = val;
+                chunk.start_line = sqlite3_column_int(stmt, 2);
+                chunk.end_line = sqlite3_column_int(stmt, 3);
+                if (const char* val = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4))) chunk.symbol_name = val;
+                if (const char* val = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5))) chunk.symbol_type = val;
+                if (const char* val = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6))) chunk.project_root = val;
+                if (const char* val = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 7))) chunk.language = val;
+                for (size_t slot : slots[sqlite3_column_int64(stmt, 0)]) chunks[slot] = chunk;
             }
-            sqlite3_finalize(stmt);
         }
-        return chunk;
+        return chunks;
     }
 
     void Database::for_each_vector(std::function<void(int64_t, const std::vector<float>&)> callback) {
@@ -335,8 +567,8 @@ namespace kestr::engine {
             "WHERE c.embedding IS NOT NULL "
             "ORDER BY f.last_modified DESC;";
             
-        sqlite3_stmt* stmt;
-        if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
+        if (auto stmt_handle = prepare(sql)) {
+            sqlite3_stmt* stmt = stmt_handle.get();
             while (sqlite3_step(stmt) == SQLITE_ROW) {
                 int64_t id = sqlite3_column_int64(stmt, 0);
                 const void* blob = sqlite3_column_blob(stmt, 1);
@@ -349,78 +581,327 @@ namespace kestr::engine {
                     callback(id, vec);
                 }
             }
-            sqlite3_finalize(stmt);
         }
     }
 
+    void Database::for_each_embedded_id(const std::function<void(int64_t)>& callback) {
+        if (auto stmt = prepare("SELECT id FROM chunks WHERE length(embedding) > 0;")) {
+            while (sqlite3_step(stmt.get()) == SQLITE_ROW) callback(sqlite3_column_int64(stmt.get(), 0));
+        }
+    }
+
+    size_t Database::for_each_embedding(const SearchFilters& filters, const std::function<void(int64_t, const float*, size_t)>& callback,
+                                        int64_t after_id, size_t limit) {
+        std::string sql = "SELECT c.id, c.embedding FROM chunks c WHERE c.embedding IS NOT NULL AND c.id > ?";
+        if (!filters.type_filter.empty()) sql += " AND c.symbol_type = ?";
+        if (!filters.language.empty()) sql += " AND c.language = ?";
+        if (!filters.scope.empty()) sql += " AND c.project_root = ?";
+        sql += " ORDER BY c.id LIMIT ?;";
+
+        size_t visited = 0;
+        if (auto stmt_handle = prepare(sql)) {
+            sqlite3_stmt* stmt = stmt_handle.get();
+            int bind_idx = 1;
+            sqlite3_bind_int64(stmt, bind_idx++, after_id);
+            if (!filters.type_filter.empty()) sqlite3_bind_text(stmt, bind_idx++, filters.type_filter.c_str(), -1, SQLITE_STATIC);
+            if (!filters.language.empty()) sqlite3_bind_text(stmt, bind_idx++, filters.language.c_str(), -1, SQLITE_STATIC);
+            if (!filters.scope.empty()) sqlite3_bind_text(stmt, bind_idx++, filters.scope.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_int64(stmt, bind_idx++, limit ? static_cast<int64_t>(limit) : -1);
+
+            std::vector<float> aligned;
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                ++visited;
+                const void* blob = sqlite3_column_blob(stmt, 1);
+                int bytes = sqlite3_column_bytes(stmt, 1);
+                size_t dim = blob && bytes > 0 ? bytes / sizeof(float) : 0;
+                const float* vector = static_cast<const float*>(blob);
+                if (dim && reinterpret_cast<uintptr_t>(blob) % alignof(float) != 0) {
+                    // SQLite makes no alignment promise for blobs
+                    aligned.resize(dim);
+                    memcpy(aligned.data(), blob, dim * sizeof(float));
+                    vector = aligned.data();
+                }
+                callback(sqlite3_column_int64(stmt, 0), vector, dim);
+            }
+        }
+        return visited;
+    }
+
+    void Database::for_each_vector_since(int64_t generation, std::function<void(int64_t, const std::vector<float>&)> callback) {
+        const char* sql = "SELECT id, embedding FROM chunks WHERE generation >= ? AND embedding IS NOT NULL;";
+        if (auto stmt_handle = prepare(sql)) {
+            sqlite3_stmt* stmt = stmt_handle.get();
+            sqlite3_bind_int64(stmt, 1, generation);
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                int64_t id = sqlite3_column_int64(stmt, 0);
+                const void* blob = sqlite3_column_blob(stmt, 1);
+                int bytes = sqlite3_column_bytes(stmt, 1);
+
+                if (blob && bytes > 0) {
+                    std::vector<float> vec(bytes / sizeof(float));
+                    memcpy(vec.data(), blob, bytes);
+                    callback(id, vec);
+                }
+            }
+        }
+    }
+
+    void Database::for_each_chunk_attributes(std::function<void(int64_t, const Chunk&)> callback) {
+        const char* sql = "SELECT id, symbol_type, language, project_root FROM chunks WHERE embedding IS NOT NULL;";
+        if (auto stmt_handle = prepare(sql)) {
+            sqlite3_stmt* stmt = stmt_handle.get();
+            Chunk chunk;
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                auto text = [&](int col) {
+                    const char* val = reinterpret_cast<const char*>(sqlite3_column_text(stmt, col));
+                    return val ? std::string(val) : std::string();
+                };
+                chunk.symbol_type = text(1);
+                chunk.language = text(2);
+                chunk.project_root = text(3);
+                callback(sqlite3_column_int64(stmt, 0), chunk);
+            }
+        }
+    }
+
+    std::unordered_map<int64_t, std::vector<float>> Database::get_embeddings(const std::vector<int64_t>& ids) {
+        std::unordered_map<int64_t, std::vector<float>> vectors;
+        auto stmt = prepare("SELECT embedding FROM chunks WHERE id = ?;");
+        if (!stmt) return vectors;
+
+        for (int64_t id : ids) {
+            sqlite3_bind_int64(stmt.get(), 1, id);
+            if (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+                const void* blob = sqlite3_column_blob(stmt.get(), 0);
+                int bytes = sqlite3_column_bytes(stmt.get(), 0);
+                if (blob && bytes > 0) {
+                    std::vector<float> vec(bytes / sizeof(float));
+                    memcpy(vec.data(), blob, bytes);
+                    vectors.emplace(id, std::move(vec));
+                }
+            }
+            sqlite3_reset(stmt.get());
+        }
+        return vectors;
+    }
+
+    std::unordered_map<std::string, std::vector<float>> Database::get_cached_embeddings(const std::vector<std::string>& keys) {
+        std::unordered_map<std::string, std::vector<float>> vectors;
+        auto stmt = prepare("SELECT embedding FROM embedding_cache WHERE key = ?;");
+        if (!stmt) return vectors;
+
+        for (const auto& key : keys) {
+            sqlite3_bind_text(stmt.get(), 1, key.c_str(), -1, SQLITE_STATIC);
+            if (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+                const void* blob = sqlite3_column_blob(stmt.get(), 0);
+                int bytes = sqlite3_column_bytes(stmt.get(), 0);
+                if (blob && bytes > 0) {
+                    std::vector<float> vec(bytes / sizeof(float));
+                    memcpy(vec.data(), blob, bytes);
+                    vectors.emplace(key, std::move(vec));
+                }
+            }
+            sqlite3_reset(stmt.get());
+        }
+        return vectors;
+    }
+
+    bool Database::put_cached_embeddings(const std::vector<std::pair<std::string, std::vector<float>>>& entries) {
+        auto stmt = prepare("INSERT OR REPLACE INTO embedding_cache (key, embedding) VALUES (?, ?);");
+        if (!stmt) return false;
+
+        // One savepoint per call instead of one implicit transaction per row
+        sqlite3_exec(m_db, "SAVEPOINT embedding_cache;", nullptr, nullptr, nullptr);
+        bool ok = true;
+        for (const auto& [key, vec] : entries) {
+            if (vec.empty()) continue;
+            sqlite3_bind_text(stmt.get(), 1, key.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_blob(stmt.get(), 2, vec.data(), static_cast<int>(vec.size() * sizeof(float)), SQLITE_STATIC);
+            ok = (sqlite3_step(stmt.get()) == SQLITE_DONE) && ok;
+            sqlite3_reset(stmt.get());
+        }
+        sqlite3_exec(m_db, "RELEASE embedding_cache;", nullptr, nullptr, nullptr);
+        return ok;
+    }
+
+    size_t Database::trim_embedding_cache(size_t max_entries) {
+        // Rowids grow with every (re)insert, so the lowest ones are the entries written longest ago.
+        // Replaced keys leave gaps, so the newest rows are picked by rank, not by rowid arithmetic.
+        auto stmt = prepare("DELETE FROM embedding_cache WHERE rowid NOT IN ("
+                            "  SELECT rowid FROM embedding_cache ORDER BY rowid DESC LIMIT ?);");
+        if (!stmt) return 0;
+        sqlite3_bind_int64(stmt.get(), 1, static_cast<sqlite3_int64>(max_entries));
+        if (sqlite3_step(stmt.get()) != SQLITE_DONE) return 0;
+        return static_cast<size_t>(sqlite3_changes(m_db));
+    }
+
+    std::vector<std::vector<float>> Database::sample_vectors(size_t limit) {
+        std::vector<std::vector<float>> samples;
+        // Pick ids first so the random sort does not drag every embedding blob along
+        const char* sql = "SELECT embedding FROM chunks WHERE id IN ("
+                          "  SELECT id FROM chunks WHERE embedding IS NOT NULL ORDER BY RANDOM() LIMIT ?);";
+        if (auto stmt = prepare(sql)) {
+            sqlite3_bind_int64(stmt.get(), 1, static_cast<sqlite3_int64>(limit));
+            while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+                const void* blob = sqlite3_column_blob(stmt.get(), 0);
+                int bytes = sqlite3_column_bytes(stmt.get(), 0);
+                if (blob && bytes > 0) {
+                    std::vector<float> vec(bytes / sizeof(float));
+                    memcpy(vec.data(), blob, bytes);
+                    samples.push_back(std::move(vec));
+                }
+            }
+        }
+        return samples;
+    }
+
+    std::vector<int64_t> Database::get_tombstones_since(int64_t generation) {
+        std::vector<int64_t> ids;
+        if (auto stmt = prepare("SELECT chunk_id FROM chunk_tombstones WHERE generation >= ?;")) {
+            sqlite3_bind_int64(stmt.get(), 1, generation);
+            while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+                ids.push_back(sqlite3_column_int64(stmt.get(), 0));
+            }
+        }
+        return ids;
+    }
+
+    void Database::prune_tombstones(int64_t before_generation) {
+        if (auto stmt = prepare("DELETE FROM chunk_tombstones WHERE generation < ?;")) {
+            sqlite3_bind_int64(stmt.get(), 1, before_generation);
+            sqlite3_step(stmt.get());
+        }
+    }
+
+    bool Database::has_changes_since(int64_t generation) {
+        bool changed = false;
+        const char* sql = "SELECT EXISTS(SELECT 1 FROM chunks WHERE generation >= ?1) "
+                          "OR EXISTS(SELECT 1 FROM chunk_tombstones WHERE generation >= ?1);";
+        if (auto stmt = prepare(sql)) {
+            sqlite3_bind_int64(stmt.get(), 1, generation);
+            if (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+                changed = sqlite3_column_int(stmt.get(), 0) != 0;
+            }
+        }
+        return changed;
+    }
+
+    int64_t Database::advance_generation() {
+        int64_t closed = m_generation;
+        if (set_meta("generation", std::to_string(closed + 1))) {
+            m_generation = closed + 1;
+        }
+        return closed;
+    }
+
+    std::string Database::get_meta(const std::string& key, const std::string& fallback) {
+        std::string value = fallback;
+        if (auto stmt = prepare("SELECT value FROM meta WHERE key = ?;")) {
+            sqlite3_bind_text(stmt.get(), 1, key.c_str(), -1, SQLITE_STATIC);
+            if (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+                const unsigned char* text = sqlite3_column_text(stmt.get(), 0);
+                if (text) value = reinterpret_cast<const char*>(text);
+            }
+        }
+        return value;
+    }
+
+    bool Database::set_meta(const std::string& key, const std::string& value) {
+        auto stmt = prepare("INSERT OR REPLACE INTO meta (key, value) VALUES (?, ?);");
+        if (!stmt) return false;
+        sqlite3_bind_text(stmt.get(), 1, key.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt.get(), 2, value.c_str(), -1, SQLITE_STATIC);
+        return sqlite3_step(stmt.get()) == SQLITE_DONE;
+    }
+
+    std::vector<uint8_t> Database::get_meta_blob(const std::string& key) {
+        std::vector<uint8_t> value;
+        if (auto stmt = prepare("SELECT value FROM meta WHERE key = ?;")) {
+            sqlite3_bind_text(stmt.get(), 1, key.c_str(), -1, SQLITE_STATIC);
+            if (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+                const void* blob = sqlite3_column_blob(stmt.get(), 0);
+                int bytes = sqlite3_column_bytes(stmt.get(), 0);
+                if (blob && bytes > 0) value.assign(static_cast<const uint8_t*>(blob), static_cast<const uint8_t*>(blob) + bytes);
+            }
+        }
+        return value;
+    }
+
+    bool Database::set_meta_blob(const std::string& key, const std::vector<uint8_t>& value) {
+        auto stmt = prepare("INSERT OR REPLACE INTO meta (key, value) VALUES (?, ?);");
+        if (!stmt) return false;
+        sqlite3_bind_text(stmt.get(), 1, key.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_blob(stmt.get(), 2, value.data(), static_cast<int>(value.size()), SQLITE_STATIC);
+        return sqlite3_step(stmt.get()) == SQLITE_DONE;
+    }
+
     std::vector<std::string> Database::get_all_files() {
         std::vector<std::string> files;
-        const char* sql = "SELECT path FROM files;";
-        sqlite3_stmt* stmt;
-        if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
-            while (sqlite3_step(stmt) == SQLITE_ROW) {
-                files.push_back(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)));
+        if (auto stmt = prepare("SELECT path FROM files;")) {
+            while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+                files.push_back(reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 0)));
             }
-            sqlite3_finalize(stmt);
         }
         return files;
     }
 
     size_t Database::count_files() {
-        const char* sql = "SELECT count(*) FROM files;";
-        sqlite3_stmt* stmt;
         size_t count = 0;
-        if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
-            if (sqlite3_step(stmt) == SQLITE_ROW) count = sqlite3_column_int(stmt, 0);
-            sqlite3_finalize(stmt);
+        if (auto stmt = prepare("SELECT count(*) FROM files;")) {
+            if (sqlite3_step(stmt.get()) == SQLITE_ROW) count = sqlite3_column_int64(stmt.get(), 0);
         }
         return count;
     }
 
     size_t Database::count_chunks() {
-        const char* sql = "SELECT count(*) FROM chunks;";
-        sqlite3_stmt* stmt;
         size_t count = 0;
-        if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
-            if (sqlite3_step(stmt) == SQLITE_ROW) count = sqlite3_column_int(stmt, 0);
-            sqlite3_finalize(stmt);
+        if (auto stmt = prepare("SELECT count(*) FROM chunks;")) {
+            if (sqlite3_step(stmt.get()) == SQLITE_ROW) count = sqlite3_column_int64(stmt.get(), 0);
         }
         return count;
     }
 
     size_t Database::get_stored_dimension() {
-        const char* sql = "SELECT length(embedding) FROM chunks WHERE embedding IS NOT NULL LIMIT 1;";
-        sqlite3_stmt* stmt;
         size_t dim = 0;
-        if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
-            if (sqlite3_step(stmt) == SQLITE_ROW) {
-                int bytes = sqlite3_column_int(stmt, 0);
+        if (auto stmt = prepare("SELECT length(embedding) FROM chunks WHERE embedding IS NOT NULL LIMIT 1;")) {
+            if (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+                int bytes = sqlite3_column_int(stmt.get(), 0);
                 dim = bytes / sizeof(float);
             }
-            sqlite3_finalize(stmt);
         }
         return dim;
     }
 
+    std::vector<std::string> Database::sample_chunk_contents(size_t limit) {
+        std::vector<std::string> contents;
+        if (auto stmt = prepare("SELECT content FROM chunks WHERE length(content) > 0 ORDER BY random() LIMIT ?;")) {
+            sqlite3_bind_int64(stmt.get(), 1, static_cast<sqlite3_int64>(limit));
+            while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+                const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 0));
+                contents.emplace_back(text ? text : "");
+            }
+        }
+        return contents;
+    }
+
     void Database::wipe_all_chunks() {
         sqlite3_exec(m_db, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr);
         sqlite3_exec(m_db, "DELETE FROM chunks;", nullptr, nullptr, nullptr);
         sqlite3_exec(m_db, "DELETE FROM chunks_fts;", nullptr, nullptr, nullptr);
         sqlite3_exec(m_db, "DELETE FROM symbol_links;", nullptr, nullptr, nullptr);
+        sqlite3_exec(m_db, "DELETE FROM chunk_tombstones;", nullptr, nullptr, nullptr);
+        sqlite3_exec(m_db, "DELETE FROM meta WHERE key LIKE 'snapshot_%' OR key LIKE 'ivfpq_codebooks%' OR key IN ('quantizer', 'quantizer_metric');", nullptr, nullptr, nullptr);
         sqlite3_exec(m_db, "UPDATE files SET is_indexed = 0;", nullptr, nullptr, nullptr);
         sqlite3_exec(m_db, "COMMIT;", nullptr, nullptr, nullptr);
     }
 
     bool Database::add_symbol_link(int64_t from_chunk_id, const std::string& to_symbol, const std::string& type) {
-        const char* sql = "INSERT INTO symbol_links (from_chunk_id, to_symbol_name, link_type) VALUES (?, ?, ?);";
-        sqlite3_stmt* stmt;
-        if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) != SQLITE_OK) return false;
-        sqlite3_bind_int64(stmt, 1, from_chunk_id);
-        sqlite3_bind_text(stmt, 2, to_symbol.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 3, type.c_str(), -1, SQLITE_STATIC);
-        bool success = (sqlite3_step(stmt) == SQLITE_DONE);
-        sqlite3_finalize(stmt);
-        return success;
+        auto stmt = prepare("INSERT INTO symbol_links (from_chunk_id, to_symbol_name, link_type) VALUES (?, ?, ?);");
+        if (!stmt) return false;
+        sqlite3_bind_int64(stmt.get(), 1, from_chunk_id);
+        sqlite3_bind_text(stmt.get(), 2, to_symbol.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt.get(), 3, type.c_str(), -1, SQLITE_STATIC);
+        return sqlite3_step(stmt.get()) == SQLITE_DONE;
     }
 
     std::vector<Chunk> Database::find_references(const std::string& symbol_name) {
@@ -429,8 +910,8 @@ namespace kestr::engine {
                           "FROM chunks c "
                           "JOIN symbol_links l ON c.id = l.from_chunk_id "
                           "WHERE l.to_symbol_name = ?;";
-        sqlite3_stmt* stmt;
-        if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
+        if (auto stmt_handle = prepare(sql)) {
+            sqlite3_stmt* stmt = stmt_handle.get();
             sqlite3_bind_text(stmt, 1, symbol_name.c_str(), -1, SQLITE_STATIC);
             while (sqlite3_step(stmt) == SQLITE_ROW) {
                 Chunk chunk;
@@ -444,9 +925,28 @@ namespace kestr::engine {
                 if (const char* val = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6))) chunk.language = val;
                 results.push_back(chunk);
             }
-            sqlite3_finalize(stmt);
         }
         return results;
     }
 
+    std::vector<Chunk> Database::list_symbols(const std::filesystem::path& path) {
+        std::vector<Chunk> symbols;
+        const char* sql = "SELECT symbol_name, symbol_type, start_line FROM chunks c "
+                          "JOIN files f ON c.file_id = f.id "
+                          "WHERE f.path = ? AND symbol_name IS NOT NULL ORDER BY start_line;";
+        std::string path_str = path.string();
+        if (auto stmt = prepare(sql)) {
+            sqlite3_bind_text(stmt.get(), 1, path_str.c_str(), -1, SQLITE_STATIC);
+            while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+                Chunk chunk;
+                if (const char* val = reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 0))) chunk.symbol_name = val;
+                if (const char* val = reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 1))) chunk.symbol_type = val;
+                chunk.start_line = sqlite3_column_int(stmt.get(), 2);
+                chunk.end_line = chunk.start_line;
+                symbols.push_back(chunk);
+            }
+        }
+        return symbols;
+    }
+
 } 
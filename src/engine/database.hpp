@@ -5,10 +5,21 @@
 #include <filesystem>
 #include <sqlite3.h>
 #include <functional>
+#include <unordered_map>
 #include "kestr/types.hpp"
 
 namespace kestr::engine {
 
+    /**
+     * @brief Outcome of Database::sync_file_chunks.
+     */
+    struct ChunkSyncResult {
+        std::vector<int64_t> ids;         // Parallel to the input chunks, -1 if an insert failed
+        std::vector<int64_t> removed_ids; // Rows whose content no longer exists in the file
+        size_t reused = 0;                // Rows kept because their content hash matched
+        std::vector<size_t> unembedded;   // Chunks sent without a vector that have no stored one either
+    };
+
     class Database {
     public:
         Database();
@@ -29,7 +40,7 @@ namespace kestr::engine {
 
         /**
          * @brief Checks if a file might need re-indexing based on metadata only.
-         * @return true if mtime or size differs from DB.
+         * @return true if mtime or size differs from DB, or the file is not marked indexed.
          */
         bool check_metadata(const std::filesystem::path& path, std::uintmax_t size, int64_t mtime);
 
@@ -46,8 +57,16 @@ namespace kestr::engine {
 
         /**
          * @brief Removes a file and its chunks from the database.
+         * @param removed_ids If given, receives the IDs of the deleted chunks.
+         */
+        bool remove_file(const std::filesystem::path& path, std::vector<int64_t>* removed_ids = nullptr);
+
+        /**
+         * @brief Deletes every chunk of a file along with its FTS rows and symbol links.
+         * Used before re-inserting a changed file so its chunk set is replaced, not appended to.
+         * @return IDs of the deleted chunks, so callers can drop them from the vector index.
          */
-        bool remove_file(const std::filesystem::path& path);
+        std::vector<int64_t> delete_file_chunks(const std::filesystem::path& path);
 
         /**
          * @brief Inserts a chunk into the database.
@@ -59,6 +78,19 @@ namespace kestr::engine {
          */
         std::vector<int64_t> insert_chunks(const std::filesystem::path& file_path, const std::vector<Chunk>& chunks, const std::vector<std::vector<float>>& embeddings);
 
+        /**
+         * @brief Counts, per content hash, the chunks of a file that already have an embedding.
+         */
+        std::unordered_map<std::string, size_t> get_embedded_chunk_hashes(const std::filesystem::path& file_path);
+
+        /**
+         * @brief Reconciles a file's stored chunks with a freshly parsed chunk set.
+         * Rows whose content_hash matches a new chunk are kept (only line ranges and metadata
+         * are updated, and the embedding if one is supplied); unmatched new chunks are inserted
+         * and rows that no longer match anything are deleted. Symbol links of the file are cleared.
+         */
+        ChunkSyncResult sync_file_chunks(const std::filesystem::path& file_path, const std::vector<Chunk>& chunks, const std::vector<std::vector<float>>& embeddings);
+
         /**
          * @brief Starts an explicit transaction.
          */
@@ -66,8 +98,24 @@ namespace kestr::engine {
 
         /**
          * @brief Commits an explicit transaction.
+         * @return false if SQLite refused the commit.
          */
-        void commit_transaction();
+        bool commit_transaction();
+
+        /**
+         * @brief Rolls back an explicit transaction.
+         */
+        void rollback_transaction();
+
+        /**
+         * @brief Opens a named savepoint; savepoints nest inside a transaction.
+         */
+        void savepoint(const std::string& name);
+
+        /**
+         * @brief Closes a savepoint, keeping its changes or undoing everything since it was opened.
+         */
+        void end_savepoint(const std::string& name, bool keep);
 
         /**
          * @brief Searches for chunks containing the given keyword, with optional filters.
@@ -86,12 +134,108 @@ namespace kestr::engine {
          */
         Chunk get_chunk(int64_t id);
 
+        /**
+         * @brief Retrieves several chunks in a few statements instead of one per ID.
+         * @return One chunk per ID, in the same order; unknown IDs yield an empty chunk.
+         */
+        std::vector<Chunk> get_chunks(const std::vector<int64_t>& ids);
+
         /**
          * @brief Callback for iterating all vectors.
          * Function signature: (id, vector)
          */
         void for_each_vector(std::function<void(int64_t, const std::vector<float>&)> callback);
 
+        /**
+         * @brief Iterates vectors of chunks inserted or updated in the given generation or later.
+         */
+        void for_each_vector_since(int64_t generation, std::function<void(int64_t, const std::vector<float>&)> callback);
+
+        /**
+         * @brief Iterates the filterable fields of all embedded chunks.
+         * Only symbol_type, language and project_root of the Chunk are filled.
+         */
+        void for_each_chunk_attributes(std::function<void(int64_t, const Chunk&)> callback);
+
+        /**
+         * @brief Iterates the ids of all chunks that have a non-empty embedding, without reading the vectors.
+         */
+        void for_each_embedded_id(const std::function<void(int64_t)>& callback);
+
+        /**
+         * @brief Streams the embeddings of chunks matching the filters without copying them.
+         * The pointer is only valid during the callback; rows with an empty blob come with dim 0.
+         * @param after_id Only chunks with a larger id are visited, in id order.
+         * @param limit Stops after this many rows (0 = all), so long scans can be paged.
+         * @return Number of rows visited.
+         */
+        size_t for_each_embedding(const SearchFilters& filters, const std::function<void(int64_t id, const float* vector, size_t dim)>& callback,
+                                  int64_t after_id = 0, size_t limit = 0);
+
+        /**
+         * @brief Fetches the stored embeddings of the given chunks; ids without one are left out.
+         */
+        std::unordered_map<int64_t, std::vector<float>> get_embeddings(const std::vector<int64_t>& ids);
+
+        /**
+         * @brief Looks up content-addressed embeddings (see CachingEmbedder); missing keys are left out.
+         */
+        std::unordered_map<std::string, std::vector<float>> get_cached_embeddings(const std::vector<std::string>& keys);
+
+        /**
+         * @brief Stores content-addressed embeddings, replacing existing keys. Empty vectors are skipped.
+         */
+        bool put_cached_embeddings(const std::vector<std::pair<std::string, std::vector<float>>>& entries);
+
+        /**
+         * @brief Keeps only the max_entries most recently written cache entries.
+         * @return Number of entries dropped.
+         */
+        size_t trim_embedding_cache(size_t max_entries);
+
+        /**
+         * @brief Returns up to `limit` randomly chosen stored embeddings.
+         */
+        std::vector<std::vector<float>> sample_vectors(size_t limit);
+
+        /**
+         * @brief Returns ids of chunks deleted in the given generation or later.
+         */
+        std::vector<int64_t> get_tombstones_since(int64_t generation);
+
+        /**
+         * @brief Drops tombstones older than the given generation.
+         */
+        void prune_tombstones(int64_t before_generation);
+
+        /**
+         * @brief Returns true if any chunk was written or deleted in the given generation or later.
+         */
+        bool has_changes_since(int64_t generation);
+
+        /**
+         * @brief Current write generation. Every chunk insert, update and delete is tagged with it.
+         */
+        int64_t generation() const { return m_generation; }
+
+        /**
+         * @brief Closes the current generation and starts a new one.
+         * @return The generation that was closed; later writes are tagged with a higher value.
+         */
+        int64_t advance_generation();
+
+        /**
+         * @brief Reads / writes a value in the key-value meta table.
+         */
+        std::string get_meta(const std::string& key, const std::string& fallback = "");
+        bool set_meta(const std::string& key, const std::string& value);
+
+        /**
+         * @brief Binary variant of get_meta / set_meta (e.g. trained codebooks).
+         */
+        std::vector<uint8_t> get_meta_blob(const std::string& key);
+        bool set_meta_blob(const std::string& key, const std::vector<uint8_t>& value);
+
         /**
          * @brief Retrieves all indexed file paths.
          */
@@ -108,6 +252,11 @@ namespace kestr::engine {
          */
         size_t get_stored_dimension();
 
+        /**
+         * @brief Returns the contents of up to limit randomly chosen non-empty chunks.
+         */
+        std::vector<std::string> sample_chunk_contents(size_t limit);
+
         /**
          * @brief Wipes all chunks and resets is_indexed status for all files.
          * Used for re-indexing when the model changes.
@@ -129,8 +278,53 @@ namespace kestr::engine {
          */
         std::vector<Chunk> find_references(const std::string& symbol_name);
 
+        /**
+         * @brief Lists the named symbols of a file ordered by line.
+         * Only symbol_name, symbol_type and start_line are filled in.
+         */
+        std::vector<Chunk> list_symbols(const std::filesystem::path& path);
+
     private:
+        /**
+         * @brief Borrowed handle to a cached prepared statement.
+         * Resets the statement and clears its bindings on scope exit so it can be reused.
+         */
+        class Statement {
+        public:
+            explicit Statement(sqlite3_stmt* stmt) : m_stmt(stmt) {}
+            ~Statement() {
+                if (m_stmt) {
+                    sqlite3_reset(m_stmt);
+                    sqlite3_clear_bindings(m_stmt);
+                }
+            }
+            Statement(const Statement&) = delete;
+            Statement& operator=(const Statement&) = delete;
+
+            sqlite3_stmt* get() const { return m_stmt; }
+            explicit operator bool() const { return m_stmt != nullptr; }
+
+        private:
+            sqlite3_stmt* m_stmt;
+        };
+
+        /**
+         * @brief Returns the cached statement for sql, preparing it on first use.
+         */
+        Statement prepare(const std::string& sql);
+
+        int64_t file_id_for(const std::filesystem::path& file_path);
+
+        /**
+         * @brief Inserts chunk rows and their FTS mirror; result is parallel to chunks (-1 on failure).
+         */
+        std::vector<int64_t> insert_rows(int64_t file_id, const std::vector<Chunk>& chunks, const std::vector<std::vector<float>>& embeddings);
+
+        void finalize_statements();
+
         sqlite3* m_db = nullptr;
+        int64_t m_generation = 1;
+        std::unordered_map<std::string, sqlite3_stmt*> m_statements;
     };
 
 }
\ No newline at end of file
@@ -0,0 +1,195 @@
+#include "database_writer.hpp"
+#include <iostream>
+#include <algorithm>
+
+namespace kestr::engine {
+
+    namespace {
+        // A refused COMMIT (usually a busy database) is retried before the group is given up
+        constexpr int kCommitAttempts = 3;
+        // A file handed back this many times in a row is dropped until the next scan finds it
+        constexpr int kMaxRequeues = 3;
+    }
+
+    DatabaseWriter::DatabaseWriter(Database& db, std::mutex& db_mutex, WriterOptions options)
+        : m_db(db), m_db_mutex(db_mutex), m_options(options) {
+        if (m_options.max_group_files == 0) m_options.max_group_files = 1;
+        if (m_options.max_pending < m_options.max_group_files) m_options.max_pending = m_options.max_group_files;
+    }
+
+    DatabaseWriter::~DatabaseWriter() {
+        stop();
+    }
+
+    void DatabaseWriter::start() {
+        if (m_thread.joinable()) return;
+        m_thread = std::thread(&DatabaseWriter::run, this);
+    }
+
+    void DatabaseWriter::stop() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_cv.notify_all();
+        m_space_cv.notify_all();
+        if (m_thread.joinable()) m_thread.join();
+    }
+
+    void DatabaseWriter::set_commit_hook(CommitHook hook) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_hook = std::move(hook);
+    }
+
+    void DatabaseWriter::set_requeue_hook(RequeueHook hook) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_requeue = std::move(hook);
+    }
+
+    size_t DatabaseWriter::pending() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_pending.size();
+    }
+
+    std::future<WriteResult> DatabaseWriter::submit(WriteBatch batch) {
+        Pending p;
+        p.batch = std::move(batch);
+        p.enqueued = std::chrono::steady_clock::now();
+        auto future = p.promise.get_future();
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_space_cv.wait(lock, [this] { return m_pending.size() < m_options.max_pending || m_stop; });
+        if (m_stop) {
+            p.promise.set_value(WriteResult{});
+            return future;
+        }
+        m_pending.push_back(std::move(p));
+        lock.unlock();
+
+        m_cv.notify_one();
+        return future;
+    }
+
+    void DatabaseWriter::run() {
+        while (true) {
+            std::vector<Pending> group;
+            CommitHook hook;
+            RequeueHook requeue;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cv.wait(lock, [this] { return !m_pending.empty() || m_stop; });
+                if (m_pending.empty()) break; // Stopped and drained
+
+                // Wait for the group to fill up, but never past the oldest entry's deadline
+                auto deadline = m_pending.front().enqueued + m_options.max_latency;
+                m_cv.wait_until(lock, deadline, [this] {
+                    return m_pending.size() >= m_options.max_group_files || m_stop;
+                });
+
+                size_t n = std::min(m_pending.size(), m_options.max_group_files);
+                group.reserve(n);
+                for (size_t i = 0; i < n; ++i) {
+                    group.push_back(std::move(m_pending.front()));
+                    m_pending.pop_front();
+                }
+                hook = m_hook;
+                requeue = m_requeue;
+            }
+            m_space_cv.notify_all();
+
+            std::vector<WriteResult> results(group.size());
+            bool committed = false;
+            for (int attempt = 1; !committed; ++attempt) {
+                {
+                    std::lock_guard<std::mutex> lock(m_db_mutex);
+                    m_db.begin_transaction();
+                    for (size_t i = 0; i < group.size(); ++i) {
+                        results[i] = apply(group[i].batch);
+                    }
+                    committed = m_db.commit_transaction();
+                    if (!committed) m_db.rollback_transaction();
+                }
+                if (committed || attempt == kCommitAttempts) break;
+                // Outside the DB lock, so whoever holds the database can finish
+                std::this_thread::sleep_for(std::chrono::milliseconds(100 * attempt));
+            }
+
+            if (committed) {
+                ++m_commits;
+                m_files_written += group.size();
+                // Another version of the file was written after this one was embedded and took
+                // the vectors it meant to keep; embedding it again fills them back in
+                for (size_t i = 0; i < group.size(); ++i) {
+                    if (results[i].missing_vectors) hand_back(requeue, group[i].batch.info);
+                    else m_requeues.erase(group[i].batch.info.path.string());
+                }
+                if (hook) {
+                    std::vector<WriteBatch> batches;
+                    batches.reserve(group.size());
+                    for (auto& p : group) batches.push_back(std::move(p.batch));
+                    hook(batches, results);
+                }
+            } else {
+                // Rolled back, and nothing rescans on its own: the files go back to the read stage
+                std::cerr << "[DatabaseWriter] Could not commit a group of " << group.size() << " files after "
+                          << kCommitAttempts << " attempts:\n";
+                for (size_t i = 0; i < group.size(); ++i) {
+                    std::cerr << "  " << group[i].batch.info.path.string() << "\n";
+                    hand_back(requeue, group[i].batch.info);
+                    results[i] = WriteResult{};
+                }
+            }
+
+            for (size_t i = 0; i < group.size(); ++i) {
+                group[i].promise.set_value(std::move(results[i]));
+            }
+        }
+    }
+
+    void DatabaseWriter::hand_back(const RequeueHook& requeue, const FileInfo& info) {
+        if (!requeue) return;
+        // A persistent failure (disk full, read-only or corrupt database) would otherwise send
+        // the same files through parsing and embedding forever
+        int& rounds = m_requeues[info.path.string()];
+        if (++rounds > kMaxRequeues) {
+            std::cerr << "[DatabaseWriter] Gave up on " << info.path.string() << " after " << kMaxRequeues
+                      << " retries, it is picked up again by the next scan.\n";
+            m_requeues.erase(info.path.string());
+            return;
+        }
+        requeue(info);
+    }
+
+    WriteResult DatabaseWriter::apply(const WriteBatch& batch) {
+        // Each file is all or nothing within the group transaction: a failure halfway
+        // must not commit a file row without its chunks, or half of its chunks
+        m_db.savepoint("write_file");
+        WriteResult result;
+        if (m_db.update_file(batch.info)) {
+            // Reconcile the file's chunk set; unchanged chunks keep their ids and vectors
+            auto sync = m_db.sync_file_chunks(batch.info.path, batch.chunks, batch.embeddings);
+            result.chunk_ids = std::move(sync.ids);
+            result.removed_ids = std::move(sync.removed_ids);
+            // Only chunks the embed stage skipped count: one the embedder failed on stays without
+            // a vector until the next scan, sending it round again would just fail again
+            for (size_t i : sync.unembedded) {
+                if (i < batch.reused.size() && batch.reused[i]) ++result.missing_vectors;
+            }
+            bool stored = result.chunk_ids.size() == batch.chunks.size() &&
+                          std::find(result.chunk_ids.begin(), result.chunk_ids.end(), -1) == result.chunk_ids.end();
+            if (stored) {
+                for (const auto& call : batch.calls) {
+                    if (!result.chunk_ids.empty()) m_db.add_symbol_link(result.chunk_ids[0], call.second, "call");
+                }
+                result.ok = m_db.set_indexed_status(batch.info.path, true);
+            }
+        }
+        m_db.end_savepoint("write_file", result.ok);
+        if (!result.ok) {
+            std::cerr << "[DatabaseWriter] Could not store " << batch.info.path.string() << ", rolled it back.\n";
+            return WriteResult{};
+        }
+        return result;
+    }
+
+}
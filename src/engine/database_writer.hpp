@@ -0,0 +1,112 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <string>
+#include <mutex>
+#include <thread>
+#include <future>
+#include <chrono>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+#include "kestr/types.hpp"
+#include "database.hpp"
+
+namespace kestr::engine {
+
+    /**
+     * @brief Everything that has to be written for one indexed file.
+     */
+    struct WriteBatch {
+        FileInfo info;
+        std::vector<Chunk> chunks;
+        std::vector<std::vector<float>> embeddings; // Empty entries keep the stored vector of an unchanged chunk
+        std::vector<std::pair<uint32_t, std::string>> calls;
+        std::vector<bool> reused; // Set by the embed stage, parallel to chunks: left to the stored vector of its content
+    };
+
+    /**
+     * @brief Outcome of a WriteBatch once its group has been committed.
+     */
+    struct WriteResult {
+        bool ok = false;
+        std::vector<int64_t> chunk_ids;   // Parallel to WriteBatch::chunks; empty unless ok
+        std::vector<int64_t> removed_ids; // Chunks of the previous version that are gone now
+        size_t missing_vectors = 0;       // Reused chunks whose stored vector was gone by the time they were written
+    };
+
+    struct WriterOptions {
+        size_t max_group_files = 256;                // Commit once this many files are pending
+        std::chrono::milliseconds max_latency{50};   // ...or once the oldest pending file waited this long
+        size_t max_pending = 1024;                   // submit() blocks above this
+    };
+
+    /**
+     * @brief Single writer thread in front of Database that group-commits file writes.
+     * Many files share one transaction, so an initial scan pays one WAL commit per
+     * group instead of one per file.
+     */
+    class DatabaseWriter {
+    public:
+        /**
+         * @brief Called on the writer thread after each successful commit, outside the DB lock.
+         */
+        using CommitHook = std::function<void(const std::vector<WriteBatch>&, const std::vector<WriteResult>&)>;
+
+        DatabaseWriter(Database& db, std::mutex& db_mutex, WriterOptions options = {});
+        ~DatabaseWriter();
+
+        void start();
+        void stop();
+
+        /**
+         * @brief Queues a file write. The future resolves after its group commits.
+         */
+        std::future<WriteResult> submit(WriteBatch batch);
+
+        /**
+         * @brief Called on the writer thread for a file that has to go through the pipeline
+         * again: its group could not be committed, or a stored vector it relied on was gone.
+         * A file is handed back at most a few times in a row, then left to the next scan.
+         */
+        using RequeueHook = std::function<void(const FileInfo&)>;
+
+        void set_commit_hook(CommitHook hook);
+        void set_requeue_hook(RequeueHook hook);
+
+        size_t pending() const;
+        size_t files_written() const { return m_files_written.load(); }
+        size_t commits() const { return m_commits.load(); }
+
+    private:
+        struct Pending {
+            WriteBatch batch;
+            std::promise<WriteResult> promise;
+            std::chrono::steady_clock::time_point enqueued;
+        };
+
+        void run();
+        WriteResult apply(const WriteBatch& batch);
+        void hand_back(const RequeueHook& requeue, const FileInfo& info);
+
+        Database& m_db;
+        std::mutex& m_db_mutex;
+        WriterOptions m_options;
+        CommitHook m_hook;
+        RequeueHook m_requeue;
+        std::unordered_map<std::string, int> m_requeues; // Writer thread only: consecutive hand-backs per path
+
+        std::deque<Pending> m_pending;
+        mutable std::mutex m_mutex;
+        std::condition_variable m_cv;
+        std::condition_variable m_space_cv;
+        bool m_stop = false;
+
+        std::thread m_thread;
+        std::atomic<size_t> m_files_written{0};
+        std::atomic<size_t> m_commits{0};
+    };
+
+}
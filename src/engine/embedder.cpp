@@ -4,6 +4,31 @@
 
 namespace kestr::engine {
 
+    std::vector<std::vector<float>> Embedder::embed_batch(const std::vector<std::string>& texts) {
+        std::vector<std::vector<float>> embeddings;
+        embeddings.reserve(texts.size());
+        for (const auto& text : texts) {
+            embeddings.push_back(embed(text));
+        }
+        return embeddings;
+    }
+
+    std::vector<std::pair<size_t, size_t>> plan_request_batches(const std::vector<std::string>& texts, size_t max_items, size_t max_bytes) {
+        std::vector<std::pair<size_t, size_t>> batches;
+        size_t begin = 0, bytes = 0;
+        for (size_t i = 0; i < texts.size(); ++i) {
+            bool full = (i - begin >= max_items) || (i > begin && bytes + texts[i].size() > max_bytes);
+            if (full) {
+                batches.emplace_back(begin, i);
+                begin = i;
+                bytes = 0;
+            }
+            bytes += texts[i].size();
+        }
+        if (begin < texts.size()) batches.emplace_back(begin, texts.size());
+        return batches;
+    }
+
     std::vector<Chunk> Chunker::chunk_file(const std::string& content, size_t chunk_size, size_t overlap) {
         std::vector<Chunk> chunks;
         std::vector<std::string> lines;
@@ -3,6 +3,7 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <utility>
 #include "kestr/types.hpp"
 
 namespace kestr::engine {
@@ -21,10 +22,32 @@ namespace kestr::engine {
          */
         virtual std::vector<float> embed(const std::string& text) = 0;
 
+        /**
+         * @brief Generates embeddings for several texts in one call.
+         * Backends that can amortise per-call overhead override this; the default
+         * simply calls embed() for every text.
+         * @param texts The input text chunks.
+         * @return One vector per input, in input order (empty on failure).
+         */
+        virtual std::vector<std::vector<float>> embed_batch(const std::vector<std::string>& texts);
+
         /**
          * @brief Returns the dimension of the vectors produced by this embedder.
          */
         virtual size_t dimension() const = 0;
+
+        /**
+         * @brief The similarity the model's vectors are meant to be compared with.
+         * All supported backends produce sentence embeddings trained for cosine similarity.
+         */
+        virtual Metric metric() const { return Metric::Cosine; }
+
+        /**
+         * @brief Identifies the model behind the vectors, e.g. "ollama:all-minilm".
+         * Cached embeddings are keyed by it so they are never shared across models.
+         * Empty if the backend's output must not be cached.
+         */
+        virtual std::string model_id() const { return ""; }
     };
 
     class Chunker {
@@ -35,8 +58,29 @@ namespace kestr::engine {
         static std::vector<Chunk> chunk_file(const std::string& content, size_t chunk_size = 500, size_t overlap = 50);
     };
 
+    /**
+     * @brief Splits texts into consecutive [begin, end) ranges for backends that take several
+     * inputs per request: at most max_items texts and max_bytes of text per range. A text
+     * larger than max_bytes gets a range of its own.
+     */
+    std::vector<std::pair<size_t, size_t>> plan_request_batches(const std::vector<std::string>& texts, size_t max_items, size_t max_bytes);
+
+    /**
+     * @brief ONNX Runtime execution profile for the local embedder.
+     */
+    struct OnnxOptions {
+        size_t intra_op_threads = 0;      // Threads inside one Run, shared by all workers (0 = half the cores)
+        size_t inter_op_threads = 1;      // Threads running independent graph nodes in parallel (1 = sequential)
+        bool allow_spinning = false;      // Busy-wait between ops instead of yielding the cores to other stages
+        bool memory_arena = true;         // Keep freed tensor memory for reuse across runs
+        size_t workers = 1;               // Inference threads taking bucketed batches off the queue
+        size_t max_tokens = 256;          // Longer chunks are truncated; MiniLM was trained on 256 word pieces
+        std::string optimized_model_dir;  // Where the optimized graph is saved, named by the model hash (empty = off)
+    };
+
     std::unique_ptr<Embedder> create_ollama_embedder(const std::string& model);
-    std::unique_ptr<Embedder> create_onnx_embedder(const std::string& model_path, const std::string& vocab_path);
+    std::unique_ptr<Embedder> create_onnx_embedder(const std::string& model_path, const std::string& vocab_path,
+                                                   const OnnxOptions& options = {});
     std::unique_ptr<Embedder> create_openai_embedder(const std::string& api_key, const std::string& model = "text-embedding-3-small");
     std::unique_ptr<Embedder> create_dummy_embedder();
 
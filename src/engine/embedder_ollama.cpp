@@ -1,7 +1,8 @@
 #include "embedder.hpp"
+#include "http_client.hpp"
 #include <nlohmann/json.hpp>
-#include <curl/curl.h>
 #include <iostream>
+#include <atomic>
 
 using json = nlohmann::json;
 
@@ -9,73 +10,119 @@ namespace kestr::engine {
 
     class OllamaEmbedder : public Embedder {
     public:
-        OllamaEmbedder(const std::string& model = "all-minilm", const std::string& endpoint = "http://localhost:11434/api/embeddings")
-            : m_model(model), m_endpoint(endpoint) {
+        OllamaEmbedder(const std::string& model = "all-minilm", const std::string& host = "http://localhost:11434")
+            : m_model(model), m_batch_endpoint(host + "/api/embed"), m_legacy_endpoint(host + "/api/embeddings") {
         }
 
         ~OllamaEmbedder() {
         }
 
         std::vector<float> embed(const std::string& text) override {
-            CURL* curl = curl_easy_init();
-            std::vector<float> embedding;
+            auto embeddings = embed_batch({text});
+            return embeddings.empty() ? std::vector<float>() : std::move(embeddings[0]);
+        }
 
-            if (curl) {
-                std::string json_str;
-                try {
-                    json body = {
-                        {"model", m_model},
-                        {"prompt", text}
-                    };
-                    json_str = body.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
-                } catch (const std::exception& e) {
-                    std::cerr << "[OllamaEmbedder] JSON serialization error: " << e.what() << "\n";
-                    curl_easy_cleanup(curl);
-                    return embedding;
+        std::vector<std::vector<float>> embed_batch(const std::vector<std::string>& texts) override {
+            std::vector<std::vector<float>> embeddings(texts.size());
+            for (const auto& [begin, end] : plan_request_batches(texts, kMaxBatchSize, kMaxBatchBytes)) {
+                if (m_legacy) {
+                    for (size_t i = begin; i < end; ++i) embeddings[i] = embed_legacy(texts[i]);
+                    continue;
+                }
+
+                json body = {
+                    {"model", m_model},
+                    {"input", json::array()}
+                };
+                for (size_t i = begin; i < end; ++i) body["input"].push_back(texts[i]);
+
+                long status = 0;
+                auto response = post(m_batch_endpoint, body, status);
+                // Ollama before 0.3 only has the single-prompt endpoint and answers with a plain-text
+                // 404; a missing model is a 404 too, but with a JSON error, and must not switch over
+                if (status == 404 && !(response.is_object() && response.contains("error"))) {
+                    std::cerr << "[OllamaEmbedder] /api/embed not available, falling back to /api/embeddings\n";
+                    m_legacy = true;
+                    for (size_t i = begin; i < end; ++i) embeddings[i] = embed_legacy(texts[i]);
+                    continue;
                 }
 
-                struct curl_slist* headers = nullptr;
-                headers = curl_slist_append(headers, "Content-Type: application/json");
-
-                std::string response_string;
-                curl_easy_setopt(curl, CURLOPT_URL, m_endpoint.c_str());
-                curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_str.c_str());
-                curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-                curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-                curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_string);
-
-                CURLcode res = curl_easy_perform(curl);
-                if (res != CURLE_OK) {
-                    std::cerr << "[OllamaEmbedder] curl_easy_perform() failed: " << curl_easy_strerror(res) << "\n";
-                } else {
-                    try {
-                        auto resp_json = json::parse(response_string);
-                        if (resp_json.contains("embedding")) {
-                            embedding = resp_json["embedding"].get<std::vector<float>>();
-                            m_dimension = embedding.size();
+                try {
+                    if (response.contains("embeddings") && response["embeddings"].size() == end - begin) {
+                        // Returned in input order
+                        for (size_t i = begin; i < end; ++i) {
+                            embeddings[i] = response["embeddings"][i - begin].get<std::vector<float>>();
+                            if (!embeddings[i].empty()) m_dimension = embeddings[i].size();
                         }
-                    } catch (const std::exception& e) {
-                        std::cerr << "[OllamaEmbedder] JSON parse error: " << e.what() << "\n";
+                    } else if (response.contains("error")) {
+                        std::cerr << "[OllamaEmbedder] API Error: " << response["error"].dump() << "\n";
                     }
+                } catch (const std::exception& e) {
+                    std::cerr << "[OllamaEmbedder] JSON parse error: " << e.what() << "\n";
                 }
-
-                curl_slist_free_all(headers);
-                curl_easy_cleanup(curl);
             }
-
-            return embedding;
+            return embeddings;
         }
 
         size_t dimension() const override { return m_dimension; }
+        std::string model_id() const override { return "ollama:" + m_model; }
 
     private:
+        // Inputs per /api/embed request, and their total size; Ollama truncates each input to the model's context
+        static constexpr size_t kMaxBatchSize = 64;
+        static constexpr size_t kMaxBatchBytes = 512 * 1024;
+
         std::string m_model;
-        std::string m_endpoint;
-        size_t m_dimension = 0;
+        std::string m_batch_endpoint;
+        std::string m_legacy_endpoint;
+        std::atomic<size_t> m_dimension{0};
+        std::atomic<bool> m_legacy{false};
+        HttpClient m_http;
 
-        static size_t WriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
-            ((std::string*)userp)->append((char*)contents, size * nmemb);
-            return size * nmemb;
+        std::vector<float> embed_legacy(const std::string& text) {
+            std::vector<float> embedding;
+            json body = {
+                {"model", m_model},
+                {"prompt", text}
+            };
+            long status = 0;
+            auto response = post(m_legacy_endpoint, body, status);
+            try {
+                if (response.contains("embedding")) {
+                    embedding = response["embedding"].get<std::vector<float>>();
+                    m_dimension = embedding.size();
+                }
+            } catch (const std::exception& e) {
+                std::cerr << "[OllamaEmbedder] JSON parse error: " << e.what() << "\n";
+            }
+            return embedding;
+        }
+
+        /**
+         * @brief POSTs body and parses the reply; null on transport or parse errors.
+         */
+        json post(const std::string& url, const json& body, long& status) {
+            json result;
+            std::string json_str;
+            try {
+                json_str = body.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+            } catch (const std::exception& e) {
+                std::cerr << "[OllamaEmbedder] JSON serialization error: " << e.what() << "\n";
+                return result;
+            }
+
+            auto response = m_http.post(url, json_str);
+            if (!response.ok) {
+                std::cerr << "[OllamaEmbedder] Request failed: " << response.error << "\n";
+                return result;
+            }
+            status = response.status;
+            try {
+                result = json::parse(response.body);
+            } catch (const std::exception& e) {
+                if (status != 404) std::cerr << "[OllamaEmbedder] JSON parse error: " << e.what() << "\n";
+            }
+            return result;
         }
     };
 
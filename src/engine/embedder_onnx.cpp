@@ -1,10 +1,16 @@
 #include "embedder.hpp"
 #include "tokenizer.hpp"
+#include "job_queue.hpp"
+#include "kestr/sha256.h"
 #include <iostream>
 #include <vector>
 #include <numeric>
 #include <cmath>
 #include <filesystem>
+#include <algorithm>
+#include <thread>
+#include <future>
+#include <atomic>
 
 #ifdef KESTR_WITH_ONNX
 #include <onnxruntime_cxx_api.h>
@@ -14,7 +20,8 @@ namespace kestr::engine {
 
     class OnnxEmbedder : public Embedder {
     public:
-        OnnxEmbedder(const std::string& model_path, const std::string& vocab_path) {
+        OnnxEmbedder(const std::string& model_path, const std::string& vocab_path, const OnnxOptions& options)
+            : m_max_tokens(std::max<size_t>(2, options.max_tokens)), m_jobs(std::max<size_t>(1, options.workers) * 2) {
 #ifdef KESTR_WITH_ONNX
             if (!std::filesystem::exists(model_path) || !std::filesystem::exists(vocab_path)) {
                 std::cerr << "[OnnxEmbedder] Model or Vocab file not found.\n";
@@ -24,100 +31,295 @@ namespace kestr::engine {
             try {
                 // 1. Initialize Environment
                 m_env = std::make_unique<Ort::Env>(ORT_LOGGING_LEVEL_WARNING, "kestr");
-                
-                // 2. Load Model
-                Ort::SessionOptions session_options;
-                session_options.SetIntraOpNumThreads(1);
-                session_options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
-                
-                m_session = std::make_unique<Ort::Session>(*m_env, model_path.c_str(), session_options);
+
+                // Hashed once here: two models of the same size (or a re-exported one) must not share
+                // cached vectors or a saved graph. Truncation changes the vectors too.
+                std::string model_hash = kestr::crypto::SHA256::hash_file(model_path);
+                std::string vocab_hash = kestr::crypto::SHA256::hash_file(vocab_path);
+                m_model_id = "onnx:" + model_hash.substr(0, 16) + ":" + vocab_hash.substr(0, 16) + ":" + std::to_string(m_max_tokens);
+
+                // 2. Load Model, from the graph saved for exactly these model bytes when there is one
+                std::filesystem::path model = model_path;
+                if (!options.optimized_model_dir.empty()) {
+                    std::filesystem::path optimized = std::filesystem::path(options.optimized_model_dir) /
+                                (model.stem().string() + "." + model_hash.substr(0, 16) + ".optimized.onnx");
+                    try {
+                        if (!std::filesystem::exists(optimized)) {
+                            remove_stale_graphs(options.optimized_model_dir, model.stem().string());
+                            Ort::Session saver(*m_env, model.c_str(), session_options(options, optimized)); // Writes the graph
+                        }
+                        m_session = std::make_unique<Ort::Session>(*m_env, optimized.c_str(), session_options(options));
+                        std::cout << "[OnnxEmbedder] Loaded optimized model: " << optimized << "\n";
+                    } catch (const Ort::Exception& e) {
+                        // Not writable, written by another ONNX Runtime version or truncated; built again next start
+                        std::cerr << "[OnnxEmbedder] Discarding optimized model: " << e.what() << "\n";
+                        std::error_code ec;
+                        std::filesystem::remove(optimized, ec);
+                    }
+                }
+                if (!m_session) {
+                    m_session = std::make_unique<Ort::Session>(*m_env, model.c_str(), session_options(options));
+                    std::cout << "[OnnxEmbedder] Loaded: " << model_path << "\n";
+                }
                 m_tokenizer = std::make_unique<Tokenizer>(vocab_path);
-                
-                std::cout << "[OnnxEmbedder] Loaded: " << model_path << "\n";
                 m_ready = true;
             } catch (const Ort::Exception& e) {
                 std::cerr << "[OnnxEmbedder] Initialization failed: " << e.what() << "\n";
+                return;
             }
+
+            size_t workers = std::max<size_t>(1, options.workers);
+            for (size_t i = 0; i < workers; ++i) m_workers.emplace_back([this] { worker_loop(); });
 #else
+            (void)options;
             std::cerr << "[OnnxEmbedder] Compiled without ONNX Runtime support.\n";
 #endif
         }
 
+        ~OnnxEmbedder() {
+            m_jobs.stop();
+            for (auto& t : m_workers) t.join();
+        }
+
         std::vector<float> embed(const std::string& text) override {
-            std::vector<float> embedding;
+            auto embeddings = embed_batch({text});
+            return embeddings.empty() ? std::vector<float>() : std::move(embeddings[0]);
+        }
+
+        std::vector<std::vector<float>> embed_batch(const std::vector<std::string>& texts) override {
+            std::vector<std::vector<float>> embeddings(texts.size());
+#ifdef KESTR_WITH_ONNX
+            if (!m_ready || texts.empty()) return embeddings;
+
+            // 1. Tokenize everything up front so we can bucket by length
+            std::vector<std::vector<int64_t>> tokens(texts.size());
+            for (size_t i = 0; i < texts.size(); ++i) {
+                m_tokenizer->encode(texts[i], tokens[i], nullptr, m_max_tokens);
+            }
+
+            std::vector<size_t> order(texts.size());
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+                return tokens[a].size() < tokens[b].size();
+            });
+
+            // 2. Group similar lengths so padding stays small, one Run per bucket.
+            // Buckets go to the inference workers; each writes only its own members' slots.
+            std::vector<std::future<void>> pending;
+            auto submit = [&](std::vector<size_t> members) {
+                Job job;
+                job.tokens = &tokens;
+                job.members = std::move(members);
+                job.out = &embeddings;
+                pending.push_back(job.done.get_future());
+                if (!m_jobs.push(std::move(job))) pending.pop_back(); // Shutting down
+            };
+
+            std::vector<size_t> bucket;
+            for (size_t idx : order) {
+                size_t len = tokens[idx].size();
+                if (!bucket.empty()) {
+                    size_t shortest = tokens[bucket.front()].size();
+                    bool too_many = bucket.size() >= kMaxBatchSize;
+                    bool too_large = (bucket.size() + 1) * len > kMaxBatchTokens;
+                    bool too_uneven = len > shortest + shortest / 4 + kPaddingSlack;
+                    if (too_many || too_large || too_uneven) {
+                        submit(std::move(bucket));
+                        bucket.clear();
+                    }
+                }
+                bucket.push_back(idx);
+            }
+            if (!bucket.empty()) submit(std::move(bucket));
+            for (auto& f : pending) f.wait();
+#endif
+            return embeddings;
+        }
+
+        size_t dimension() const override { return 384; }
+        std::string model_id() const override { return m_model_id; }
+
+    private:
+        // Bucketing limits: a bucket is cut when it holds too many sequences, too many
+        // padded tokens, or when the next sequence would add excessive padding.
+        static constexpr size_t kMaxBatchSize = 32;
+        static constexpr size_t kMaxBatchTokens = 16384;
+        static constexpr size_t kPaddingSlack = 8;
+
+        /**
+         * @brief One bucket of an embed_batch() call; the caller keeps tokens and out alive until done.
+         */
+        struct Job {
+            const std::vector<std::vector<int64_t>>* tokens = nullptr;
+            std::vector<size_t> members;
+            std::vector<std::vector<float>>* out = nullptr;
+            std::promise<void> done;
+        };
+
+        size_t m_max_tokens;
+        bool m_ready = false;
+        std::string m_model_id; // Empty until the model loaded, so failed runs are never cached
+        BoundedQueue<Job> m_jobs;
+        std::vector<std::thread> m_workers;
 #ifdef KESTR_WITH_ONNX
-            if (!m_ready) return embedding;
+        /**
+         * @brief Session options for the profile. A saved optimized graph is loaded as is;
+         * otherwise the full optimization runs and, if save_to is set, is written there.
+         */
+        static Ort::SessionOptions session_options(const OnnxOptions& options, const std::filesystem::path& save_to = {}) {
+            size_t intra = options.intra_op_threads;
+            if (intra == 0) intra = std::max<size_t>(1, std::thread::hardware_concurrency() / 2);
 
-            // 1. Tokenize
-            auto input_ids = m_tokenizer->encode(text);
-            size_t batch_size = 1;
-            size_t seq_length = input_ids.size();
-            
-            std::vector<int64_t> token_type_ids(seq_length, 0);
-            std::vector<int64_t> attention_mask(seq_length, 1);
+            Ort::SessionOptions so;
+            so.SetIntraOpNumThreads(static_cast<int>(intra));
+            so.SetInterOpNumThreads(static_cast<int>(std::max<size_t>(1, options.inter_op_threads)));
+            so.SetExecutionMode(options.inter_op_threads > 1 ? ExecutionMode::ORT_PARALLEL : ExecutionMode::ORT_SEQUENTIAL);
+            so.AddConfigEntry("session.intra_op.allow_spinning", options.allow_spinning ? "1" : "0");
+            so.AddConfigEntry("session.inter_op.allow_spinning", options.allow_spinning ? "1" : "0");
+            if (options.memory_arena) so.EnableCpuMemArena();
+            else so.DisableCpuMemArena();
+
+            if (!save_to.empty()) {
+                // Layout passes of ENABLE_ALL are specific to this CPU; the saved graph stops short of them
+                so.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_EXTENDED);
+                so.SetOptimizedModelFilePath(save_to.c_str());
+            } else {
+                // A saved graph only has the layout passes left, which are quick
+                so.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+            }
+            return so;
+        }
+
+        /**
+         * @brief Removes graphs saved for earlier versions of the model, named <stem>.<hash>.optimized.onnx.
+         */
+        static void remove_stale_graphs(const std::filesystem::path& dir, const std::string& stem) {
+            std::error_code ec;
+            for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+                std::string name = entry.path().filename().string();
+                const std::string suffix = ".optimized.onnx";
+                if (name == stem + suffix) { // Unhashed name of older versions
+                    std::filesystem::remove(entry.path(), ec);
+                    continue;
+                }
+                if (name.size() != stem.size() + 17 + suffix.size() || name.compare(0, stem.size() + 1, stem + ".") != 0 ||
+                    name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) continue;
+                std::string hash = name.substr(stem.size() + 1, 16);
+                if (hash.find_first_not_of("0123456789abcdef") == std::string::npos) std::filesystem::remove(entry.path(), ec);
+            }
+        }
+
+        /**
+         * @brief Per-worker binding and buffers, reused across runs so steady-state
+         * inference allocates nothing once the buffers reached the largest bucket.
+         */
+        struct WorkerBuffers {
+            std::unique_ptr<Ort::IoBinding> binding;
+            std::vector<int64_t> input_ids;
+            std::vector<int64_t> attention_mask;
+            std::vector<int64_t> token_type_ids;
+            std::vector<float> hidden;
+        };
+
+        void worker_loop() {
+            WorkerBuffers buffers;
+            buffers.binding = std::make_unique<Ort::IoBinding>(*m_session);
+            Job job;
+            while (m_jobs.pop(job)) {
+                try {
+                    run_bucket(*job.tokens, job.members, *job.out, buffers);
+                } catch (const std::exception& e) {
+                    std::cerr << "[OnnxEmbedder] Inference failed: " << e.what() << "\n";
+                    buffers.binding->ClearBoundInputs();
+                    buffers.binding->ClearBoundOutputs();
+                }
+                job.done.set_value();
+            }
+        }
+
+        void run_bucket(const std::vector<std::vector<int64_t>>& tokens, const std::vector<size_t>& members,
+                        std::vector<std::vector<float>>& out, WorkerBuffers& buffers) {
+            size_t batch_size = members.size();
+            size_t seq_length = 0;
+            for (size_t idx : members) seq_length = std::max(seq_length, tokens[idx].size());
+
+            // Right-pad with [PAD] (id 0) and mask the padding out
+            size_t n = batch_size * seq_length;
+            buffers.input_ids.assign(n, 0);
+            buffers.attention_mask.assign(n, 0);
+            buffers.token_type_ids.assign(n, 0);
+            for (size_t b = 0; b < batch_size; ++b) {
+                const auto& ids = tokens[members[b]];
+                std::copy(ids.begin(), ids.end(), buffers.input_ids.begin() + b * seq_length);
+                std::fill_n(buffers.attention_mask.begin() + b * seq_length, ids.size(), 1);
+            }
 
-            // 2. Prepare Tensors
             std::vector<int64_t> input_shape = { (int64_t)batch_size, (int64_t)seq_length };
-            
-            auto memory_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
-            
-            std::vector<Ort::Value> input_tensors;
-            input_tensors.push_back(Ort::Value::CreateTensor<int64_t>(memory_info, input_ids.data(), input_ids.size(), input_shape.data(), input_shape.size()));
-            input_tensors.push_back(Ort::Value::CreateTensor<int64_t>(memory_info, attention_mask.data(), attention_mask.size(), input_shape.data(), input_shape.size()));
-            input_tensors.push_back(Ort::Value::CreateTensor<int64_t>(memory_info, token_type_ids.data(), token_type_ids.size(), input_shape.data(), input_shape.size()));
-
-            const char* input_names[] = { "input_ids", "attention_mask", "token_type_ids" };
-            const char* output_names[] = { "last_hidden_state" }; // Adjust based on model inspection if needed
-
-            // 3. Run
-            try {
-                auto output_tensors = m_session->Run(Ort::RunOptions{nullptr}, input_names, input_tensors.data(), 3, output_names, 1);
-                
-                // 4. Extract & Mean Pooling
-                // Output shape: [batch, seq, hidden_size] (e.g., 1, 512, 384)
-                float* float_data = output_tensors[0].GetTensorMutableData<float>();
-                auto type_info = output_tensors[0].GetTensorTypeAndShapeInfo();
-                auto shape = type_info.GetShape();
-                size_t hidden_size = shape[2];
-                
-                embedding.resize(hidden_size, 0.0f);
-
-                // Mean pooling: Sum vectors where mask=1, divide by count
-                for (size_t i = 0; i < seq_length; ++i) {
+            auto memory_info = Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeDefault);
+
+            auto input_ids = Ort::Value::CreateTensor<int64_t>(memory_info, buffers.input_ids.data(), n, input_shape.data(), input_shape.size());
+            auto attention_mask = Ort::Value::CreateTensor<int64_t>(memory_info, buffers.attention_mask.data(), n, input_shape.data(), input_shape.size());
+            auto token_type_ids = Ort::Value::CreateTensor<int64_t>(memory_info, buffers.token_type_ids.data(), n, input_shape.data(), input_shape.size());
+            Ort::IoBinding& binding = *buffers.binding;
+            binding.BindInput("input_ids", input_ids);
+            binding.BindInput("attention_mask", attention_mask);
+            binding.BindInput("token_type_ids", token_type_ids);
+
+            // Output shape: [batch, seq, hidden_size] (e.g., 32, 128, 384). Once a run told us
+            // hidden_size, ORT writes straight into our buffer instead of allocating a tensor.
+            size_t hidden_size = m_hidden_size;
+            std::vector<Ort::Value> outputs;
+            const float* float_data = nullptr;
+            if (hidden_size > 0) {
+                buffers.hidden.resize(n * hidden_size);
+                std::vector<int64_t> output_shape = { (int64_t)batch_size, (int64_t)seq_length, (int64_t)hidden_size };
+                auto output = Ort::Value::CreateTensor<float>(memory_info, buffers.hidden.data(), buffers.hidden.size(), output_shape.data(), output_shape.size());
+                binding.BindOutput("last_hidden_state", output);
+                m_session->Run(Ort::RunOptions{nullptr}, binding);
+                float_data = buffers.hidden.data();
+            } else {
+                binding.BindOutput("last_hidden_state", memory_info);
+                m_session->Run(Ort::RunOptions{nullptr}, binding);
+                outputs = binding.GetOutputValues();
+                float_data = outputs[0].GetTensorMutableData<float>();
+                hidden_size = outputs[0].GetTensorTypeAndShapeInfo().GetShape()[2];
+                m_hidden_size = hidden_size;
+            }
+            binding.ClearBoundInputs();
+            binding.ClearBoundOutputs();
+
+            for (size_t b = 0; b < batch_size; ++b) {
+                // Mean pooling over real tokens only, then L2 normalize
+                std::vector<float> embedding(hidden_size, 0.0f);
+                size_t real_tokens = tokens[members[b]].size();
+                const float* row = float_data + b * seq_length * hidden_size;
+                for (size_t i = 0; i < real_tokens; ++i) {
                     for (size_t j = 0; j < hidden_size; ++j) {
-                        embedding[j] += float_data[i * hidden_size + j];
+                        embedding[j] += row[i * hidden_size + j];
                     }
                 }
-                
-                // Normalize
+
                 float norm = 0.0f;
                 for (float& val : embedding) {
-                    val /= (float)seq_length;
+                    val /= (float)real_tokens;
                     norm += val * val;
                 }
                 norm = std::sqrt(norm);
                 for (float& val : embedding) val /= (norm + 1e-9f); // Avoid div/0
 
-            } catch (const Ort::Exception& e) {
-                std::cerr << "[OnnxEmbedder] Inference failed: " << e.what() << "\n";
+                out[members[b]] = std::move(embedding);
             }
-#endif
-            return embedding;
         }
 
-        size_t dimension() const override { return 384; }
-
-    private:
-        bool m_ready = false;
-#ifdef KESTR_WITH_ONNX
         std::unique_ptr<Ort::Env> m_env;
-        std::unique_ptr<Ort::Session> m_session;
+        std::unique_ptr<Ort::Session> m_session; // Run() is thread-safe; all workers share it
         std::unique_ptr<Tokenizer> m_tokenizer;
+        std::atomic<size_t> m_hidden_size{0};
 #endif
     };
 
-    std::unique_ptr<Embedder> create_onnx_embedder(const std::string& model_path, const std::string& vocab_path) {
-        return std::make_unique<OnnxEmbedder>(model_path, vocab_path);
+    std::unique_ptr<Embedder> create_onnx_embedder(const std::string& model_path, const std::string& vocab_path, const OnnxOptions& options) {
+        return std::make_unique<OnnxEmbedder>(model_path, vocab_path, options);
     }
 
-}
\ No newline at end of file
+}
@@ -1,8 +1,9 @@
 #include "embedder.hpp"
+#include "http_client.hpp"
 #include <nlohmann/json.hpp>
-#include <curl/curl.h>
 #include <iostream>
 #include <cstdlib>
+#include <atomic>
 
 using json = nlohmann::json;
 
@@ -18,62 +19,125 @@ namespace kestr::engine {
         }
 
         std::vector<float> embed(const std::string& text) override {
-            CURL* curl = curl_easy_init();
-            std::vector<float> embedding;
-
-            if (curl) {
-                json body = {
-                    {"model", m_model},
-                    {"input", text}
-                };
-                std::string json_str = body.dump();
-
-                struct curl_slist* headers = nullptr;
-                headers = curl_slist_append(headers, "Content-Type: application/json");
-                std::string auth_header = "Authorization: Bearer " + m_api_key;
-                headers = curl_slist_append(headers, auth_header.c_str());
-
-                std::string response_string;
-                curl_easy_setopt(curl, CURLOPT_URL, "https://api.openai.com/v1/embeddings");
-                curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_str.c_str());
-                curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-                curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-                curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_string);
-
-                CURLcode res = curl_easy_perform(curl);
-                if (res != CURLE_OK) {
-                    std::cerr << "[OpenAIEmbedder] curl_easy_perform() failed: " << curl_easy_strerror(res) << "\n";
-                } else {
-                    try {
-                        auto resp_json = json::parse(response_string);
-                        if (resp_json.contains("error")) {
-                             std::cerr << "[OpenAIEmbedder] API Error: " << resp_json["error"].dump() << "\n";
-                        } else if (resp_json.contains("data") && !resp_json["data"].empty()) {
-                            embedding = resp_json["data"][0]["embedding"].get<std::vector<float>>();
-                            m_dimension = embedding.size();
-                        }
-                    } catch (const std::exception& e) {
-                        std::cerr << "[OpenAIEmbedder] JSON parse error: " << e.what() << "\n";
-                    }
-                }
+            auto embeddings = embed_batch({text});
+            return embeddings.empty() ? std::vector<float>() : std::move(embeddings[0]);
+        }
 
-                curl_slist_free_all(headers);
-                curl_easy_cleanup(curl);
+        std::vector<std::vector<float>> embed_batch(const std::vector<std::string>& texts) override {
+            std::vector<std::vector<float>> embeddings(texts.size());
+            for (const auto& [begin, end] : plan_request_batches(texts, kMaxBatchSize, kMaxBatchBytes)) {
+                // A bad key, an unknown model or a rate limit fails every later request the same way
+                if (!embed_range(texts, begin, end, kMaxInputBytes, embeddings)) break;
             }
-
-            return embedding;
+            return embeddings;
         }
 
         size_t dimension() const override { return m_dimension; }
+        std::string model_id() const override { return "openai:" + m_model; }
 
     private:
+        // The API takes at most 2048 inputs and 300k tokens per request and 8192 tokens per input.
+        // Bytes per token vary (dense code or non-Latin text gets close to 2), so the byte budgets
+        // are only a first guess and a rejected request is split until it fits.
+        static constexpr size_t kMaxBatchSize = 2048;
+        static constexpr size_t kMaxBatchBytes = 800 * 1024;
+        static constexpr size_t kMaxInputBytes = 16 * 1024;
+        static constexpr size_t kMinInputBytes = 1024; // A single input is not cut shorter than this
+
         std::string m_api_key;
         std::string m_model;
-        size_t m_dimension = 0;
+        std::atomic<size_t> m_dimension{0};
+        HttpClient m_http;
+
+        /**
+         * @brief Embeds texts[begin, end) into out. A request the API rejects for too many tokens is
+         * bisected and each half retried; a single input is cut shorter instead.
+         * @return false if the request failed for a reason that smaller requests would not fix.
+         */
+        bool embed_range(const std::vector<std::string>& texts, size_t begin, size_t end, size_t max_input,
+                         std::vector<std::vector<float>>& out) {
+            json body = {
+                {"model", m_model},
+                {"input", json::array()}
+            };
+            for (size_t i = begin; i < end; ++i) body["input"].push_back(clip(texts[i], max_input));
+
+            long status = 0;
+            auto response = post(body, status);
+            try {
+                if (response.contains("error")) {
+                    // Auth, model, rate limit and server errors are not fixed by smaller requests
+                    bool too_large = is_size_error(status, response["error"]);
+                    if (too_large && end - begin > 1) {
+                        size_t mid = begin + (end - begin) / 2;
+                        return embed_range(texts, begin, mid, max_input, out) &&
+                               embed_range(texts, mid, end, max_input, out);
+                    }
+                    if (too_large && max_input / 2 >= kMinInputBytes && texts[begin].size() > max_input / 2) {
+                        return embed_range(texts, begin, end, max_input / 2, out);
+                    }
+                    std::cerr << "[OpenAIEmbedder] API Error (HTTP " << status << "): " << response["error"].dump() << "\n";
+                    // An input that stays too long even when cut is skipped, the rest goes on
+                    return too_large;
+                } else if (response.contains("data")) {
+                    // Each item carries the index of its input; don't rely on the order
+                    for (const auto& item : response["data"]) {
+                        size_t index = item.value("index", size_t(0));
+                        if (begin + index >= end) continue;
+                        out[begin + index] = item["embedding"].get<std::vector<float>>();
+                        if (!out[begin + index].empty()) m_dimension = out[begin + index].size();
+                    }
+                }
+            } catch (const std::exception& e) {
+                std::cerr << "[OpenAIEmbedder] JSON parse error: " << e.what() << "\n";
+            }
+            // A transport failure or an unreadable reply most likely hits the next request too
+            return response.contains("data");
+        }
+
+        /**
+         * @brief True if the API refused the request for its token count. The same
+         * invalid_request_error type also covers a bad key or an unknown model.
+         */
+        static bool is_size_error(long status, const json& error) {
+            if (status != 400 || !error.is_object()) return false;
+            std::string code = error.contains("code") && error["code"].is_string() ? error["code"].get<std::string>() : "";
+            if (code == "context_length_exceeded" || code == "max_tokens_per_request") return true;
+            // Embedding requests over the limit often come back without a code
+            std::string message = error.contains("message") && error["message"].is_string() ? error["message"].get<std::string>() : "";
+            return message.find("maximum context length") != std::string::npos ||
+                   message.find("tokens per request") != std::string::npos;
+        }
 
-        static size_t WriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
-            ((std::string*)userp)->append((char*)contents, size * nmemb);
-            return size * nmemb;
+        /**
+         * @brief Cuts an oversized input at a UTF-8 boundary so it cannot fail the whole request.
+         */
+        static std::string clip(const std::string& text, size_t max_bytes) {
+            if (text.size() <= max_bytes) return text;
+            size_t cut = max_bytes;
+            while (cut > 0 && (static_cast<unsigned char>(text[cut]) & 0xC0) == 0x80) --cut;
+            return text.substr(0, cut);
+        }
+
+        /**
+         * @brief POSTs body to the embeddings endpoint and parses the reply; null on transport or parse errors.
+         * @param status Set to the HTTP status, 0 if the transfer failed.
+         */
+        json post(const json& body, long& status) {
+            json result;
+            std::string json_str = body.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+            auto response = m_http.post("https://api.openai.com/v1/embeddings", json_str, {"Authorization: Bearer " + m_api_key});
+            if (!response.ok) {
+                std::cerr << "[OpenAIEmbedder] Request failed: " << response.error << "\n";
+                return result;
+            }
+            status = response.status;
+            try {
+                result = json::parse(response.body);
+            } catch (const std::exception& e) {
+                std::cerr << "[OpenAIEmbedder] JSON parse error: " << e.what() << "\n";
+            }
+            return result;
         }
     };
 
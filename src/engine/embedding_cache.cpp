@@ -0,0 +1,116 @@
+#include "embedding_cache.hpp"
+#include "kestr/sha256.h"
+#include <unordered_map>
+
+namespace kestr::engine {
+
+    CachingEmbedder::CachingEmbedder(Embedder& backend, Database& db, std::mutex& db_mutex, size_t capacity)
+        : m_backend(backend), m_db(db), m_db_mutex(db_mutex), m_lru(capacity) {}
+
+    std::string CachingEmbedder::normalize(const std::string& text) {
+        std::string out;
+        out.reserve(text.size());
+        size_t start = 0;
+        while (start < text.size()) {
+            size_t end = text.find('\n', start);
+            if (end == std::string::npos) end = text.size();
+            size_t last = end;
+            while (last > start && (text[last - 1] == ' ' || text[last - 1] == '\t' || text[last - 1] == '\r')) --last;
+            out.append(text, start, last - start);
+            out += '\n';
+            start = end + 1;
+        }
+        while (!out.empty() && out.back() == '\n') out.pop_back();
+        return out;
+    }
+
+    std::string CachingEmbedder::cache_key(const std::string& model_id, const std::string& text) {
+        std::string normalized = normalize(text);
+        kestr::crypto::SHA256 sha;
+        sha.update(model_id.data(), model_id.size());
+        sha.update("\0", 1); // Keeps "a" + "bc" apart from "ab" + "c"
+        sha.update(normalized.data(), normalized.size());
+        return sha.final();
+    }
+
+    bool CachingEmbedder::lookup(const std::string& key, std::vector<float>& out) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_lru.get(key, out);
+    }
+
+    void CachingEmbedder::remember(const std::string& key, const std::vector<float>& vector) {
+        if (vector.empty()) return;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_lru.put(key, vector);
+    }
+
+    std::vector<float> CachingEmbedder::embed(const std::string& text) {
+        auto embeddings = embed_batch({text});
+        return embeddings.empty() ? std::vector<float>() : std::move(embeddings[0]);
+    }
+
+    std::vector<std::vector<float>> CachingEmbedder::embed_batch(const std::vector<std::string>& texts) {
+        std::string model = m_backend.model_id();
+        if (model.empty()) return m_backend.embed_batch(texts);
+
+        std::vector<std::vector<float>> embeddings(texts.size());
+        std::vector<std::string> keys(texts.size());
+
+        // 1. In-memory LRU; duplicates within the batch are grouped under their key
+        std::unordered_map<std::string, std::vector<size_t>> missing;
+        std::vector<std::string> missing_keys;
+        for (size_t i = 0; i < texts.size(); ++i) {
+            keys[i] = cache_key(model, texts[i]);
+            if (lookup(keys[i], embeddings[i])) {
+                ++m_memory_hits;
+                continue;
+            }
+            auto& slots = missing[keys[i]];
+            if (slots.empty()) missing_keys.push_back(keys[i]);
+            slots.push_back(i);
+        }
+        if (missing_keys.empty()) return embeddings;
+
+        // 2. Persistent cache
+        std::unordered_map<std::string, std::vector<float>> stored;
+        {
+            std::lock_guard<std::mutex> lock(m_db_mutex);
+            stored = m_db.get_cached_embeddings(missing_keys);
+        }
+        std::vector<std::string> todo_keys;
+        std::vector<std::string> todo_texts;
+        for (const auto& key : missing_keys) {
+            const auto& slots = missing[key];
+            auto it = stored.find(key);
+            if (it == stored.end()) {
+                todo_keys.push_back(key);
+                todo_texts.push_back(texts[slots.front()]);
+                continue;
+            }
+            m_disk_hits += slots.size();
+            for (size_t i : slots) embeddings[i] = it->second;
+            remember(key, it->second);
+        }
+        if (todo_texts.empty()) return embeddings;
+
+        // 3. Backend, each distinct text once
+        m_misses += todo_texts.size();
+        auto fresh = m_backend.embed_batch(todo_texts);
+        fresh.resize(todo_texts.size());
+
+        std::vector<std::pair<std::string, std::vector<float>>> entries;
+        entries.reserve(todo_keys.size());
+        for (size_t k = 0; k < todo_keys.size(); ++k) {
+            if (fresh[k].empty()) continue; // Failed calls are retried next time
+            for (size_t i : missing[todo_keys[k]]) embeddings[i] = fresh[k];
+            remember(todo_keys[k], fresh[k]);
+            entries.emplace_back(todo_keys[k], std::move(fresh[k]));
+        }
+        if (!entries.empty()) {
+            std::lock_guard<std::mutex> lock(m_db_mutex);
+            m_db.put_cached_embeddings(entries);
+        }
+        return embeddings;
+    }
+
+}
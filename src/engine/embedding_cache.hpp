@@ -0,0 +1,64 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include "embedder.hpp"
+#include "database.hpp"
+#include "lru_cache.hpp"
+
+namespace kestr::engine {
+
+    /**
+     * @brief Content-addressed embedding cache in front of another Embedder.
+     * Vectors are keyed by SHA-256(model id + normalized text), so identical chunks in
+     * vendored copies, license headers or other worktrees of the same repository are
+     * embedded once. Lookups go to an in-memory LRU first, then to the embedding_cache
+     * table; only the remaining texts reach the backend, each distinct text once per batch.
+     * Backends without a model_id() are passed through uncached.
+     * Thread-safe; the database is only touched with db_mutex held.
+     */
+    class CachingEmbedder : public Embedder {
+    public:
+        /**
+         * @param capacity Vectors kept in the in-memory LRU.
+         */
+        CachingEmbedder(Embedder& backend, Database& db, std::mutex& db_mutex, size_t capacity = 10000);
+
+        std::vector<float> embed(const std::string& text) override;
+        std::vector<std::vector<float>> embed_batch(const std::vector<std::string>& texts) override;
+
+        size_t dimension() const override { return m_backend.dimension(); }
+        Metric metric() const override { return m_backend.metric(); }
+        std::string model_id() const override { return m_backend.model_id(); }
+
+        /**
+         * @brief Canonical form of a chunk for hashing: LF line endings, no trailing
+         * whitespace on any line and no trailing blank lines.
+         */
+        static std::string normalize(const std::string& text);
+
+        static std::string cache_key(const std::string& model_id, const std::string& text);
+
+        size_t memory_hits() const { return m_memory_hits.load(); }
+        size_t disk_hits() const { return m_disk_hits.load(); }
+        size_t misses() const { return m_misses.load(); }
+
+    private:
+        bool lookup(const std::string& key, std::vector<float>& out);
+        void remember(const std::string& key, const std::vector<float>& vector);
+
+        Embedder& m_backend;
+        Database& m_db;
+        std::mutex& m_db_mutex;
+
+        std::mutex m_mutex; // Guards the LRU
+        LruCache<std::vector<float>> m_lru;
+
+        std::atomic<size_t> m_memory_hits{0};
+        std::atomic<size_t> m_disk_hits{0};
+        std::atomic<size_t> m_misses{0};
+    };
+
+}
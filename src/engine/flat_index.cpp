@@ -0,0 +1,184 @@
+#include "flat_index.hpp"
+#include "vector_kernels.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <thread>
+#include <unordered_set>
+
+namespace kestr::engine {
+
+    namespace {
+
+        constexpr uint64_t kFlatMagic = 0x3154414C46464B31ULL; // "1KFFLAT1"
+        constexpr size_t kAlignment = 64;
+
+        // Rows scanned per thread before another thread pays for its start-up
+        constexpr size_t kRowsPerThread = 16384;
+
+        template<typename T>
+        void write_pod(std::ostream& out, const T& value) {
+            out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+        template<typename T>
+        bool read_pod(std::istream& in, T& value) {
+            return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+        }
+
+        // Max-heap on distance: the top is the worst of the k kept
+        bool closer(const std::pair<float, size_t>& a, const std::pair<float, size_t>& b) {
+            return a.first < b.first;
+        }
+
+    }
+
+    void FlatIndex::AlignedDelete::operator()(float* p) const {
+        ::operator delete[](p, std::align_val_t(kAlignment));
+    }
+
+    FlatIndex::FlatIndex(size_t dim, Metric metric, size_t threads)
+        : m_dim(dim), m_stride((dim + 15) / 16 * 16), m_metric(metric),
+          m_threads(threads ? threads : std::max(1u, std::thread::hardware_concurrency())) {}
+
+    void FlatIndex::reserve(size_t rows) {
+        if (rows <= m_capacity) return;
+        size_t capacity = std::max<size_t>({rows, m_capacity * 2, 1024});
+        size_t floats = capacity * m_stride;
+        Arena arena(static_cast<float*>(::operator new[](floats * sizeof(float), std::align_val_t(kAlignment))));
+        if (m_arena) std::memcpy(arena.get(), m_arena.get(), m_ids.size() * m_stride * sizeof(float));
+        m_arena = std::move(arena);
+        m_capacity = capacity;
+    }
+
+    void FlatIndex::add(size_t id, const float* vector) {
+        size_t row;
+        if (id < m_rows.size() && m_rows[id] != 0) {
+            row = m_rows[id] - 1; // Update in place
+        } else {
+            reserve(m_ids.size() + 1);
+            row = m_ids.size();
+            m_ids.push_back(id);
+            if (id >= m_rows.size()) m_rows.resize(std::max(id + 1, m_rows.size() * 3 / 2), 0);
+            m_rows[id] = static_cast<uint32_t>(row + 1);
+        }
+        float* dst = m_arena.get() + row * m_stride;
+        std::memcpy(dst, vector, m_dim * sizeof(float));
+        std::fill(dst + m_dim, dst + m_stride, 0.0f);
+    }
+
+    void FlatIndex::remove(size_t id) {
+        if (id >= m_rows.size() || m_rows[id] == 0) return;
+        size_t row = m_rows[id] - 1;
+        size_t last = m_ids.size() - 1;
+        if (row != last) {
+            // Move the last row into the hole; rows stay contiguous for the scan
+            std::memcpy(m_arena.get() + row * m_stride, m_arena.get() + last * m_stride, m_stride * sizeof(float));
+            m_ids[row] = m_ids[last];
+            m_rows[m_ids[row]] = static_cast<uint32_t>(row + 1);
+        }
+        m_ids.pop_back();
+        m_rows[id] = 0;
+    }
+
+    void FlatIndex::scan(const float* query, size_t begin, size_t end, size_t k, const std::function<bool(size_t)>& allowed,
+                         std::vector<std::pair<float, size_t>>& heap) const {
+        heap.reserve(k);
+        bool ip = (m_metric == Metric::Cosine);
+        const float* row = m_arena.get() + begin * m_stride;
+        for (size_t r = begin; r < end; ++r, row += m_stride) {
+            if (allowed && !allowed(m_ids[r])) continue;
+            // The zero padding does not change either result; the full stride keeps the loads aligned
+            float distance = ip ? 1.0f - kernels::dot(query, row, m_stride) : kernels::l2_squared(query, row, m_stride);
+            if (heap.size() < k) {
+                heap.emplace_back(distance, m_ids[r]);
+                std::push_heap(heap.begin(), heap.end(), closer);
+            } else if (distance < heap.front().first) {
+                std::pop_heap(heap.begin(), heap.end(), closer);
+                heap.back() = {distance, m_ids[r]};
+                std::push_heap(heap.begin(), heap.end(), closer);
+            }
+        }
+    }
+
+    std::vector<std::pair<float, size_t>> FlatIndex::search(const float* input, size_t k, const std::function<bool(size_t)>& allowed) const {
+        std::vector<std::pair<float, size_t>> results;
+        size_t rows = m_ids.size();
+        if (k == 0 || rows == 0) return results;
+
+        // Padded copy of the query so the kernels can run over whole aligned rows
+        std::vector<float> query(m_stride, 0.0f);
+        std::memcpy(query.data(), input, m_dim * sizeof(float));
+
+        size_t threads = std::min(m_threads, rows / kRowsPerThread);
+        if (threads <= 1) {
+            scan(query.data(), 0, rows, k, allowed, results);
+        } else {
+            std::vector<std::vector<std::pair<float, size_t>>> partial(threads);
+            std::vector<std::thread> workers;
+            size_t per = (rows + threads - 1) / threads;
+            for (size_t t = 1; t < threads; ++t) {
+                workers.emplace_back([&, t] { scan(query.data(), t * per, std::min(rows, (t + 1) * per), k, allowed, partial[t]); });
+            }
+            scan(query.data(), 0, std::min(rows, per), k, allowed, partial[0]);
+            for (auto& w : workers) w.join();
+            for (auto& p : partial) results.insert(results.end(), p.begin(), p.end());
+        }
+
+        std::sort(results.begin(), results.end(), closer);
+        if (results.size() > k) results.resize(k);
+        return results;
+    }
+
+    bool FlatIndex::save(const std::filesystem::path& path) const {
+        std::ofstream out(path, std::ios::binary);
+        if (!out.is_open()) return false;
+        write_pod(out, kFlatMagic);
+        write_pod(out, static_cast<uint64_t>(m_dim));
+        write_pod(out, static_cast<uint64_t>(m_metric == Metric::Cosine));
+        write_pod(out, static_cast<uint64_t>(m_ids.size()));
+        out.write(reinterpret_cast<const char*>(m_ids.data()), m_ids.size() * sizeof(size_t));
+        for (size_t r = 0; r < m_ids.size(); ++r) {
+            out.write(reinterpret_cast<const char*>(vector_at(r)), m_dim * sizeof(float));
+        }
+        return static_cast<bool>(out);
+    }
+
+    bool FlatIndex::load(const std::filesystem::path& path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open()) return false;
+
+        uint64_t magic = 0, dim = 0, cosine = 0, count = 0;
+        if (!read_pod(in, magic) || !read_pod(in, dim) || !read_pod(in, cosine) || !read_pod(in, count)) return false;
+        if (magic != kFlatMagic || dim != m_dim || (cosine != 0) != (m_metric == Metric::Cosine)) return false;
+
+        // The count sizes the allocations below; a truncated or garbage file must not get that far
+        std::error_code ec;
+        uint64_t size = std::filesystem::file_size(path, ec);
+        uint64_t header = static_cast<uint64_t>(in.tellg());
+        if (ec || header > size || count > (size - header) / (sizeof(size_t) + m_dim * sizeof(float))) return false;
+
+        // Build into a fresh index so a bad file leaves this one untouched
+        FlatIndex loaded(m_dim, m_metric, m_threads);
+        std::vector<size_t> ids(count);
+        if (!in.read(reinterpret_cast<char*>(ids.data()), count * sizeof(size_t))) return false;
+        std::vector<float> vector(m_dim);
+        loaded.reserve(count);
+        for (size_t id : ids) {
+            if (!in.read(reinterpret_cast<char*>(vector.data()), m_dim * sizeof(float))) return false;
+            loaded.add(id, vector.data());
+        }
+        *this = std::move(loaded);
+        return true;
+    }
+
+    double recall_at_k(const std::vector<size_t>& approximate, const std::vector<size_t>& exact) {
+        if (exact.empty()) return 1.0;
+        std::unordered_set<size_t> truth(exact.begin(), exact.end());
+        size_t found = 0;
+        for (size_t id : approximate) found += truth.count(id);
+        return static_cast<double>(found) / exact.size();
+    }
+
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <memory>
+#include <filesystem>
+#include <functional>
+#include "kestr/types.hpp"
+
+namespace kestr::engine {
+
+    /**
+     * @brief Exact k-nearest-neighbour search by scanning every stored vector.
+     * Vectors live in one contiguous arena with rows padded to 64-byte cache lines and are
+     * compared with the SIMD kernels of vector_kernels.hpp. Large scans are split across
+     * threads, each keeping a fixed-size top-k heap. There is nothing to build, so it
+     * serves small indexes better than a graph, and its results are the ground truth for
+     * measuring the recall of the approximate backends.
+     * Not thread-safe for writes; the Librarian serializes access.
+     */
+    class FlatIndex {
+    public:
+        /**
+         * @param metric Cosine ranks by inner product (callers store normalized vectors), L2 by squared distance.
+         * @param threads Upper bound on scan threads per query (0 = one per core).
+         */
+        FlatIndex(size_t dim, Metric metric, size_t threads = 0);
+
+        void add(size_t id, const float* vector);
+        void add(size_t id, const std::vector<float>& vector) { add(id, vector.data()); }
+        void remove(size_t id);
+
+        /**
+         * @param allowed If set, only ids it accepts are returned.
+         * @return Up to k (distance, id) pairs, closest first. The distance is 1 - dot for
+         * Cosine (like hnswlib's InnerProductSpace) and squared L2 otherwise.
+         */
+        std::vector<std::pair<float, size_t>> search(const float* query, size_t k,
+                                                     const std::function<bool(size_t)>& allowed = nullptr) const;
+
+        size_t size() const { return m_ids.size(); }
+        size_t dimension() const { return m_dim; }
+        const float* vector_at(size_t row) const { return m_arena.get() + row * m_stride; }
+        size_t id_at(size_t row) const { return m_ids[row]; }
+
+        /**
+         * @brief Stored vector of an id, or nullptr if absent.
+         */
+        const float* find(size_t id) const {
+            return id < m_rows.size() && m_rows[id] != 0 ? vector_at(m_rows[id] - 1) : nullptr;
+        }
+
+        bool save(const std::filesystem::path& path) const;
+        bool load(const std::filesystem::path& path);
+
+    private:
+        struct AlignedDelete {
+            void operator()(float* p) const;
+        };
+        using Arena = std::unique_ptr<float[], AlignedDelete>;
+
+        void reserve(size_t rows);
+        void scan(const float* query, size_t begin, size_t end, size_t k, const std::function<bool(size_t)>& allowed,
+                  std::vector<std::pair<float, size_t>>& heap) const;
+
+        size_t m_dim;
+        size_t m_stride;  // Floats per row, a multiple of 16
+        Metric m_metric;
+        size_t m_threads;
+
+        Arena m_arena;
+        size_t m_capacity = 0;
+        std::vector<size_t> m_ids;         // Row -> id
+        std::vector<uint32_t> m_rows;      // Id -> row + 1 (0 = absent); ids are dense SQLite rowids
+    };
+
+    /**
+     * @brief Fraction of the exact top-k that an approximate result set found.
+     */
+    double recall_at_k(const std::vector<size_t>& approximate, const std::vector<size_t>& exact);
+
+}
@@ -0,0 +1,110 @@
+#include "http_client.hpp"
+
+namespace kestr::engine {
+
+    namespace {
+
+        size_t write_callback(void* contents, size_t size, size_t nmemb, void* userp) {
+            static_cast<std::string*>(userp)->append(static_cast<char*>(contents), size * nmemb);
+            return size * nmemb;
+        }
+
+    }
+
+    HttpClient::HttpClient(long timeout_seconds) : m_timeout(timeout_seconds) {
+        m_share = curl_share_init();
+        if (m_share) {
+            curl_share_setopt(m_share, CURLSHOPT_LOCKFUNC, &HttpClient::lock);
+            curl_share_setopt(m_share, CURLSHOPT_UNLOCKFUNC, &HttpClient::unlock);
+            curl_share_setopt(m_share, CURLSHOPT_USERDATA, this);
+            curl_share_setopt(m_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+            curl_share_setopt(m_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+            // Not CURL_LOCK_DATA_CONNECT: libcurl does not support sharing connections between
+            // concurrent threads; each pooled handle keeps its own connection alive instead.
+        }
+    }
+
+    HttpClient::~HttpClient() {
+        // Handles go before the share handle they point to
+        for (CURL* handle : m_idle) curl_easy_cleanup(handle);
+        if (m_share) curl_share_cleanup(m_share);
+    }
+
+    void HttpClient::lock(CURL*, curl_lock_data data, curl_lock_access, void* user) {
+        static_cast<HttpClient*>(user)->m_share_locks[data].lock();
+    }
+
+    void HttpClient::unlock(CURL*, curl_lock_data data, void* user) {
+        static_cast<HttpClient*>(user)->m_share_locks[data].unlock();
+    }
+
+    CURL* HttpClient::acquire() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_idle.empty()) {
+                CURL* handle = m_idle.back();
+                m_idle.pop_back();
+                return handle;
+            }
+        }
+
+        CURL* handle = curl_easy_init();
+        if (!handle) return nullptr;
+        if (m_share) curl_easy_setopt(handle, CURLOPT_SHARE, m_share);
+        curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L); // Timeouts must not raise signals in worker threads
+        curl_easy_setopt(handle, CURLOPT_TCP_KEEPALIVE, 1L);
+        curl_easy_setopt(handle, CURLOPT_HTTP_VERSION, static_cast<long>(CURL_HTTP_VERSION_2TLS));
+        curl_easy_setopt(handle, CURLOPT_ACCEPT_ENCODING, ""); // Embedding JSON compresses well
+        curl_easy_setopt(handle, CURLOPT_CONNECTTIMEOUT, 10L);
+        curl_easy_setopt(handle, CURLOPT_TIMEOUT, m_timeout);
+        curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, write_callback);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_created;
+        return handle;
+    }
+
+    void HttpClient::release(CURL* handle) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_idle.push_back(handle);
+    }
+
+    size_t HttpClient::handles() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_created;
+    }
+
+    HttpResponse HttpClient::post(const std::string& url, const std::string& body, const std::vector<std::string>& headers) {
+        HttpResponse response;
+        CURL* handle = acquire();
+        if (!handle) {
+            response.error = "curl_easy_init() failed";
+            return response;
+        }
+
+        struct curl_slist* header_list = curl_slist_append(nullptr, "Content-Type: application/json");
+        for (const auto& header : headers) header_list = curl_slist_append(header_list, header.c_str());
+
+        curl_easy_setopt(handle, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(handle, CURLOPT_POSTFIELDS, body.data());
+        curl_easy_setopt(handle, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(body.size()));
+        curl_easy_setopt(handle, CURLOPT_HTTPHEADER, header_list);
+        curl_easy_setopt(handle, CURLOPT_WRITEDATA, &response.body);
+
+        CURLcode res = curl_easy_perform(handle);
+        if (res == CURLE_OK) {
+            response.ok = true;
+            curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &response.status);
+        } else {
+            response.error = curl_easy_strerror(res);
+        }
+
+        // Drop pointers into this call's locals before the handle goes back to the pool
+        curl_easy_setopt(handle, CURLOPT_HTTPHEADER, nullptr);
+        curl_easy_setopt(handle, CURLOPT_WRITEDATA, nullptr);
+        curl_slist_free_all(header_list);
+        release(handle);
+        return response;
+    }
+
+}
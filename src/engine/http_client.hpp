@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <curl/curl.h>
+
+namespace kestr::engine {
+
+    struct HttpResponse {
+        bool ok = false;     // The transfer completed (any HTTP status)
+        long status = 0;
+        std::string body;
+        std::string error;   // Transport error if !ok
+    };
+
+    /**
+     * @brief Small libcurl client for the remote embedders that keeps connections alive.
+     * Easy handles are pooled and reused, so each keeps its connection (and TLS session)
+     * open between requests instead of paying a handshake per call. All handles share the DNS
+     * cache and TLS sessions through one share handle, so a new handle resumes a session
+     * instead of a full handshake; connections themselves are not shared between handles.
+     * HTTPS negotiates HTTP/2 when the server offers it.
+     * Requires curl_global_init(). Thread-safe.
+     */
+    class HttpClient {
+    public:
+        /**
+         * @param timeout_seconds Limit for a whole request, connect included.
+         */
+        explicit HttpClient(long timeout_seconds = 120);
+        ~HttpClient();
+
+        HttpClient(const HttpClient&) = delete;
+        HttpClient& operator=(const HttpClient&) = delete;
+
+        HttpResponse post(const std::string& url, const std::string& body, const std::vector<std::string>& headers = {});
+
+        /**
+         * @brief Easy handles created so far, i.e. the peak number of concurrent requests.
+         */
+        size_t handles() const;
+
+    private:
+        CURL* acquire();
+        void release(CURL* handle);
+
+        static void lock(CURL*, curl_lock_data data, curl_lock_access, void* user);
+        static void unlock(CURL*, curl_lock_data data, void* user);
+
+        long m_timeout;
+        CURLSH* m_share = nullptr;
+        std::mutex m_share_locks[CURL_LOCK_DATA_LAST];
+
+        mutable std::mutex m_mutex; // Guards the pool
+        std::vector<CURL*> m_idle;
+        size_t m_created = 0;
+    };
+
+}
@@ -0,0 +1,98 @@
+#include "index_snapshot.hpp"
+#include <iostream>
+#include <cstdlib>
+#include <string>
+
+namespace kestr::engine {
+
+    namespace {
+
+        // Normalized and raw vectors do not mix; the metric is part of the snapshot's identity
+        std::string metric_tag(const Librarian& librarian) {
+            return librarian.metric() == Metric::Cosine ? "cosine" : "l2";
+        }
+
+    }
+
+    IndexSnapshot::IndexSnapshot(std::filesystem::path path, std::string key) : m_path(std::move(path)), m_key(std::move(key)) {}
+
+    bool IndexSnapshot::restore(Librarian& librarian, Database& db, const std::function<bool(int64_t)>& owns) {
+        std::error_code ec;
+        if (!std::filesystem::exists(m_path, ec)) return false;
+
+        int64_t generation = std::strtoll(db.get_meta(meta_key("generation"), "0").c_str(), nullptr, 10);
+        size_t dim = std::strtoull(db.get_meta(meta_key("dim"), "0").c_str(), nullptr, 10);
+        std::string encoding = db.get_meta(meta_key("encoding"), "fp32");
+        std::string metric = db.get_meta(meta_key("metric"), "l2");
+        if (generation <= 0 || dim != librarian.dimension() || encoding != librarian.encoding() || metric != metric_tag(librarian)) {
+            std::cout << "[Snapshot] Ignoring " << m_path << " (no matching database tag)." << std::endl;
+            return false;
+        }
+        if (!librarian.load(m_path)) return false;
+
+        // Changes of the tagged generation may have committed just before the graph was
+        // saved, so replay from that generation inclusive; add_item updates ids already in
+        // the graph in place and remove_item ignores missing ones, so replaying twice is harmless.
+        auto deleted = db.get_tombstones_since(generation);
+        for (int64_t id : deleted) librarian.remove_item(id);
+
+        size_t upserts = 0;
+        db.for_each_vector_since(generation, [&](int64_t id, const std::vector<float>& vec) {
+            if (owns && !owns(id)) return;
+            librarian.add_item(id, vec);
+            ++upserts;
+        });
+
+        m_saved_generation = generation;
+        m_saved_changes = ~0ULL; // The replayed changes are not in the file yet
+        std::cout << "[Snapshot] Restored " << librarian.count() << " items from generation " << generation
+                  << " (replayed " << upserts << " updates, " << deleted.size() << " deletes)." << std::endl;
+        return true;
+    }
+
+    bool IndexSnapshot::checkpoint(Librarian& librarian, Database& db, std::mutex& db_mutex, bool prune) {
+        int64_t generation;
+        {
+            std::lock_guard<std::mutex> lock(db_mutex);
+            if (m_saved_generation != 0 && (!db.has_changes_since(m_saved_generation + 1) || librarian.changes() == m_saved_changes)) return true;
+            // Writes from here on land in a newer generation and will be replayed on restore
+            generation = db.advance_generation();
+        }
+        uint64_t changes = librarian.changes();
+
+        // Write next to the target and rename, so a crash never leaves a torn snapshot
+        std::filesystem::path tmp = m_path;
+        tmp += ".tmp";
+        std::string encoding;
+        if (!librarian.save(tmp, &encoding)) return false;
+
+        std::error_code ec;
+        std::filesystem::rename(tmp, m_path, ec);
+        if (ec) {
+            std::cerr << "[Snapshot] Failed to replace " << m_path << ": " << ec.message() << "\n";
+            std::filesystem::remove(tmp, ec);
+            return false;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(db_mutex);
+            db.set_meta(meta_key("generation"), std::to_string(generation));
+            db.set_meta(meta_key("dim"), std::to_string(librarian.dimension()));
+            db.set_meta(meta_key("encoding"), encoding);
+            db.set_meta(meta_key("metric"), metric_tag(librarian));
+            if (prune) db.prune_tombstones(generation);
+        }
+        m_saved_generation = generation;
+        m_saved_changes = changes;
+        std::cout << "[Snapshot] Saved " << librarian.count() << " items at generation " << generation << "." << std::endl;
+        return true;
+    }
+
+    void IndexSnapshot::discard(Database& db) {
+        std::error_code ec;
+        std::filesystem::remove(m_path, ec);
+        db.set_meta(meta_key("generation"), "0");
+        m_saved_generation = 0;
+    }
+
+}
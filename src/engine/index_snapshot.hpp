@@ -0,0 +1,63 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <cstdint>
+#include <functional>
+#include <filesystem>
+#include "librarian.hpp"
+#include "database.hpp"
+
+namespace kestr::engine {
+
+    /**
+     * @brief On-disk checkpoint of the Librarian's HNSW graph.
+     * A snapshot is tagged with the database generation that was current when it was
+     * taken. At startup the graph is loaded from disk and only chunks written or deleted
+     * in that generation or later are replayed, instead of rebuilding from every vector.
+     */
+    class IndexSnapshot {
+    public:
+        /**
+         * @param key Prefix of the snapshot's tags in the database meta table; one per snapshot file.
+         */
+        explicit IndexSnapshot(std::filesystem::path path, std::string key = "snapshot");
+
+        /**
+         * @brief Loads the snapshot into the librarian and replays newer changes.
+         * The caller must hold the database lock.
+         * @param owns If set, only changed vectors it accepts are replayed (sharded librarians).
+         * @return false if there is no usable snapshot; the librarian should be rebuilt.
+         */
+        bool restore(Librarian& librarian, Database& db, const std::function<bool(int64_t)>& owns = nullptr);
+
+        /**
+         * @brief Writes a new snapshot if the database and the librarian changed since the last one.
+         * The caller must keep other threads from modifying the librarian meanwhile.
+         * @param prune Drop tombstones this snapshot no longer needs. Pass false when several
+         *        snapshots share the database and prune up to the oldest one instead.
+         */
+        bool checkpoint(Librarian& librarian, Database& db, std::mutex& db_mutex, bool prune = true);
+
+        /**
+         * @brief Deletes the snapshot file and its database tag.
+         */
+        void discard(Database& db);
+
+        const std::filesystem::path& path() const { return m_path; }
+
+        /**
+         * @brief Generation of the snapshot the librarian matches (0 = none).
+         */
+        int64_t saved_generation() const { return m_saved_generation; }
+
+    private:
+        std::string meta_key(const char* field) const { return m_key + "_" + field; }
+
+        std::filesystem::path m_path;
+        std::string m_key;
+        int64_t m_saved_generation = 0; // 0 = the librarian does not match any snapshot yet
+        uint64_t m_saved_changes = 0;   // Librarian::changes() when the snapshot was taken
+    };
+
+}
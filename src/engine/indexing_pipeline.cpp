@@ -0,0 +1,227 @@
+#include "indexing_pipeline.hpp"
+#include "text_chunker.hpp"
+#include "treesitter_parser.hpp"
+#include "kestr/sha256.h"
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+namespace kestr::engine {
+
+    namespace {
+
+        // Helper to determine if a file should use tree-sitter
+        bool should_use_treesitter(const std::filesystem::path& path) {
+            std::string ext = path.extension().string();
+            return ext == ".py" || ext == ".cpp" || ext == ".hpp" || ext == ".h" || ext == ".cc" ||
+                   ext == ".go" || ext == ".rs" || ext == ".js" || ext == ".ts" ||
+                   ext == ".java" || ext == ".cs" || ext == ".php" || ext == ".rb";
+        }
+
+        // Helper to map extension to language string
+        std::string extension_to_language(const std::filesystem::path& path) {
+            std::string ext = path.extension().string();
+            if (ext == ".cpp" || ext == ".hpp" || ext == ".h" || ext == ".cc") return "cpp";
+            if (ext == ".py") return "python";
+            if (ext == ".js" || ext == ".jsx") return "javascript";
+            if (ext == ".ts" || ext == ".tsx") return "typescript";
+            if (ext == ".go") return "go";
+            if (ext == ".rs") return "rust";
+            if (ext == ".java") return "java";
+            if (ext == ".cs") return "c_sharp";
+            if (ext == ".php") return "php";
+            if (ext == ".rb") return "ruby";
+            if (ext == ".md") return "markdown";
+            if (ext == ".json") return "json";
+            if (ext == ".txt") return "text";
+            if (!ext.empty() && ext[0] == '.') return ext.substr(1);
+            return "unknown";
+        }
+
+    }
+
+    IndexingPipeline::IndexingPipeline(JobQueue& input, Database& db, std::mutex& db_mutex, DatabaseWriter& writer,
+                                       Embedder* embedder, PipelineOptions options)
+        : m_input(input), m_db(db), m_db_mutex(db_mutex), m_writer(writer), m_embedder(embedder), m_options(options),
+          m_parse_queue(options.queue_capacity),
+          m_embed_queue(options.queue_capacity) {
+    }
+
+    IndexingPipeline::~IndexingPipeline() {
+        stop();
+    }
+
+    bool IndexingPipeline::is_indexable(const std::filesystem::path& path) {
+        std::string ext = path.extension().string();
+        return ext == ".cpp" || ext == ".hpp" || ext == ".h" || ext == ".md" || ext == ".txt" || ext == ".json" ||
+               ext == ".py" || ext == ".js" || ext == ".ts" || ext == ".go" || ext == ".rs" || ext == ".java" ||
+               ext == ".cs" || ext == ".php" || ext == ".rb";
+    }
+
+    void IndexingPipeline::start() {
+        if (m_running.exchange(true)) return;
+
+        auto spawn = [this](size_t count, void (IndexingPipeline::*loop)()) {
+            for (size_t i = 0; i < std::max<size_t>(1, count); ++i) {
+                m_threads.emplace_back(loop, this);
+            }
+        };
+        spawn(m_options.read_threads, &IndexingPipeline::read_loop);
+        spawn(m_options.parse_threads, &IndexingPipeline::parse_loop);
+        spawn(m_options.embed_threads, &IndexingPipeline::embed_loop);
+    }
+
+    void IndexingPipeline::stop() {
+        if (!m_running.exchange(false)) return;
+
+        m_input.stop();
+        m_parse_queue.stop();
+        m_embed_queue.stop();
+        for (auto& t : m_threads) {
+            if (t.joinable()) t.join();
+        }
+        m_threads.clear();
+    }
+
+    PipelineStats IndexingPipeline::stats() const {
+        PipelineStats s;
+        s.read_queue = m_input.size();
+        s.parse_queue = m_parse_queue.size();
+        s.embed_queue = m_embed_queue.size();
+        s.write_queue = m_writer.pending();
+        s.files_indexed = m_writer.files_written();
+        s.chunks_embedded = m_chunks_embedded.load();
+        s.chunks_reused = m_chunks_reused.load();
+        return s;
+    }
+
+    void IndexingPipeline::read_loop() {
+        while (m_running) {
+            FileInfo info;
+            if (!m_input.pop(info)) break;
+            if (!is_indexable(info.path)) continue;
+
+            ParseJob job;
+            try {
+                std::ifstream file(info.path, std::ios::binary);
+                if (!file.is_open()) continue;
+                auto size = std::filesystem::file_size(info.path);
+                job.content.resize(size);
+                file.read(&job.content[0], size);
+                job.content.resize(file.gcount());
+            } catch (...) {
+                continue;
+            }
+
+            // Hash the buffer we already read instead of reading the file twice
+            kestr::crypto::SHA256 sha;
+            sha.update(job.content.data(), job.content.size());
+            info.hash = sha.final();
+
+            job.info = std::move(info);
+            if (!m_parse_queue.push(std::move(job))) break;
+        }
+    }
+
+    void IndexingPipeline::parse_loop() {
+        TreeSitterParser ts_parser;
+
+        while (m_running) {
+            ParseJob job;
+            if (!m_parse_queue.pop(job)) break;
+
+            EmbedJob out;
+            std::string lang = extension_to_language(job.info.path);
+            if (should_use_treesitter(job.info.path)) {
+                out.chunks = ts_parser.parse(job.content, lang);
+                out.calls = ts_parser.extract_calls(job.content, lang);
+            }
+            if (out.chunks.empty()) {
+                out.chunks = TextChunker::chunk(job.content, 4000, 0.15f);
+            }
+
+            for (auto& c : out.chunks) {
+                c.language = lang;
+                c.project_root = job.info.project_root;
+
+                kestr::crypto::SHA256 sha;
+                sha.update(c.content.data(), c.content.size());
+                c.content_hash = sha.final();
+            }
+
+            out.info = std::move(job.info);
+            if (!m_embed_queue.push(std::move(out))) break;
+        }
+    }
+
+    void IndexingPipeline::embed_loop() {
+        while (m_running) {
+            // Coalesce queued files until we have a decent batch of chunks
+            std::vector<EmbedJob> jobs(1);
+            if (!m_embed_queue.pop(jobs[0])) break;
+
+            size_t total = jobs[0].chunks.size();
+            while (total < m_options.embed_batch_size) {
+                EmbedJob next;
+                if (!m_embed_queue.try_pop(next)) break;
+                total += next.chunks.size();
+                jobs.push_back(std::move(next));
+            }
+
+            // Chunks whose content is already embedded for this file keep their stored vector
+            std::vector<std::pair<size_t, size_t>> todo; // (job, chunk) pairs that need a new embedding
+            todo.reserve(total);
+            std::vector<std::vector<bool>> skipped(jobs.size());
+            size_t reused = 0;
+            if (m_embedder) {
+                for (size_t j = 0; j < jobs.size(); ++j) {
+                    skipped[j].assign(jobs[j].chunks.size(), false);
+                    std::unordered_map<std::string, size_t> known;
+                    {
+                        std::lock_guard<std::mutex> lock(m_db_mutex);
+                        known = m_db.get_embedded_chunk_hashes(jobs[j].info.path);
+                    }
+                    // Each stored vector covers one copy of its content; further copies are embedded
+                    for (size_t i = 0; i < jobs[j].chunks.size(); ++i) {
+                        auto it = known.find(jobs[j].chunks[i].content_hash);
+                        if (it != known.end() && it->second > 0) {
+                            --it->second;
+                            skipped[j][i] = true;
+                            ++reused;
+                            continue;
+                        }
+                        todo.emplace_back(j, i);
+                    }
+                }
+            }
+            // Without an embedder nothing is reused, the chunks are just stored without vectors
+            m_chunks_reused += reused;
+            m_chunks_embedded += todo.size();
+
+            std::vector<std::string> texts;
+            texts.reserve(todo.size());
+            for (const auto& [j, i] : todo) texts.push_back(jobs[j].chunks[i].content);
+
+            std::vector<std::vector<float>> embeddings;
+            if (m_embedder && !texts.empty()) embeddings = m_embedder->embed_batch(texts);
+            embeddings.resize(todo.size());
+
+            std::vector<WriteBatch> outs(jobs.size());
+            for (size_t j = 0; j < jobs.size(); ++j) {
+                outs[j].embeddings.resize(jobs[j].chunks.size());
+            }
+            for (size_t k = 0; k < todo.size(); ++k) {
+                outs[todo[k].first].embeddings[todo[k].second] = std::move(embeddings[k]);
+            }
+
+            for (size_t j = 0; j < jobs.size(); ++j) {
+                outs[j].info = std::move(jobs[j].info);
+                outs[j].calls = std::move(jobs[j].calls);
+                outs[j].chunks = std::move(jobs[j].chunks);
+                outs[j].reused = std::move(skipped[j]);
+                m_writer.submit(std::move(outs[j]));
+            }
+        }
+    }
+
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include "kestr/types.hpp"
+#include "job_queue.hpp"
+#include "database_writer.hpp"
+#include "embedder.hpp"
+
+namespace kestr::engine {
+
+    struct PipelineOptions {
+        size_t read_threads = 2;
+        size_t parse_threads = 2;
+        size_t embed_threads = 2;
+        size_t queue_capacity = 256;  // Max items buffered between two stages
+        size_t embed_batch_size = 64; // Chunks coalesced into one embed_batch() call
+    };
+
+    /**
+     * @brief Snapshot of pipeline progress, one queue depth per stage input.
+     */
+    struct PipelineStats {
+        size_t read_queue = 0;
+        size_t parse_queue = 0;
+        size_t embed_queue = 0;
+        size_t write_queue = 0;
+        size_t files_indexed = 0;
+        size_t chunks_embedded = 0;
+        size_t chunks_reused = 0;   // Skipped by the embedder because their content hash was already stored
+    };
+
+    /**
+     * @brief Staged indexing pipeline fed by the JobQueue.
+     * Stages: read+hash -> parse+chunk -> embed (batched) -> DatabaseWriter.
+     * Chunks are hashed at parse time; only chunks whose hash has no stored
+     * embedding for the file (or more copies than stored embeddings) are sent to the embedder.
+     * Each stage runs on its own threads and hands work on through a bounded queue;
+     * the writer group-commits and is owned by the caller.
+     */
+    class IndexingPipeline {
+    public:
+        IndexingPipeline(JobQueue& input, Database& db, std::mutex& db_mutex, DatabaseWriter& writer,
+                         Embedder* embedder, PipelineOptions options = {});
+        ~IndexingPipeline();
+
+        void start();
+        void stop();
+
+        PipelineStats stats() const;
+
+        /**
+         * @brief Returns true if the file extension is one the pipeline indexes.
+         */
+        static bool is_indexable(const std::filesystem::path& path);
+
+    private:
+        struct ParseJob {
+            FileInfo info;
+            std::string content;
+        };
+
+        struct EmbedJob {
+            FileInfo info;
+            std::vector<Chunk> chunks;
+            std::vector<std::pair<uint32_t, std::string>> calls;
+        };
+
+        void read_loop();
+        void parse_loop();
+        void embed_loop();
+
+        JobQueue& m_input;
+        Database& m_db;
+        std::mutex& m_db_mutex;
+        DatabaseWriter& m_writer;
+        Embedder* m_embedder;
+        PipelineOptions m_options;
+
+        BoundedQueue<ParseJob> m_parse_queue;
+        BoundedQueue<EmbedJob> m_embed_queue;
+
+        std::vector<std::thread> m_threads;
+        std::atomic<bool> m_running{false};
+        std::atomic<size_t> m_chunks_embedded{0};
+        std::atomic<size_t> m_chunks_reused{0};
+    };
+
+}
@@ -0,0 +1,538 @@
+#include "ivfpq_index.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <queue>
+#include <unordered_map>
+#include <random>
+#include <thread>
+#include <cstring>
+#include <limits>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define KESTR_IVFPQ_AVX2 1
+#endif
+
+namespace kestr::engine {
+
+    namespace {
+
+        constexpr uint64_t kCodebookMagic = 0x3151505646564B31ULL; // "1KVFVPQ1"
+        constexpr uint64_t kIndexMagic = 0x3258444956464B31ULL;    // "1KFVIDX2"
+        constexpr uint64_t kNoLocation = ~0ULL;
+        constexpr uint32_t kPendingList = 0xFFFFFFFEu;
+
+        float l2_squared(const float* a, const float* b, size_t d) {
+            float sum = 0.0f;
+            for (size_t i = 0; i < d; ++i) {
+                float t = a[i] - b[i];
+                sum += t * t;
+            }
+            return sum;
+        }
+
+        size_t nearest(const float* x, const float* centroids, size_t k, size_t d) {
+            size_t best = 0;
+            float best_dist = std::numeric_limits<float>::max();
+            for (size_t c = 0; c < k; ++c) {
+                float dist = l2_squared(x, centroids + c * d, d);
+                if (dist < best_dist) {
+                    best_dist = dist;
+                    best = c;
+                }
+            }
+            return best;
+        }
+
+        template<typename Fn>
+        void parallel_for(size_t n, Fn fn) {
+            size_t threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), n / 1024 + 1);
+            if (threads <= 1) {
+                fn(0, n);
+                return;
+            }
+            std::vector<std::thread> pool;
+            size_t step = (n + threads - 1) / threads;
+            for (size_t begin = 0; begin < n; begin += step) {
+                pool.emplace_back(fn, begin, std::min(n, begin + step));
+            }
+            for (auto& t : pool) t.join();
+        }
+
+        // Lloyd's k-means on n points of dimension d (row-major); returns k x d centroids
+        std::vector<float> kmeans(const float* data, size_t n, size_t d, size_t k, size_t iterations) {
+            std::mt19937 rng(1234);
+            std::vector<size_t> order(n);
+            std::iota(order.begin(), order.end(), 0);
+            std::shuffle(order.begin(), order.end(), rng);
+
+            std::vector<float> centroids(k * d);
+            for (size_t c = 0; c < k; ++c) {
+                std::memcpy(&centroids[c * d], data + order[c % n] * d, d * sizeof(float));
+            }
+
+            std::vector<uint32_t> assign(n);
+            std::vector<double> sums(k * d);
+            std::vector<size_t> counts(k);
+            for (size_t it = 0; it < iterations; ++it) {
+                parallel_for(n, [&](size_t begin, size_t end) {
+                    for (size_t i = begin; i < end; ++i) {
+                        assign[i] = static_cast<uint32_t>(nearest(data + i * d, centroids.data(), k, d));
+                    }
+                });
+
+                std::fill(sums.begin(), sums.end(), 0.0);
+                std::fill(counts.begin(), counts.end(), 0);
+                for (size_t i = 0; i < n; ++i) {
+                    const float* x = data + i * d;
+                    double* s = &sums[assign[i] * d];
+                    for (size_t j = 0; j < d; ++j) s[j] += x[j];
+                    ++counts[assign[i]];
+                }
+                for (size_t c = 0; c < k; ++c) {
+                    if (counts[c] == 0) {
+                        // Re-seed an empty cluster from a random point
+                        std::memcpy(&centroids[c * d], data + (rng() % n) * d, d * sizeof(float));
+                        continue;
+                    }
+                    for (size_t j = 0; j < d; ++j) centroids[c * d + j] = static_cast<float>(sums[c * d + j] / counts[c]);
+                }
+            }
+            return centroids;
+        }
+
+        // Sums the lookup-table entries of 8 interleaved codes
+        void adc_block_scalar(const float* table, const uint8_t* block, size_t m, float* out) {
+            for (size_t v = 0; v < 8; ++v) out[v] = 0.0f;
+            for (size_t j = 0; j < m; ++j) {
+                const float* t = table + j * 256;
+                const uint8_t* codes = block + j * 8;
+                for (size_t v = 0; v < 8; ++v) out[v] += t[codes[v]];
+            }
+        }
+
+#if defined(KESTR_IVFPQ_AVX2)
+        __attribute__((target("avx2")))
+        void adc_block_avx2(const float* table, const uint8_t* block, size_t m, float* out) {
+            __m256 acc = _mm256_setzero_ps();
+            for (size_t j = 0; j < m; ++j) {
+                // One gather fetches the table entries of all 8 vectors for sub-quantizer j
+                __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(block + j * 8)));
+                acc = _mm256_add_ps(acc, _mm256_i32gather_ps(table + j * 256, idx, 4));
+            }
+            _mm256_storeu_ps(out, acc);
+        }
+#endif
+
+        using AdcFn = void (*)(const float*, const uint8_t*, size_t, float*);
+
+        AdcFn pick_adc() {
+#if defined(KESTR_IVFPQ_AVX2)
+            if (__builtin_cpu_supports("avx2")) return adc_block_avx2;
+#endif
+            return adc_block_scalar;
+        }
+
+        template<typename T>
+        void write_pod(std::ostream& out, const T& value) {
+            out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+        template<typename T>
+        bool read_pod(std::istream& in, T& value) {
+            return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+        }
+
+    }
+
+    IvfPqIndex::IvfPqIndex(size_t dim, IvfPqOptions options) : m_dim(dim), m_options(std::move(options)) {
+        // Sub-vectors must tile the vector exactly
+        m_m = std::clamp<size_t>(m_options.m, 1, std::max<size_t>(1, dim));
+        while (m_m > 1 && dim % m_m != 0) --m_m;
+        m_dsub = std::max<size_t>(1, dim / m_m);
+        m_options.train_size = std::max<size_t>(m_options.train_size, kKsub);
+
+        if (!m_options.codebooks.empty() && !import_codebooks(m_options.codebooks)) {
+            std::cerr << "[IvfPq] Stored codebooks do not match this index, retraining.\n";
+        }
+        m_options.codebooks.clear();
+    }
+
+    void IvfPqIndex::add(size_t id, const std::vector<float>& vector) {
+        if (vector.size() != m_dim) return;
+        remove(id);
+
+        if (trained()) {
+            encode_into(id, vector.data());
+            return;
+        }
+
+        set_location(id, (static_cast<uint64_t>(kPendingList) << 32) | m_pending_ids.size());
+        m_pending_ids.push_back(id);
+        m_pending.insert(m_pending.end(), vector.begin(), vector.end());
+        if (m_training) m_training_dirty.insert(id);
+        if (m_defer_training) return;
+
+        if (auto training = take_training()) {
+            train(*training);
+            install(std::move(*training));
+        }
+    }
+
+    std::optional<IvfPqIndex::Training> IvfPqIndex::take_training() {
+        if (trained() || m_training || m_pending_ids.size() < m_options.train_size) return std::nullopt;
+        m_training = true;
+        m_training_dirty.clear();
+        Training training;
+        training.ids = m_pending_ids;
+        training.vectors = m_pending;
+        training.epoch = ++m_training_epoch;
+        return training;
+    }
+
+    void IvfPqIndex::remove(size_t id) {
+        uint64_t loc = location(id);
+        if (loc == kNoLocation) return;
+        uint32_t list = static_cast<uint32_t>(loc >> 32);
+        uint32_t pos = static_cast<uint32_t>(loc);
+        set_location(id, kNoLocation);
+
+        if (list != kPendingList) {
+            erase_at(list, pos);
+            return;
+        }
+
+        size_t last = m_pending_ids.size() - 1;
+        if (pos != last) {
+            m_pending_ids[pos] = m_pending_ids[last];
+            std::memcpy(&m_pending[pos * m_dim], &m_pending[last * m_dim], m_dim * sizeof(float));
+            set_location(m_pending_ids[pos], (static_cast<uint64_t>(kPendingList) << 32) | pos);
+        }
+        m_pending_ids.pop_back();
+        m_pending.resize(m_pending_ids.size() * m_dim);
+    }
+
+    std::vector<std::pair<float, size_t>> IvfPqIndex::search(const std::vector<float>& query, size_t k,
+                                                             const std::function<bool(size_t)>& allowed) const {
+        std::priority_queue<std::pair<float, size_t>> top; // Farthest of the current best k on top
+        auto offer = [&](float dist, size_t id) {
+            if (top.size() == k && dist >= top.top().first) return;
+            if (allowed && !allowed(id)) return; // After the distance check: most candidates never get here
+            if (top.size() == k) top.pop();
+            top.emplace(dist, id);
+        };
+        if (query.size() != m_dim || k == 0) return {};
+
+        for (size_t i = 0; i < m_pending_ids.size(); ++i) {
+            offer(l2_squared(query.data(), &m_pending[i * m_dim], m_dim), m_pending_ids[i]);
+        }
+
+        if (trained()) {
+            static const AdcFn adc = pick_adc();
+            size_t nlist = m_lists.size();
+            std::vector<std::pair<float, uint32_t>> coarse(nlist);
+            for (size_t c = 0; c < nlist; ++c) {
+                coarse[c] = {l2_squared(query.data(), &m_coarse[c * m_dim], m_dim), static_cast<uint32_t>(c)};
+            }
+            size_t nprobe = std::min(std::max<size_t>(1, m_options.nprobe), nlist);
+            std::partial_sort(coarse.begin(), coarse.begin() + nprobe, coarse.end());
+
+            std::vector<float> residual(m_dim);
+            std::vector<float> table(m_m * kKsub);
+            float dists[kBlock];
+            for (size_t p = 0; p < nprobe; ++p) {
+                const auto& list = m_lists[coarse[p].second];
+                if (list.ids.empty()) continue;
+
+                // Distance table from the query residual to every sub-centroid
+                const float* centroid = &m_coarse[coarse[p].second * m_dim];
+                for (size_t i = 0; i < m_dim; ++i) residual[i] = query[i] - centroid[i];
+                for (size_t j = 0; j < m_m; ++j) {
+                    for (size_t c = 0; c < kKsub; ++c) {
+                        table[j * kKsub + c] = l2_squared(&residual[j * m_dsub], &m_pq[(j * kKsub + c) * m_dsub], m_dsub);
+                    }
+                }
+
+                for (size_t b = 0; b * kBlock < list.ids.size(); ++b) {
+                    adc(table.data(), &list.codes[b * m_m * kBlock], m_m, dists);
+                    size_t lanes = std::min(kBlock, list.ids.size() - b * kBlock);
+                    for (size_t v = 0; v < lanes; ++v) offer(dists[v], list.ids[b * kBlock + v]);
+                }
+            }
+        }
+
+        std::vector<std::pair<float, size_t>> results(top.size());
+        for (size_t i = results.size(); i > 0; --i) {
+            results[i - 1] = top.top();
+            top.pop();
+        }
+        return results;
+    }
+
+    void IvfPqIndex::train(Training& training) const {
+        size_t n = training.ids.size();
+        const auto& samples = training.vectors;
+        std::cout << "[IvfPq] Training on " << n << " vectors..." << std::endl;
+        size_t nlist = std::clamp<size_t>(n / 39, 1, std::max<size_t>(1, m_options.nlist));
+        training.coarse = kmeans(samples.data(), n, m_dim, nlist, 10);
+        const auto& coarse = training.coarse;
+
+        // PQ codebooks are shared by all lists and trained on residuals
+        std::vector<float> residuals(n * m_dim);
+        parallel_for(n, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                const float* x = &samples[i * m_dim];
+                const float* c = &coarse[nearest(x, coarse.data(), nlist, m_dim) * m_dim];
+                for (size_t d = 0; d < m_dim; ++d) residuals[i * m_dim + d] = x[d] - c[d];
+            }
+        });
+
+        size_t ksub = std::min(kKsub, n);
+        training.pq.assign(m_m * kKsub * m_dsub, 0.0f);
+        std::vector<float> sub(n * m_dsub);
+        for (size_t j = 0; j < m_m; ++j) {
+            for (size_t i = 0; i < n; ++i) {
+                std::memcpy(&sub[i * m_dsub], &residuals[i * m_dim + j * m_dsub], m_dsub * sizeof(float));
+            }
+            auto centroids = kmeans(sub.data(), n, m_dsub, ksub, 15);
+            float* book = &training.pq[j * kKsub * m_dsub];
+            std::memcpy(book, centroids.data(), centroids.size() * sizeof(float));
+            // Unused entries repeat the first centroid; the encoder prefers the lower index on ties
+            for (size_t c = ksub; c < kKsub; ++c) std::memcpy(book + c * m_dsub, book, m_dsub * sizeof(float));
+        }
+
+        // Encode the training set here as well, so install() only has to copy codes
+        training.lists.resize(n);
+        training.codes.resize(n * m_m);
+        parallel_for(n, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                training.lists[i] = quantize(&samples[i * m_dim], coarse.data(), nlist, training.pq.data(), &training.codes[i * m_m]);
+            }
+        });
+    }
+
+    void IvfPqIndex::install(Training training) {
+        // A load() since take_training() replaced the buffer this was trained on
+        if (training.epoch != m_training_epoch || !m_training || trained()) return;
+        m_training = false;
+
+        m_coarse = std::move(training.coarse);
+        m_pq = std::move(training.pq);
+        m_lists.assign(m_coarse.size() / m_dim, InvertedList{});
+        m_count = 0;
+
+        std::unordered_map<size_t, size_t> trained_at;
+        trained_at.reserve(training.ids.size());
+        for (size_t i = 0; i < training.ids.size(); ++i) trained_at[training.ids[i]] = i;
+
+        auto ids = std::move(m_pending_ids);
+        auto vectors = std::move(m_pending);
+        m_pending_ids.clear();
+        m_pending.clear();
+        for (size_t p = 0; p < ids.size(); ++p) {
+            auto it = trained_at.find(ids[p]);
+            if (it != trained_at.end() && !m_training_dirty.count(ids[p])) {
+                place(ids[p], training.lists[it->second], &training.codes[it->second * m_m]);
+            } else {
+                encode_into(ids[p], &vectors[p * m_dim]);
+            }
+        }
+        m_training_dirty.clear();
+        std::cout << "[IvfPq] Trained " << m_lists.size() << " lists x " << m_m << " byte codes." << std::endl;
+    }
+
+    uint32_t IvfPqIndex::quantize(const float* vector, const float* coarse, size_t nlist, const float* pq, uint8_t* codes) const {
+        uint32_t list_no = static_cast<uint32_t>(nearest(vector, coarse, nlist, m_dim));
+        const float* centroid = coarse + list_no * m_dim;
+        std::vector<float> residual(m_dsub);
+        for (size_t j = 0; j < m_m; ++j) {
+            for (size_t d = 0; d < m_dsub; ++d) residual[d] = vector[j * m_dsub + d] - centroid[j * m_dsub + d];
+            codes[j] = static_cast<uint8_t>(nearest(residual.data(), pq + j * kKsub * m_dsub, kKsub, m_dsub));
+        }
+        return list_no;
+    }
+
+    void IvfPqIndex::encode_into(size_t id, const float* vector) {
+        std::vector<uint8_t> codes(m_m);
+        uint32_t list_no = quantize(vector, m_coarse.data(), m_lists.size(), m_pq.data(), codes.data());
+        place(id, list_no, codes.data());
+    }
+
+    void IvfPqIndex::place(size_t id, uint32_t list_no, const uint8_t* codes) {
+        auto& list = m_lists[list_no];
+        size_t pos = list.ids.size();
+        if (pos % kBlock == 0) list.codes.resize(list.codes.size() + m_m * kBlock, 0);
+        uint8_t* block = &list.codes[(pos / kBlock) * m_m * kBlock];
+        for (size_t j = 0; j < m_m; ++j) block[j * kBlock + pos % kBlock] = codes[j];
+
+        list.ids.push_back(id);
+        set_location(id, (static_cast<uint64_t>(list_no) << 32) | pos);
+        ++m_count;
+    }
+
+    uint8_t IvfPqIndex::code_at(const InvertedList& list, size_t pos, size_t j) const {
+        return list.codes[((pos / kBlock) * m_m + j) * kBlock + pos % kBlock];
+    }
+
+    void IvfPqIndex::erase_at(uint32_t list_no, uint32_t pos) {
+        auto& list = m_lists[list_no];
+        size_t last = list.ids.size() - 1;
+        if (pos != last) {
+            // Move the last entry into the hole
+            for (size_t j = 0; j < m_m; ++j) {
+                list.codes[((pos / kBlock) * m_m + j) * kBlock + pos % kBlock] = code_at(list, last, j);
+            }
+            list.ids[pos] = list.ids[last];
+            set_location(list.ids[pos], (static_cast<uint64_t>(list_no) << 32) | pos);
+        }
+        list.ids.pop_back();
+        list.codes.resize(((list.ids.size() + kBlock - 1) / kBlock) * m_m * kBlock);
+        --m_count;
+    }
+
+    void IvfPqIndex::for_each_id(const std::function<void(size_t)>& fn) const {
+        for (const auto& list : m_lists) {
+            for (size_t id : list.ids) fn(id);
+        }
+        for (size_t id : m_pending_ids) fn(id);
+    }
+
+    void IvfPqIndex::set_location(size_t id, uint64_t loc) {
+        if (id >= m_locations.size()) {
+            if (loc == kNoLocation) return;
+            m_locations.resize(std::max(id + 1, m_locations.size() * 3 / 2), kNoLocation);
+        }
+        m_locations[id] = loc;
+    }
+
+    uint64_t IvfPqIndex::location(size_t id) const {
+        return id < m_locations.size() ? m_locations[id] : kNoLocation;
+    }
+
+    std::vector<uint8_t> IvfPqIndex::export_codebooks() const {
+        std::vector<uint8_t> out;
+        if (!trained()) return out;
+
+        uint64_t header[5] = {kCodebookMagic, m_dim, m_lists.size(), m_m, kKsub};
+        size_t coarse_bytes = m_coarse.size() * sizeof(float);
+        size_t pq_bytes = m_pq.size() * sizeof(float);
+        out.resize(sizeof(header) + coarse_bytes + pq_bytes);
+        std::memcpy(out.data(), header, sizeof(header));
+        std::memcpy(out.data() + sizeof(header), m_coarse.data(), coarse_bytes);
+        std::memcpy(out.data() + sizeof(header) + coarse_bytes, m_pq.data(), pq_bytes);
+        return out;
+    }
+
+    bool IvfPqIndex::import_codebooks(const std::vector<uint8_t>& data) {
+        uint64_t header[5];
+        if (data.size() < sizeof(header)) return false;
+        std::memcpy(header, data.data(), sizeof(header));
+        if (header[0] != kCodebookMagic || header[1] != m_dim || header[3] != m_m || header[4] != kKsub || header[2] == 0) return false;
+
+        size_t nlist = header[2];
+        size_t coarse_floats = nlist * m_dim;
+        size_t pq_floats = m_m * kKsub * m_dsub;
+        if (data.size() != sizeof(header) + (coarse_floats + pq_floats) * sizeof(float)) return false;
+
+        m_coarse.resize(coarse_floats);
+        m_pq.resize(pq_floats);
+        std::memcpy(m_coarse.data(), data.data() + sizeof(header), coarse_floats * sizeof(float));
+        std::memcpy(m_pq.data(), data.data() + sizeof(header) + coarse_floats * sizeof(float), pq_floats * sizeof(float));
+        m_lists.assign(nlist, InvertedList{});
+        m_count = 0;
+        return true;
+    }
+
+    bool IvfPqIndex::save(const std::filesystem::path& path) const {
+        std::ofstream out(path, std::ios::binary);
+        if (!out.is_open()) return false;
+
+        auto codebooks = export_codebooks();
+        write_pod(out, kIndexMagic);
+        write_pod(out, static_cast<uint64_t>(m_dim));
+        write_pod(out, static_cast<uint64_t>(codebooks.size()));
+        out.write(reinterpret_cast<const char*>(codebooks.data()), codebooks.size());
+
+        write_pod(out, static_cast<uint64_t>(m_lists.size()));
+        for (const auto& list : m_lists) {
+            write_pod(out, static_cast<uint64_t>(list.ids.size()));
+            out.write(reinterpret_cast<const char*>(list.ids.data()), list.ids.size() * sizeof(size_t));
+            out.write(reinterpret_cast<const char*>(list.codes.data()), list.codes.size());
+        }
+
+        write_pod(out, static_cast<uint64_t>(m_pending_ids.size()));
+        out.write(reinterpret_cast<const char*>(m_pending_ids.data()), m_pending_ids.size() * sizeof(size_t));
+        out.write(reinterpret_cast<const char*>(m_pending.data()), m_pending.size() * sizeof(float));
+        return static_cast<bool>(out);
+    }
+
+    bool IvfPqIndex::load(const std::filesystem::path& path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open()) return false;
+
+        uint64_t magic = 0, dim = 0, codebook_bytes = 0;
+        if (!read_pod(in, magic) || !read_pod(in, dim) || !read_pod(in, codebook_bytes)) return false;
+        if (magic != kIndexMagic || dim != m_dim) return false;
+
+        // Every count below sizes an allocation; one the rest of the file cannot hold means a bad file
+        std::error_code ec;
+        uint64_t file_size = std::filesystem::file_size(path, ec);
+        if (ec) return false;
+        auto fits = [&](uint64_t count, uint64_t bytes_each) {
+            uint64_t at = static_cast<uint64_t>(in.tellg());
+            return at <= file_size && (bytes_each == 0 || count <= (file_size - at) / bytes_each);
+        };
+        if (!fits(codebook_bytes, 1)) return false;
+
+        IvfPqOptions options = m_options;
+        options.codebooks.resize(codebook_bytes);
+        if (!in.read(reinterpret_cast<char*>(options.codebooks.data()), codebook_bytes)) return false;
+
+        // Build into a fresh index so a bad file leaves this one untouched
+        IvfPqIndex loaded(m_dim, options);
+        if (codebook_bytes > 0 && !loaded.trained()) return false;
+
+        uint64_t nlist = 0;
+        if (!read_pod(in, nlist) || nlist != loaded.m_lists.size()) return false;
+        for (uint32_t l = 0; l < nlist; ++l) {
+            uint64_t count = 0;
+            if (!read_pod(in, count) || !fits(count, sizeof(size_t) + m_m)) return false;
+            auto& list = loaded.m_lists[l];
+            list.ids.resize(count);
+            list.codes.resize(((count + kBlock - 1) / kBlock) * m_m * kBlock);
+            if (!in.read(reinterpret_cast<char*>(list.ids.data()), count * sizeof(size_t))) return false;
+            if (!in.read(reinterpret_cast<char*>(list.codes.data()), list.codes.size())) return false;
+            for (uint32_t pos = 0; pos < count; ++pos) {
+                loaded.set_location(list.ids[pos], (static_cast<uint64_t>(l) << 32) | pos);
+            }
+            loaded.m_count += count;
+        }
+
+        uint64_t pending = 0;
+        if (!read_pod(in, pending) || !fits(pending, sizeof(size_t) + m_dim * sizeof(float))) return false;
+        loaded.m_pending_ids.resize(pending);
+        loaded.m_pending.resize(pending * m_dim);
+        if (!in.read(reinterpret_cast<char*>(loaded.m_pending_ids.data()), pending * sizeof(size_t))) return false;
+        if (!in.read(reinterpret_cast<char*>(loaded.m_pending.data()), loaded.m_pending.size() * sizeof(float))) return false;
+        for (uint32_t pos = 0; pos < pending; ++pos) {
+            loaded.set_location(loaded.m_pending_ids[pos], (static_cast<uint64_t>(kPendingList) << 32) | pos);
+        }
+
+        // Only the contents move: the shape stays as is for a train() running meanwhile,
+        // and a Training taken before is void now
+        m_coarse = std::move(loaded.m_coarse);
+        m_pq = std::move(loaded.m_pq);
+        m_lists = std::move(loaded.m_lists);
+        m_count = loaded.m_count;
+        m_locations = std::move(loaded.m_locations);
+        m_pending_ids = std::move(loaded.m_pending_ids);
+        m_pending = std::move(loaded.m_pending);
+        m_training = false;
+        m_training_dirty.clear();
+        ++m_training_epoch;
+        return true;
+    }
+
+}
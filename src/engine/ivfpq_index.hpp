@@ -0,0 +1,126 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <unordered_set>
+
+namespace kestr::engine {
+
+    struct IvfPqOptions {
+        size_t nlist = 1024;            // Coarse clusters (capped at training set size / 39)
+        size_t m = 32;                  // Sub-quantizers = bytes per stored code (rounded to a divisor of dim)
+        size_t nprobe = 16;             // Inverted lists scanned per query
+        size_t train_size = 50000;      // Vectors buffered in fp32 before the quantizers are trained
+        std::vector<uint8_t> codebooks; // Previously trained codebooks (IvfPqIndex::export_codebooks)
+    };
+
+    /**
+     * @brief Inverted-file index with product-quantized residuals (IVF-PQ).
+     * A k-means coarse quantizer assigns each vector to a list; the residual to the list
+     * centroid is split into m sub-vectors, each stored as one byte (index into a 256-entry
+     * sub-codebook). Queries scan the nprobe closest lists with per-list distance lookup
+     * tables (ADC). Until train_size vectors have arrived, vectors are kept in fp32 and
+     * searched exhaustively; the quantizers are then trained on them.
+     * Not thread-safe; the Librarian serializes access, except for train(), which only reads
+     * its argument and the immutable shape and may run alongside any other call.
+     */
+    class IvfPqIndex {
+    public:
+        /**
+         * @brief Buffered vectors copied for training, and the trained quantizers and codes.
+         */
+        struct Training {
+            std::vector<size_t> ids;
+            std::vector<float> vectors;
+            std::vector<float> coarse;
+            std::vector<float> pq;
+            std::vector<uint32_t> lists; // Per vector: inverted list
+            std::vector<uint8_t> codes;  // Per vector: m codes
+            uint64_t epoch = 0;
+        };
+
+        IvfPqIndex(size_t dim, IvfPqOptions options);
+
+        /**
+         * @brief Adds or replaces a vector. Trains the quantizers in place once train_size
+         * vectors are buffered, unless training is deferred.
+         */
+        void add(size_t id, const std::vector<float>& vector);
+        void remove(size_t id);
+
+        /**
+         * @brief Leaves training to the caller: take_training() hands out a copy of the buffer
+         * once it is full, train() does the k-means work on that copy without touching the
+         * index, and install() swaps the result in. Vectors changed in between are re-encoded.
+         */
+        void defer_training(bool deferred) { m_defer_training = deferred; }
+        std::optional<Training> take_training();
+        void train(Training& training) const;
+        void install(Training training);
+
+        /**
+         * @param allowed If set, only ids it accepts are returned.
+         * @return Up to k (squared L2 distance, id) pairs, closest first.
+         */
+        std::vector<std::pair<float, size_t>> search(const std::vector<float>& query, size_t k,
+                                                     const std::function<bool(size_t)>& allowed = nullptr) const;
+
+        size_t size() const { return m_count + m_pending_ids.size(); }
+        void for_each_id(const std::function<void(size_t)>& fn) const;
+        bool trained() const { return !m_coarse.empty(); }
+        size_t code_size() const { return m_m; }
+
+        /**
+         * @brief Serialized coarse and PQ codebooks; empty until trained.
+         */
+        std::vector<uint8_t> export_codebooks() const;
+
+        bool save(const std::filesystem::path& path) const;
+        bool load(const std::filesystem::path& path);
+
+    private:
+        static constexpr size_t kBlock = 8;   // Codes are interleaved in blocks of 8 vectors for the SIMD scan
+        static constexpr size_t kKsub = 256;  // Entries per sub-codebook (one byte per code)
+
+        struct InvertedList {
+            std::vector<size_t> ids;
+            std::vector<uint8_t> codes; // Block b, sub-quantizer j, lane v at [(b * m + j) * kBlock + v]
+        };
+
+        bool import_codebooks(const std::vector<uint8_t>& data);
+        uint32_t quantize(const float* vector, const float* coarse, size_t nlist, const float* pq, uint8_t* codes) const;
+        void encode_into(size_t id, const float* vector);
+        void place(size_t id, uint32_t list_no, const uint8_t* codes);
+        void erase_at(uint32_t list, uint32_t pos);
+        uint8_t code_at(const InvertedList& list, size_t pos, size_t j) const;
+        void set_location(size_t id, uint64_t location);
+        uint64_t location(size_t id) const;
+
+        size_t m_dim;
+        size_t m_m;
+        size_t m_dsub;
+        IvfPqOptions m_options;
+
+        std::vector<float> m_coarse;  // nlist x dim
+        std::vector<float> m_pq;      // m x kKsub x dsub
+        std::vector<InvertedList> m_lists;
+        size_t m_count = 0;
+
+        // Chunk ids are SQLite rowids and fairly dense, so a flat table (list << 32 | pos)
+        // is far smaller than a hash map at millions of entries.
+        std::vector<uint64_t> m_locations;
+
+        std::vector<size_t> m_pending_ids;
+        std::vector<float> m_pending;  // fp32 vectors waiting for training
+
+        bool m_defer_training = false;
+        bool m_training = false;        // A Training is out
+        uint64_t m_training_epoch = 0;  // Bumped by take_training() and load()
+        std::unordered_set<size_t> m_training_dirty; // Ids added since the Training was taken
+    };
+
+}
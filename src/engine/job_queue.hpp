@@ -4,6 +4,7 @@
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
+#include <deque>
 #include "kestr/types.hpp"
 
 namespace kestr::engine {
@@ -46,4 +47,79 @@ namespace kestr::engine {
         std::atomic<bool> m_stop{false};
     };
 
+    /**
+     * @brief Fixed-capacity blocking queue used between indexing pipeline stages.
+     * push() blocks while the queue is full so a slow stage applies back-pressure
+     * to the stages feeding it.
+     */
+    template <typename T>
+    class BoundedQueue {
+    public:
+        explicit BoundedQueue(size_t capacity) : m_capacity(capacity ? capacity : 1) {}
+
+        /**
+         * @brief Blocks until there is room, then enqueues.
+         * @return false if the queue was stopped.
+         */
+        bool push(T item) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_not_full.wait(lock, [this] { return m_queue.size() < m_capacity || m_stop; });
+            if (m_stop) return false;
+            m_queue.push_back(std::move(item));
+            lock.unlock();
+            m_not_empty.notify_one();
+            return true;
+        }
+
+        /**
+         * @brief Blocks until an item is available.
+         * @return false if the queue was stopped.
+         */
+        bool pop(T& item) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_not_empty.wait(lock, [this] { return !m_queue.empty() || m_stop; });
+            if (m_stop) return false;
+            item = std::move(m_queue.front());
+            m_queue.pop_front();
+            lock.unlock();
+            m_not_full.notify_one();
+            return true;
+        }
+
+        /**
+         * @brief Non-blocking pop, used to coalesce queued items into batches.
+         */
+        bool try_pop(T& item) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_queue.empty() || m_stop) return false;
+            item = std::move(m_queue.front());
+            m_queue.pop_front();
+            lock.unlock();
+            m_not_full.notify_one();
+            return true;
+        }
+
+        void stop() {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_not_empty.notify_all();
+            m_not_full.notify_all();
+        }
+
+        size_t size() const {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_queue.size();
+        }
+
+    private:
+        std::deque<T> m_queue;
+        size_t m_capacity;
+        mutable std::mutex m_mutex;
+        std::condition_variable m_not_empty;
+        std::condition_variable m_not_full;
+        bool m_stop = false;
+    };
+
 }
@@ -1,72 +1,1023 @@
 #include "librarian.hpp"
 #include <hnswlib/hnswlib.h>
 #include <iostream>
+#include <algorithm>
+#include <shared_mutex>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <atomic>
+#include <thread>
+#include <unordered_map>
+
+#ifndef KESTR_PLATFORM_WINDOWS
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 namespace kestr::engine {
 
+    namespace {
+
+        using Index = hnswlib::HierarchicalNSW<float>;
+
+        // Initial capacity of the in-RAM delta that takes inserts in mapped mode
+        constexpr size_t kDeltaCapacity = 4096;
+
+        // Search beam width (hnswlib's ef) unless the caller asks for another
+        constexpr size_t kDefaultEf = 100;
+
+        /**
+         * @brief Inserts or updates one label. hnswlib's addPoint(..., replace_deleted = true) takes
+         * any free deleted slot without checking whether the label already exists, which would leave
+         * a live item in the graph twice (and a re-added deleted one under two slots). Existing labels
+         * are therefore undeleted and updated in place; only new ones may take a deleted slot.
+         */
+        void upsert_point(Index& index, const void* point, size_t id) {
+            bool exists;
+            {
+                std::lock_guard<std::mutex> lock(index.label_lookup_lock);
+                exists = index.label_lookup_.count(id) > 0;
+            }
+            if (!exists) {
+                index.addPoint(point, id, true);
+                return;
+            }
+            try { index.unmarkDelete(id); } catch (...) {} // Still live
+            index.addPoint(point, id, false);
+        }
+
+        template<typename T>
+        void read_pod(const char*& cursor, const char* end, T& out) {
+            if (static_cast<size_t>(end - cursor) < sizeof(T)) throw std::runtime_error("Index file is truncated");
+            std::memcpy(&out, cursor, sizeof(T));
+            cursor += sizeof(T);
+        }
+
+        /**
+         * @brief Allocates the per-element bookkeeping of an index whose header fields are set.
+         */
+        void init_storage(Index& index, size_t max_elements) {
+            index.max_elements_ = max_elements;
+            index.size_links_per_element_ = index.maxM_ * sizeof(hnswlib::tableint) + sizeof(hnswlib::linklistsizeint);
+            index.size_links_level0_ = index.maxM0_ * sizeof(hnswlib::tableint) + sizeof(hnswlib::linklistsizeint);
+            std::vector<std::mutex>(max_elements).swap(index.link_list_locks_);
+            std::vector<std::mutex>(Index::MAX_LABEL_OPERATION_LOCKS).swap(index.label_op_locks_);
+            index.visited_list_pool_.reset(new hnswlib::VisitedListPool(1, max_elements));
+            index.linkLists_ = static_cast<char**>(std::malloc(sizeof(void*) * max_elements));
+            if (!index.linkLists_) throw std::runtime_error("Not enough memory to load index");
+            std::fill(index.linkLists_, index.linkLists_ + max_elements, nullptr);
+            index.element_levels_ = std::vector<int>(max_elements);
+            index.revSize_ = 1.0 / index.mult_;
+            index.allow_replace_deleted_ = true;
+        }
+
+        /**
+         * @brief Copies an index into one with room for `capacity` elements.
+         * Level 0 and the upper-layer link lists are copied straight across, so the peak
+         * is the old index plus the grown one. The caller must keep writers out.
+         */
+        std::unique_ptr<Index> grown_copy(hnswlib::SpaceInterface<float>* space, const Index& from, size_t capacity) {
+            size_t count = from.cur_element_count;
+            auto index = std::make_unique<Index>(space);
+            index->offsetLevel0_ = from.offsetLevel0_;
+            index->size_data_per_element_ = from.size_data_per_element_;
+            index->label_offset_ = from.label_offset_;
+            index->offsetData_ = from.offsetData_;
+            index->maxlevel_ = from.maxlevel_;
+            index->enterpoint_node_ = from.enterpoint_node_;
+            index->maxM_ = from.maxM_;
+            index->maxM0_ = from.maxM0_;
+            index->M_ = from.M_;
+            index->mult_ = from.mult_;
+            index->ef_construction_ = from.ef_construction_;
+            index->data_size_ = from.data_size_;
+            index->fstdistfunc_ = from.fstdistfunc_;
+            index->dist_func_param_ = from.dist_func_param_;
+
+            size_t max_elements = std::max(capacity, count);
+            index->data_level0_memory_ = static_cast<char*>(std::malloc(max_elements * index->size_data_per_element_));
+            if (!index->data_level0_memory_) throw std::runtime_error("Not enough memory to grow index");
+            std::memcpy(index->data_level0_memory_, from.data_level0_memory_, count * index->size_data_per_element_);
+
+            init_storage(*index, max_elements);
+            index->ef_ = from.ef_;
+            index->cur_element_count = count;
+            for (size_t i = 0; i < count; ++i) {
+                int level = from.element_levels_[i];
+                index->element_levels_[i] = level;
+                if (level <= 0) continue;
+                size_t link_list_size = index->size_links_per_element_ * level;
+                index->linkLists_[i] = static_cast<char*>(std::malloc(link_list_size));
+                if (!index->linkLists_[i]) throw std::runtime_error("Not enough memory to grow index");
+                std::memcpy(index->linkLists_[i], from.linkLists_[i], link_list_size);
+            }
+            index->label_lookup_ = from.label_lookup_;
+            index->deleted_elements = from.deleted_elements;
+            index->num_deleted_ = from.num_deleted_.load();
+            return index;
+        }
+
+        /**
+         * @brief Builds a HierarchicalNSW around a saved index image.
+         * Mirrors HierarchicalNSW::loadIndex of hnswlib v0.8.0 (the version pinned in
+         * CMakeLists.txt), except that level 0 - vectors, labels and base-layer links,
+         * i.e. almost the whole file - is either borrowed from the image (capacity == 0)
+         * or copied into a heap buffer sized for `capacity` elements.
+         * A borrowed index must have data_level0_memory_ reset before it is destroyed.
+         */
+        std::unique_ptr<Index> index_from_image(hnswlib::SpaceInterface<float>* space, const char* image, size_t size, size_t capacity) {
+            const char* cursor = image;
+            const char* end = image + size;
+            auto index = std::make_unique<Index>(space);
+
+            size_t count = 0;
+            read_pod(cursor, end, index->offsetLevel0_);
+            read_pod(cursor, end, index->max_elements_);
+            read_pod(cursor, end, count);
+            read_pod(cursor, end, index->size_data_per_element_);
+            read_pod(cursor, end, index->label_offset_);
+            read_pod(cursor, end, index->offsetData_);
+            read_pod(cursor, end, index->maxlevel_);
+            read_pod(cursor, end, index->enterpoint_node_);
+            read_pod(cursor, end, index->maxM_);
+            read_pod(cursor, end, index->maxM0_);
+            read_pod(cursor, end, index->M_);
+            read_pod(cursor, end, index->mult_);
+            read_pod(cursor, end, index->ef_construction_);
+
+            index->data_size_ = space->get_data_size();
+            index->fstdistfunc_ = space->get_dist_func();
+            index->dist_func_param_ = space->get_dist_func_param();
+            if (index->size_data_per_element_ != index->maxM0_ * sizeof(hnswlib::tableint) + sizeof(hnswlib::linklistsizeint) +
+                                                 index->data_size_ + sizeof(hnswlib::labeltype)) {
+                throw std::runtime_error("Index file does not match the vector dimension");
+            }
+            size_t level0_bytes = count * index->size_data_per_element_;
+            if (static_cast<size_t>(end - cursor) < level0_bytes) throw std::runtime_error("Index file is truncated");
+
+            size_t max_elements = capacity ? std::max(capacity, count) : count;
+            if (capacity) {
+                index->data_level0_memory_ = static_cast<char*>(std::malloc(max_elements * index->size_data_per_element_));
+                if (!index->data_level0_memory_) throw std::runtime_error("Not enough memory to load index");
+                std::memcpy(index->data_level0_memory_, cursor, level0_bytes);
+            } else {
+                index->data_level0_memory_ = const_cast<char*>(cursor);
+            }
+            cursor += level0_bytes;
+
+            try {
+                init_storage(*index, max_elements);
+                index->ef_ = 10;
+                index->cur_element_count = count;
+
+                // Upper layers hold roughly 1/M of the elements and are copied to the heap
+                for (size_t i = 0; i < count; ++i) {
+                    index->label_lookup_[index->getExternalLabel(i)] = i;
+                    unsigned int link_list_size = 0;
+                    read_pod(cursor, end, link_list_size);
+                    if (link_list_size == 0) {
+                        index->element_levels_[i] = 0;
+                        index->linkLists_[i] = nullptr;
+                        continue;
+                    }
+                    if (static_cast<size_t>(end - cursor) < link_list_size) throw std::runtime_error("Index file is truncated");
+                    index->linkLists_[i] = static_cast<char*>(std::malloc(link_list_size));
+                    if (!index->linkLists_[i]) throw std::runtime_error("Not enough memory to load index");
+                    std::memcpy(index->linkLists_[i], cursor, link_list_size);
+                    index->element_levels_[i] = link_list_size / index->size_links_per_element_;
+                    cursor += link_list_size;
+                }
+
+                for (size_t i = 0; i < count; ++i) {
+                    if (index->isMarkedDeleted(i)) {
+                        index->num_deleted_ += 1;
+                        index->deleted_elements.insert(i);
+                    }
+                }
+            } catch (...) {
+                if (!capacity) index->data_level0_memory_ = nullptr;
+                throw;
+            }
+            return index;
+        }
+
+        /**
+         * @brief A saved index served straight from a private (copy-on-write) file mapping.
+         * Pages are faulted in on demand, so resident memory follows the searched working set.
+         * markDelete only dirties the touched pages; the file itself is never written.
+         */
+        struct MappedIndex {
+            void* addr = nullptr;
+            size_t size = 0;
+            std::unique_ptr<Index> index;
+
+            ~MappedIndex() {
+                if (index) index->data_level0_memory_ = nullptr; // Owned by the mapping, not malloc
+                index.reset();
+#ifndef KESTR_PLATFORM_WINDOWS
+                if (addr) munmap(addr, size);
+#endif
+            }
+        };
+
+        std::unique_ptr<MappedIndex> map_index(hnswlib::SpaceInterface<float>* space, const std::filesystem::path& path) {
+#ifndef KESTR_PLATFORM_WINDOWS
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) throw std::runtime_error("Cannot open " + path.string());
+            struct stat st;
+            if (fstat(fd, &st) != 0 || st.st_size == 0) {
+                ::close(fd);
+                throw std::runtime_error("Cannot stat " + path.string());
+            }
+            void* addr = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            ::close(fd); // The mapping keeps the file (and its inode, across renames) alive
+            if (addr == MAP_FAILED) throw std::runtime_error("Cannot map " + path.string());
+
+            // Graph traversal jumps around the file; read-ahead would only pollute the page cache
+            madvise(addr, st.st_size, MADV_RANDOM);
+
+            auto mapped = std::make_unique<MappedIndex>();
+            mapped->addr = addr;
+            mapped->size = st.st_size;
+            mapped->index = index_from_image(space, static_cast<const char*>(addr), mapped->size, 0);
+            return mapped;
+#else
+            (void)space; (void)path;
+            throw std::runtime_error("Memory-mapped indexes are not supported on this platform");
+#endif
+        }
+
+        size_t live_count(Index& index) {
+            return index.getCurrentElementCount() - index.getDeletedCount();
+        }
+
+        // True when addPoint needs a new slot and none is left (deleted slots get reused first)
+        bool is_full(Index& index) {
+            return index.getCurrentElementCount() >= index.getMaxElements() && index.getDeletedCount() == 0;
+        }
+
+        /**
+         * @brief hnswlib space over ScalarQuantizer codes: one byte per dimension, integer L2.
+         */
+        class Int8L2Space : public hnswlib::SpaceInterface<float> {
+        public:
+            explicit Int8L2Space(size_t dim) : m_dim(dim) {}
+
+            size_t get_data_size() override { return m_dim; }
+            hnswlib::DISTFUNC<float> get_dist_func() override { return &Int8L2Space::distance; }
+            void* get_dist_func_param() override { return &m_dim; }
+
+        private:
+            static float distance(const void* a, const void* b, const void* param) {
+                return static_cast<float>(ScalarQuantizer::distance(static_cast<const uint8_t*>(a), static_cast<const uint8_t*>(b),
+                                                                    *static_cast<const size_t*>(param)));
+            }
+
+            size_t m_dim;
+        };
+
+        float l2_squared(const std::vector<float>& a, const float* b) {
+            float sum = 0.0f;
+            for (size_t i = 0; i < a.size(); ++i) {
+                float d = a[i] - b[i];
+                sum += d * d;
+            }
+            return sum;
+        }
+
+        /**
+         * @brief Per-item filter attributes, interned to 16-bit ids (0 = unset) and indexed by chunk id.
+         * Chunk ids are dense SQLite rowids, so a flat array costs 6 bytes per item.
+         */
+        class AttributeTable {
+        public:
+            struct Row {
+                uint16_t type = 0;
+                uint16_t language = 0;
+                uint16_t project = 0;
+            };
+
+            void set(size_t id, const Chunk& chunk) {
+                std::unique_lock<std::shared_mutex> lock(m_mutex);
+                if (id >= m_rows.size()) m_rows.resize(std::max(id + 1, m_rows.size() * 3 / 2));
+                m_rows[id] = {intern(m_types, chunk.symbol_type), intern(m_languages, chunk.language), intern(m_projects, chunk.project_root)};
+            }
+
+            // Translates filters into the row every match must agree with; false if nothing can match
+            bool resolve(const SearchFilters& filters, Row& wanted) const {
+                return lookup(m_types, filters.type_filter, wanted.type) &&
+                       lookup(m_languages, filters.language, wanted.language) &&
+                       lookup(m_projects, filters.scope, wanted.project);
+            }
+
+            bool matches(size_t id, const Row& wanted) const {
+                if (id >= m_rows.size()) return false;
+                const Row& row = m_rows[id];
+                return (!wanted.type || row.type == wanted.type) &&
+                       (!wanted.language || row.language == wanted.language) &&
+                       (!wanted.project || row.project == wanted.project);
+            }
+
+            // Held by filtered searches so rows are not reallocated under them
+            std::shared_mutex& mutex() const { return m_mutex; }
+
+        private:
+            using Dictionary = std::unordered_map<std::string, uint16_t>;
+
+            static uint16_t intern(Dictionary& dict, const std::string& value) {
+                if (value.empty()) return 0;
+                auto it = dict.find(value);
+                if (it != dict.end()) return it->second;
+                if (dict.size() >= UINT16_MAX) return 0; // Out of ids: the item just cannot be filtered on this field
+                uint16_t id = static_cast<uint16_t>(dict.size() + 1);
+                dict.emplace(value, id);
+                return id;
+            }
+
+            static bool lookup(const Dictionary& dict, const std::string& value, uint16_t& id) {
+                id = 0;
+                if (value.empty()) return true;
+                auto it = dict.find(value);
+                if (it == dict.end()) return false;
+                id = it->second;
+                return true;
+            }
+
+            std::vector<Row> m_rows;
+            Dictionary m_types, m_languages, m_projects;
+            mutable std::shared_mutex m_mutex;
+        };
+
+        class AttributeFilter : public hnswlib::BaseFilterFunctor {
+        public:
+            AttributeFilter(const AttributeTable& table, AttributeTable::Row wanted) : m_table(table), m_wanted(wanted) {}
+            bool operator()(hnswlib::labeltype id) override { return m_table.matches(id, m_wanted); }
+
+        private:
+            const AttributeTable& m_table;
+            AttributeTable::Row m_wanted;
+        };
+
+        void normalize(std::vector<float>& v) {
+            float norm = 0.0f;
+            for (float x : v) norm += x * x;
+            if (norm <= 0.0f) return; // Leave all-zero vectors alone
+            float inv = 1.0f / std::sqrt(norm);
+            for (float& x : v) x *= inv;
+        }
+
+    }
+
     struct Librarian::Impl {
-        hnswlib::L2Space space;
-        std::unique_ptr<hnswlib::HierarchicalNSW<float>> alg_hnsw;
+        std::unique_ptr<hnswlib::SpaceInterface<float>> space;
+        std::optional<ScalarQuantizer> quantizer; // Set: the index stores uint8 codes instead of fp32
+        std::unique_ptr<IvfPqIndex> ivf;   // IVF-PQ backend; replaces the graphs when set
+        std::unique_ptr<FlatIndex> flat;   // Exact scan that serves instead of the graphs while set
+        size_t flat_upgrade = 0;           // Item count past which `flat` is turned into the graph
+        size_t upgrade_retry_at = 0;       // After a failed build: item count for the next attempt
         size_t max_elements_cached;
+        bool mapped;
+        Metric metric;
+
+        /**
+         * @brief The graphs being served. A published Graphs is never modified in structure:
+         * resize, load and merge build a replacement and swap the pointer (RCU), so searches
+         * pin the current one and run without taking any lock.
+         */
+        struct Graphs {
+            std::shared_ptr<Index> index;       // The whole index, or the delta on top of `base` in mapped mode
+            std::shared_ptr<MappedIndex> base;  // Mapped mode only: last persisted index
+        };
+        std::shared_ptr<const Graphs> graphs;
+
+        // HNSW: shared for point updates (hnswlib locks elements internally), exclusive while a
+        // replacement is built and published, so no insert is lost in the copy.
+        // IVF-PQ and flat: shared for searches, exclusive for updates.
+        mutable std::shared_mutex mutex;
+
+        // Flat -> graph upgrade: the graph is built on the background thread from a copy of the
+        // flat index without any lock, so searches and writes go on; writes made meanwhile are
+        // recorded and replayed.
+        std::mutex upgrade_mutex;
+        bool upgrading = false;
+        std::vector<size_t> upgrade_dirty;
+
+        // Long rebuilds run here instead of on the writer that triggered them; one at a time
+        std::mutex background_mutex;
+        std::thread background;
+        std::atomic<bool> background_busy{false};
+
+        AttributeTable attributes;
+        std::atomic<uint64_t> changes{0};
+
+        // Optional fp32 rerank of quantized results
+        VectorLookup rerank_lookup;
+        size_t rerank_factor = 0;
 
-        Impl(size_t dim, size_t max_elements) : space(dim), max_elements_cached(max_elements) {
+        Impl(size_t dim, size_t max_elements, bool mapped_mode, std::optional<ScalarQuantizer> q, Metric m)
+            : quantizer(std::move(q)), max_elements_cached(max_elements), mapped(mapped_mode), metric(m) {
+            // On unit vectors L2 ranks exactly like the inner product, so the int8 codes keep their L2 kernel
+            if (quantizer) space = std::make_unique<Int8L2Space>(dim);
+            else if (metric == Metric::Cosine) space = std::make_unique<hnswlib::InnerProductSpace>(dim);
+            else space = std::make_unique<hnswlib::L2Space>(dim);
             // Optimized HNSW parameters: M=16, ef_construction=200
             // Enable allow_replace_deleted (last parameter) to handle updates gracefully
-            alg_hnsw = std::make_unique<hnswlib::HierarchicalNSW<float>>(&space, max_elements, 16, 200, 100, true);
+            publish(make_index(mapped ? std::min(max_elements, kDeltaCapacity) : max_elements), nullptr);
+        }
+
+        std::shared_ptr<const Graphs> pin() const {
+            return std::atomic_load(&graphs);
+        }
+
+        void publish(std::shared_ptr<Index> index, std::shared_ptr<MappedIndex> base) {
+            std::atomic_store(&graphs, std::shared_ptr<const Graphs>(new Graphs{std::move(index), std::move(base)}));
+        }
+
+        Impl(size_t dim, const IvfPqOptions& options, Metric m)
+            : ivf(std::make_unique<IvfPqIndex>(dim, options)), max_elements_cached(0), mapped(false), metric(m) {
+            ivf->defer_training(true); // Trained on the background thread, outside the lock
+        }
+
+        std::unique_ptr<Index> make_index(size_t max_elements) {
+            return std::make_unique<Index>(space.get(), std::max<size_t>(1, max_elements), 16, 200, 100, true);
+        }
+
+        // Returns the vector as indexed: normalized into `scratch` for cosine, otherwise unchanged
+        const std::vector<float>& prepare(const std::vector<float>& vector, std::vector<float>& scratch) const {
+            if (metric != Metric::Cosine) return vector;
+            scratch = vector;
+            normalize(scratch);
+            return scratch;
+        }
+
+        // Similarity for a squared L2 distance between indexed vectors
+        float score_from_l2(float distance) const {
+            return metric == Metric::Cosine ? 1.0f - distance / 2.0f : 1.0f / (1.0f + distance);
+        }
+
+        // Exact similarity of a prepared query to a stored, database or decoded vector
+        float exact_score(const std::vector<float>& query, const float* vector) const {
+            if (metric != Metric::Cosine) return 1.0f / (1.0f + l2_squared(query, vector));
+            float dot = 0.0f, norm = 0.0f;
+            for (size_t i = 0; i < query.size(); ++i) {
+                dot += query[i] * vector[i];
+                norm += vector[i] * vector[i];
+            }
+            return norm > 0.0f ? dot / std::sqrt(norm) : 0.0f;
+        }
+
+        // Scores a quantized hit from its decoded codes
+        float decoded_score(const Graphs& g, const std::vector<float>& query, size_t id) const {
+            std::vector<uint8_t> codes;
+            try {
+                codes = g.index->getDataByLabel<uint8_t>(id);
+            } catch (...) {
+                if (!g.base) return 0.0f;
+                try { codes = g.base->index->getDataByLabel<uint8_t>(id); } catch (...) { return 0.0f; }
+            }
+            auto vector = quantizer->decode(codes.data());
+            return exact_score(query, vector.data());
+        }
+
+        // Returns what the index stores for a vector: the vector itself, or its codes in `scratch`
+        const void* point(const std::vector<float>& vector, std::vector<uint8_t>& scratch) const {
+            if (!quantizer) return vector.data();
+            scratch.resize(vector.size());
+            quantizer->encode(vector.data(), scratch.data());
+            return scratch.data();
         }
     };
 
-    Librarian::Librarian(size_t dim, size_t max_elements) : m_dim(dim) {
-        m_impl = std::make_unique<Impl>(dim, max_elements);
+    Librarian::Librarian(size_t dim, size_t max_elements, bool mapped, std::optional<ScalarQuantizer> quantizer, Metric metric)
+        : m_dim(dim) {
+        if (quantizer && quantizer->dimension() != dim) {
+            std::cerr << "[Librarian] Quantizer dimension mismatch, storing fp32 vectors.\n";
+            quantizer.reset();
+        }
+#ifdef KESTR_PLATFORM_WINDOWS
+        if (mapped) {
+            std::cerr << "[Librarian] Memory-mapped mode is not available on Windows, keeping the index in RAM.\n";
+            mapped = false;
+        }
+#endif
+        m_impl = std::make_unique<Impl>(dim, max_elements, mapped, std::move(quantizer), metric);
+    }
+
+    Librarian::Librarian(size_t dim, const IvfPqOptions& options, Metric metric) : m_dim(dim) {
+        m_impl = std::make_unique<Impl>(dim, options, metric);
+    }
+
+    Librarian::~Librarian() {
+        wait_for_background();
+    }
+
+    void Librarian::start_background(std::function<void()> job) {
+        std::lock_guard<std::mutex> lock(m_impl->background_mutex);
+        // The previous job cleared background_busy as its last step, so this join returns at once
+        if (m_impl->background.joinable()) m_impl->background.join();
+        m_impl->background = std::thread([this, job = std::move(job)] {
+            try {
+                job();
+            } catch (const std::exception& e) {
+                std::cerr << "[Librarian] Background rebuild failed: " << e.what() << "\n";
+            }
+            m_impl->background_busy = false;
+        });
     }
 
-    Librarian::~Librarian() = default;
+    void Librarian::wait_for_background() {
+        std::lock_guard<std::mutex> lock(m_impl->background_mutex);
+        if (m_impl->background.joinable()) m_impl->background.join();
+    }
+
+    void Librarian::add_item(size_t id, const std::vector<float>& input) {
+        if (input.size() != m_dim) return;
+        ++m_impl->changes;
+        std::vector<float> normalized;
+        const auto& vector = m_impl->prepare(input, normalized);
+        if (m_impl->ivf) {
+            std::optional<IvfPqIndex::Training> training;
+            {
+                // Inverted lists are plain vectors; writers need the index to themselves
+                std::unique_lock<std::shared_mutex> lock(m_impl->mutex);
+                m_impl->ivf->add(id, vector);
+                if (!m_impl->background_busy.exchange(true)) {
+                    training = m_impl->ivf->take_training();
+                    if (!training) m_impl->background_busy = false;
+                }
+            }
+            if (training) {
+                // k-means on the copied buffer takes a while; searches and updates go on meanwhile,
+                // and the writer that filled the buffer does not wait for it
+                auto job = std::make_shared<IvfPqIndex::Training>(std::move(*training));
+                start_background([this, job] {
+                    m_impl->ivf->train(*job);
+                    std::unique_lock<std::shared_mutex> lock(m_impl->mutex);
+                    m_impl->ivf->install(std::move(*job));
+                });
+            }
+            return;
+        }
+        {
+            std::unique_lock<std::shared_mutex> lock(m_impl->mutex);
+            if (m_impl->flat) {
+                m_impl->flat->add(id, vector);
+                if (m_impl->upgrading) m_impl->upgrade_dirty.push_back(id);
+                bool upgrade = m_impl->flat_upgrade && !m_impl->upgrading &&
+                               m_impl->flat->size() > std::max(m_impl->flat_upgrade, m_impl->upgrade_retry_at) &&
+                               !m_impl->background_busy.exchange(true);
+                lock.unlock();
+                // The writer calls this under its own lock; it must not wait for the whole graph
+                if (upgrade) start_background([this] { upgrade_to_graph(); });
+                return;
+            }
+        }
+        std::vector<uint8_t> codes;
+        const void* point = m_impl->point(vector, codes);
+        // A concurrent writer can take the last free slot between our check and addPoint; retry then
+        for (int attempt = 0;; ++attempt) {
+            std::shared_lock<std::shared_mutex> lock(m_impl->mutex);
+            auto g = m_impl->pin();
+            if (g->base) {
+                // The mapped base is read-only; an update moves the item into the delta
+                try { g->base->index->markDelete(id); } catch (...) {}
+            }
+            if (is_full(*g->index)) {
+                lock.unlock();
+                if (!grow()) return;
+                continue;
+            }
+            try {
+                // New ids reuse slots of removed chunks before taking new ones
+                upsert_point(*g->index, point, id);
+                return;
+            } catch (const std::exception& e) {
+                if (attempt < 3 && is_full(*g->index)) continue;
+                std::cerr << "[Librarian] Failed to add item " << id << ": " << e.what() << "\n";
+                return;
+            }
+        }
+    }
+
+    bool Librarian::grow() {
+        try {
+            std::unique_lock<std::shared_mutex> lock(m_impl->mutex);
+            auto g = m_impl->pin();
+            auto& index = *g->index;
+            if (!is_full(index)) return true; // Another writer grew it already
+            // Doubling keeps the number of reallocations logarithmic in the corpus size.
+            // Searches keep using the old index until the grown copy is published.
+            size_t capacity = std::max<size_t>(index.getMaxElements() * 2, 1024);
+            std::shared_ptr<Index> grown = grown_copy(m_impl->space.get(), index, capacity);
+            m_impl->publish(std::move(grown), g->base);
+            // The mapped delta grows routinely between checkpoints; only report the main index
+            if (!m_impl->mapped) std::cout << "[Librarian] Grew index capacity to " << capacity << " items." << std::endl;
+            return true;
+        } catch (const std::exception& e) {
+            std::cerr << "[Librarian] Cannot grow the index: " << e.what() << "\n";
+        }
+        return false;
+    }
+
+    void Librarian::use_exact_search(size_t upgrade_at) {
+        std::unique_lock<std::shared_mutex> lock(m_impl->mutex);
+        if (m_impl->ivf || m_impl->flat || live_count(*m_impl->pin()->index) > 0) return;
+        // Only the metric matters to the scan: cosine vectors arrive normalized, so ranking by inner product is exact
+        m_impl->flat = std::make_unique<FlatIndex>(m_dim, m_impl->metric);
+        m_impl->flat_upgrade = upgrade_at;
+        m_impl->publish(m_impl->make_index(1), nullptr); // The graph is sized when it is built
+    }
+
+    void Librarian::upgrade_to_graph() {
+        std::lock_guard<std::mutex> once(m_impl->upgrade_mutex);
+        std::shared_ptr<Index> graph;
+        std::vector<size_t> ids;
+        std::vector<float> vectors;
+        {
+            // Copying costs a memcpy of the arena; building from the copy needs no lock at all
+            std::unique_lock<std::shared_mutex> lock(m_impl->mutex);
+            if (!m_impl->flat) return;
+            const FlatIndex& flat = *m_impl->flat;
+            ids.resize(flat.size());
+            vectors.resize(flat.size() * m_dim);
+            for (size_t row = 0; row < flat.size(); ++row) {
+                ids[row] = flat.id_at(row);
+                std::copy(flat.vector_at(row), flat.vector_at(row) + m_dim, vectors.begin() + row * m_dim);
+            }
+            m_impl->upgrading = true;
+            m_impl->upgrade_dirty.clear();
+        }
+        try {
+            std::cout << "[Librarian] " << ids.size() << " items, switching from exact search to HNSW..." << std::endl;
+            graph = m_impl->make_index(std::max(m_impl->max_elements_cached, ids.size() * 2));
+            std::vector<float> vector(m_dim);
+            std::vector<uint8_t> codes;
+            for (size_t row = 0; row < ids.size(); ++row) {
+                std::copy(vectors.begin() + row * m_dim, vectors.begin() + (row + 1) * m_dim, vector.begin());
+                graph->addPoint(m_impl->point(vector, codes), ids[row], true);
+            }
+        } catch (const std::exception& e) {
+            // Exact search keeps serving; try again once the index has doubled
+            std::unique_lock<std::shared_mutex> lock(m_impl->mutex);
+            m_impl->upgrading = false;
+            m_impl->upgrade_dirty.clear();
+            m_impl->upgrade_retry_at = ids.size() * 2;
+            std::cerr << "[Librarian] Cannot build the graph, keeping exact search until " << m_impl->upgrade_retry_at
+                      << " items: " << e.what() << "\n";
+            return;
+        }
 
-    void Librarian::add_item(size_t id, const std::vector<float>& vector) {
-        if (vector.size() != m_dim) return;
+        std::unique_lock<std::shared_mutex> lock(m_impl->mutex);
+        if (!m_impl->upgrading || !m_impl->flat) return; // load() replaced the contents meanwhile
+        auto& flat = *m_impl->flat;
         try {
-            // Use replace_if_exists = true to handle updates gracefully
-            m_impl->alg_hnsw->addPoint(vector.data(), id, true);
-        } catch (...) {
-            // Ignore if full or error to maintain stability
+            for (size_t id : m_impl->upgrade_dirty) {
+                const float* stored = flat.find(id);
+                if (!stored) {
+                    try { graph->markDelete(id); } catch (...) {}
+                    continue;
+                }
+                std::vector<float> vector(stored, stored + m_dim);
+                std::vector<uint8_t> codes;
+                if (is_full(*graph)) graph->resizeIndex(graph->getMaxElements() * 2);
+                upsert_point(*graph, m_impl->point(vector, codes), id);
+            }
+        } catch (const std::exception& e) {
+            m_impl->upgrading = false;
+            m_impl->upgrade_dirty.clear();
+            m_impl->upgrade_retry_at = ids.size() * 2;
+            std::cerr << "[Librarian] Cannot build the graph, keeping exact search until " << m_impl->upgrade_retry_at
+                      << " items: " << e.what() << "\n";
+            return;
         }
+        m_impl->publish(std::move(graph), nullptr);
+        m_impl->flat.reset();
+        m_impl->upgrading = false;
+        m_impl->upgrade_dirty.clear();
     }
 
     void Librarian::remove_item(size_t id) {
+        ++m_impl->changes;
+        if (m_impl->ivf) {
+            std::unique_lock<std::shared_mutex> lock(m_impl->mutex);
+            m_impl->ivf->remove(id);
+            return;
+        }
+        {
+            std::unique_lock<std::shared_mutex> lock(m_impl->mutex);
+            if (m_impl->flat) {
+                m_impl->flat->remove(id);
+                if (m_impl->upgrading) m_impl->upgrade_dirty.push_back(id);
+                return;
+            }
+        }
+        std::shared_lock<std::shared_mutex> lock(m_impl->mutex);
+        auto g = m_impl->pin();
+        if (g->base) {
+            try { g->base->index->markDelete(id); } catch (...) {}
+        }
         try {
-            m_impl->alg_hnsw->markDelete(id);
+            g->index->markDelete(id);
         } catch (...) {}
     }
 
-    std::vector<size_t> Librarian::search(const std::vector<float>& query_vector, size_t k) {
+    void Librarian::set_attributes(size_t id, const Chunk& chunk) {
+        m_impl->attributes.set(id, chunk);
+    }
+
+    std::vector<size_t> Librarian::search(const std::vector<float>& query_vector, size_t k, const SearchFilters& filters, size_t ef) {
         std::vector<size_t> results;
-        if (query_vector.size() != m_dim) return results;
+        for (const auto& hit : search_scored(query_vector, k, filters, ef)) results.push_back(hit.id);
+        return results;
+    }
 
-        try {
-            m_impl->alg_hnsw->setEf(100); // Higher ef during search for better recall
-            auto pq = m_impl->alg_hnsw->searchKnn(query_vector.data(), k);
-            
-            while (!pq.empty()) {
-                results.push_back(pq.top().second);
-                pq.pop();
-            }
-            std::reverse(results.begin(), results.end());
-        } catch (...) {}
+    std::vector<SearchHit> Librarian::search_scored(const std::vector<float>& input, size_t k, const SearchFilters& filters, size_t ef) {
+        std::vector<SearchHit> results;
+        if (input.size() != m_dim) return results;
+        std::vector<float> normalized;
+        const auto& query_vector = m_impl->prepare(input, normalized);
+
+        bool filtered = !filters.type_filter.empty() || !filters.language.empty() || !filters.scope.empty();
+        std::shared_lock<std::shared_mutex> attributes_lock(m_impl->attributes.mutex(), std::defer_lock);
+        AttributeTable::Row wanted;
+        if (filtered) {
+            attributes_lock.lock();
+            if (!m_impl->attributes.resolve(filters, wanted)) return results; // A value no item has
+        }
+        AttributeFilter filter(m_impl->attributes, wanted);
+
+        // Quantized distances only approximate the true order; over-fetch and rerank in fp32
+        std::shared_lock<std::shared_mutex> flat_lock(m_impl->mutex);
+        if (m_impl->flat) {
+            // Exact fp32 distances: nothing to rerank
+            std::function<bool(size_t)> allowed;
+            if (filtered) allowed = [&](size_t id) { return m_impl->attributes.matches(id, wanted); };
+            for (const auto& [distance, id] : m_impl->flat->search(query_vector.data(), k, allowed)) {
+                results.push_back({id, m_impl->metric == Metric::Cosine ? 1.0f - distance : m_impl->score_from_l2(distance)});
+            }
+            return results;
+        }
+        flat_lock.unlock();
+
+        bool rerank = (m_impl->quantizer || m_impl->ivf) && m_impl->rerank_lookup && m_impl->rerank_factor > 1;
+        size_t candidates = rerank ? k * m_impl->rerank_factor : k;
+
+        if (m_impl->ivf) {
+            std::shared_lock<std::shared_mutex> lock(m_impl->mutex);
+            std::function<bool(size_t)> allowed;
+            if (filtered) allowed = [&](size_t id) { return m_impl->attributes.matches(id, wanted); };
+            for (const auto& [distance, id] : m_impl->ivf->search(query_vector, candidates, allowed)) {
+                results.push_back({id, m_impl->score_from_l2(distance)});
+            }
+        } else {
+            try {
+                auto g = m_impl->pin();
+                std::vector<uint8_t> codes;
+                const void* query = m_impl->point(query_vector, codes);
+
+                // searchKnn explores max(ef_, k) candidates. Asking for ef results instead of calling
+                // setEf keeps the beam width per query; the index's own ef_ stays at its minimum.
+                size_t beam = std::max(candidates, ef ? ef : kDefaultEf);
+                hnswlib::BaseFilterFunctor* is_allowed = filtered ? &filter : nullptr;
+                auto pq = g->index->searchKnn(query, beam, is_allowed);
+
+                if (g->base) {
+                    // Both queues keep the closest on top-is-farthest order; merge and trim
+                    auto base_pq = g->base->index->searchKnn(query, beam, is_allowed);
+                    while (!base_pq.empty()) {
+                        pq.push(base_pq.top());
+                        base_pq.pop();
+                    }
+                }
+                while (pq.size() > candidates) pq.pop();
+
+                while (!pq.empty()) {
+                    auto [distance, id] = pq.top();
+                    pq.pop();
+                    float score;
+                    if (m_impl->quantizer) score = rerank ? 0.0f : m_impl->decoded_score(*g, query_vector, id); // Code-space distance has no unit
+                    else if (m_impl->metric == Metric::Cosine) score = 1.0f - distance; // InnerProductSpace returns 1 - dot
+                    else score = m_impl->score_from_l2(distance);
+                    results.push_back({id, score});
+                }
+                std::reverse(results.begin(), results.end());
+            } catch (...) {}
+        }
+
+        if (rerank && !results.empty()) {
+            std::vector<size_t> ids;
+            ids.reserve(results.size());
+            for (const auto& hit : results) ids.push_back(hit.id);
+            auto vectors = m_impl->rerank_lookup(ids);
+
+            std::vector<SearchHit> scored;
+            scored.reserve(results.size());
+            for (size_t id : ids) {
+                auto it = vectors.find(id);
+                if (it == vectors.end() || it->second.size() != m_dim) continue; // Gone from the database
+                scored.push_back({id, m_impl->exact_score(query_vector, it->second.data())});
+            }
+            std::stable_sort(scored.begin(), scored.end(), [](const auto& a, const auto& b) { return a.score > b.score; });
+            if (scored.size() > k) scored.resize(k);
+            results = std::move(scored);
+        } else if (results.size() > k) {
+            results.resize(k);
+        }
         return results;
     }
 
-    void Librarian::save(const std::filesystem::path& path) {
-        try { m_impl->alg_hnsw->saveIndex(path.string()); } catch (...) {}
+    void Librarian::set_rerank(VectorLookup lookup, size_t factor) {
+        std::unique_lock<std::shared_mutex> lock(m_impl->mutex);
+        m_impl->rerank_lookup = std::move(lookup);
+        m_impl->rerank_factor = factor;
     }
 
-    void Librarian::load(const std::filesystem::path& path) {
+    bool Librarian::save(const std::filesystem::path& path, std::string* encoding) {
+        {
+            std::shared_lock<std::shared_mutex> lock(m_impl->mutex);
+            if (m_impl->flat) {
+                // Read under the lock the file is written with: a background upgrade may publish the graph right after
+                if (encoding) *encoding = "flat";
+                if (m_impl->flat->save(path)) return true;
+                std::cerr << "[Librarian] Save failed: cannot write " << path.string() << "\n";
+                return false;
+            }
+        }
+        if (m_impl->ivf) {
+            std::shared_lock<std::shared_mutex> lock(m_impl->mutex);
+            if (encoding) *encoding = "ivfpq";
+            if (m_impl->ivf->save(path)) return true;
+            std::cerr << "[Librarian] Save failed: cannot write " << path.string() << "\n";
+            return false;
+        }
         try {
-            m_impl->alg_hnsw = std::make_unique<hnswlib::HierarchicalNSW<float>>(&m_impl->space, path.string(), false, m_impl->max_elements_cached);
-        } catch (...) {}
+            std::unique_lock<std::shared_mutex> lock(m_impl->mutex);
+            if (encoding) *encoding = m_impl->quantizer ? "int8" : "fp32";
+            auto g = m_impl->pin();
+            if (!g->base) {
+                g->index->saveIndex(path.string());
+                if (m_impl->mapped) {
+                    // First checkpoint in mapped mode: move everything out of RAM
+                    m_impl->publish(m_impl->make_index(kDeltaCapacity), map_index(m_impl->space.get(), path));
+                }
+                return true;
+            }
+
+            // Merge: copy the mapped image to the heap (its level 0 carries the copy-on-write
+            // deletions), fold the delta in, write it out and serve the new file from a fresh mapping.
+            auto& base = *g->base;
+            auto& delta = *g->index;
+            auto merged = index_from_image(m_impl->space.get(), static_cast<const char*>(base.addr), base.size,
+                                           base.index->getCurrentElementCount() + live_count(delta));
+
+            for (size_t i = 0; i < delta.getCurrentElementCount(); ++i) {
+                if (delta.isMarkedDeleted(i)) continue;
+                // Updated items are still in the base image as deleted slots under the same label
+                upsert_point(*merged, delta.getDataByInternalId(i), delta.getExternalLabel(i));
+            }
+            // Never truncate a file that may still be mapped (it could be `path` itself): searches on
+            // the old graphs would fault. Write aside and rename; the old inode lives on in its mapping.
+            std::filesystem::path fresh = path;
+            fresh += ".merge";
+            merged->saveIndex(fresh.string());
+            merged.reset();
+            std::filesystem::rename(fresh, path);
+
+            // Searches still holding the old graphs keep the old mapping alive until they finish
+            m_impl->publish(m_impl->make_index(kDeltaCapacity), map_index(m_impl->space.get(), path));
+            return true;
+        } catch (const std::exception& e) {
+            std::cerr << "[Librarian] Save failed: " << e.what() << "\n";
+        }
+        return false;
+    }
+
+    bool Librarian::load(const std::filesystem::path& path) {
+        try {
+            std::unique_lock<std::shared_mutex> lock(m_impl->mutex);
+            if (m_impl->flat) {
+                if (m_impl->flat->load(path)) {
+                    m_impl->upgrading = false; // A graph being built from the old contents is void
+                    return true;
+                }
+                std::cerr << "[Librarian] Load failed: " << path.string() << " is not a compatible flat index\n";
+                return false;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "[Librarian] Load failed: " << e.what() << "\n";
+            return false;
+        }
+        if (m_impl->ivf) {
+            try {
+                std::unique_lock<std::shared_mutex> lock(m_impl->mutex);
+                if (m_impl->ivf->load(path)) return true;
+                std::cerr << "[Librarian] Load failed: " << path.string() << " is not a compatible IVF-PQ index\n";
+            } catch (const std::exception& e) {
+                std::cerr << "[Librarian] Load failed: " << e.what() << "\n";
+            }
+            return false;
+        }
+        try {
+            // Built off to the side; searches move over when the new graphs are published
+            if (m_impl->mapped) {
+                std::shared_ptr<MappedIndex> base = map_index(m_impl->space.get(), path);
+                auto delta = m_impl->make_index(kDeltaCapacity);
+                std::unique_lock<std::shared_mutex> lock(m_impl->mutex);
+                m_impl->publish(std::move(delta), std::move(base));
+                return true;
+            }
+            auto loaded = std::make_unique<Index>(m_impl->space.get(), path.string(), false, m_impl->max_elements_cached, true);
+            std::unique_lock<std::shared_mutex> lock(m_impl->mutex);
+            m_impl->publish(std::move(loaded), nullptr);
+            return true;
+        } catch (const std::exception& e) {
+            std::cerr << "[Librarian] Load failed: " << e.what() << "\n";
+        }
+        return false;
     }
 
     size_t Librarian::count() const {
-        return m_impl->alg_hnsw->cur_element_count;
+        if (m_impl->ivf) {
+            std::shared_lock<std::shared_mutex> lock(m_impl->mutex);
+            return m_impl->ivf->size();
+        }
+        {
+            std::shared_lock<std::shared_mutex> lock(m_impl->mutex);
+            if (m_impl->flat) return m_impl->flat->size();
+        }
+        // Deleted slots stay allocated until addPoint reuses them; report live items only
+        auto g = m_impl->pin();
+        size_t live = live_count(*g->index);
+        if (g->base) live += live_count(*g->base->index);
+        return live;
+    }
+
+    void Librarian::for_each_item(const std::function<void(size_t)>& fn) const {
+        if (m_impl->ivf) {
+            std::shared_lock<std::shared_mutex> lock(m_impl->mutex);
+            m_impl->ivf->for_each_id(fn);
+            return;
+        }
+        {
+            std::shared_lock<std::shared_mutex> lock(m_impl->mutex);
+            if (m_impl->flat) {
+                for (size_t row = 0; row < m_impl->flat->size(); ++row) fn(m_impl->flat->id_at(row));
+                return;
+            }
+        }
+        auto g = m_impl->pin();
+        for (Index* index : {g->index.get(), g->base ? g->base->index.get() : nullptr}) {
+            if (!index) continue;
+            for (size_t i = 0; i < index->getCurrentElementCount(); ++i) {
+                if (!index->isMarkedDeleted(i)) fn(index->getExternalLabel(i));
+            }
+        }
+    }
+
+    size_t Librarian::capacity() const {
+        if (m_impl->ivf) return 0;
+        {
+            std::shared_lock<std::shared_mutex> lock(m_impl->mutex);
+            if (m_impl->flat) return 0;
+        }
+        auto g = m_impl->pin();
+        size_t slots = g->index->getMaxElements();
+        if (g->base) slots += g->base->index->getMaxElements();
+        return slots;
+    }
+
+    double Librarian::utilization() const {
+        size_t slots = capacity();
+        return slots ? static_cast<double>(count()) / slots : 0.0;
+    }
+
+    uint64_t Librarian::changes() const {
+        return m_impl->changes.load();
+    }
+
+    Metric Librarian::metric() const {
+        return m_impl->metric;
+    }
+
+    bool Librarian::is_mapped() const {
+        return m_impl->mapped;
+    }
+
+    std::string Librarian::encoding() const {
+        if (m_impl->ivf) return "ivfpq";
+        {
+            std::shared_lock<std::shared_mutex> lock(m_impl->mutex);
+            if (m_impl->flat) return "flat";
+        }
+        return m_impl->quantizer ? "int8" : "fp32";
+    }
+
+    std::vector<uint8_t> Librarian::export_codebooks() const {
+        std::shared_lock<std::shared_mutex> lock(m_impl->mutex);
+        return m_impl->ivf ? m_impl->ivf->export_codebooks() : std::vector<uint8_t>{};
     }
 
 }
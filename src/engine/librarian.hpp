@@ -4,14 +4,74 @@
 #include <string>
 #include <memory>
 #include <filesystem>
+#include <functional>
+#include <optional>
+#include <unordered_map>
+#include "quantizer.hpp"
+#include "ivfpq_index.hpp"
+#include "flat_index.hpp"
+#include "kestr/types.hpp"
 
 namespace kestr::engine {
 
+    /**
+     * @brief One search result; a higher score is more similar.
+     * Cosine: the cosine similarity. L2: 1 / (1 + squared distance).
+     */
+    struct SearchHit {
+        size_t id;
+        float score;
+    };
+
+    /**
+     * @brief HNSW vector index over chunk embeddings.
+     * In mapped mode the persisted index is served from a memory-mapped file and new
+     * items go to a small in-RAM delta index, which save() merges into the file.
+     * With a ScalarQuantizer the index stores one byte per dimension instead of a float.
+     * The IVF-PQ backend replaces the graph with an IvfPqIndex for very large corpora.
+     * Small indexes can start as an exact FlatIndex scan and switch to the graph once they grow.
+     * With Metric::Cosine vectors are normalized on the way in and compared by inner product.
+     * Thread-safe: any number of searches run lock-free alongside add_item / remove_item.
+     */
     class Librarian {
     public:
-        Librarian(size_t dim, size_t max_elements = 10000);
+        /**
+         * @brief Fetches the original fp32 vectors of the given ids (missing ids are skipped).
+         */
+        using VectorLookup = std::function<std::unordered_map<size_t, std::vector<float>>(const std::vector<size_t>&)>;
+
+        /**
+         * @param max_elements Initial capacity of the in-RAM index (of the delta in mapped mode);
+         *        the index doubles whenever it runs full.
+         * @param mapped Serve load()ed indexes from a file mapping instead of the heap.
+         * @param quantizer Store int8 codes produced by this quantizer instead of fp32 vectors.
+         *        With Metric::Cosine it must have been fitted on normalized vectors.
+         * @param metric Similarity used for ranking and scores.
+         */
+        Librarian(size_t dim, size_t max_elements = 10000, bool mapped = false,
+                  std::optional<ScalarQuantizer> quantizer = std::nullopt, Metric metric = Metric::L2);
+
+        /**
+         * @brief IVF-PQ backend: a few dozen bytes per vector, approximate distances.
+         * The quantizers are trained on a background thread once enough vectors arrived.
+         * Pair it with set_rerank() to restore the exact order of the top results.
+         */
+        Librarian(size_t dim, const IvfPqOptions& options, Metric metric = Metric::L2);
         ~Librarian();
 
+        /**
+         * @brief Serves searches by an exact scan until more than upgrade_at items are stored
+         * (0 = never), then builds the graph this Librarian was constructed for.
+         * The graph is built on a background thread; the scan serves until it is ready.
+         * Call on an empty HNSW Librarian; has no effect otherwise.
+         */
+        void use_exact_search(size_t upgrade_at);
+
+        /**
+         * @brief Blocks until a graph build or IVF-PQ training started by add_item has finished.
+         */
+        void wait_for_background();
+
         /**
          * @brief Adds a vector to the index.
          * @param id The unique ID of the chunk (from database).
@@ -24,30 +84,100 @@ namespace kestr::engine {
          */
         void remove_item(size_t id);
 
+        /**
+         * @brief Records the filterable attributes of an item (symbol_type, language, project_root).
+         * Items without attributes never match a filtered search.
+         */
+        void set_attributes(size_t id, const Chunk& chunk);
+
         /**
          * @brief Searches for the nearest neighbors.
          * @param query_vector The query vector.
          * @param k Number of results to return.
+         * @param filters Only items whose attributes match are considered; applied during the
+         *        graph traversal, so up to k matching items are returned.
+         * @param ef HNSW beam width for this query (0 = default); larger is slower and more accurate.
          * @return List of chunk IDs.
          */
-        std::vector<size_t> search(const std::vector<float>& query_vector, size_t k = 5);
+        std::vector<size_t> search(const std::vector<float>& query_vector, size_t k = 5,
+                                   const SearchFilters& filters = {}, size_t ef = 0);
+
+        /**
+         * @brief Like search(), with the similarity of each result, most similar first.
+         * Scores are exact after a rerank and approximate for quantized indexes otherwise.
+         */
+        std::vector<SearchHit> search_scored(const std::vector<float>& query_vector, size_t k = 5,
+                                             const SearchFilters& filters = {}, size_t ef = 0);
+
+        /**
+         * @brief Enables exact fp32 reranking for a quantized (int8 or IVF-PQ) index.
+         * search() then fetches k * factor candidates and reorders them by their original vectors.
+         */
+        void set_rerank(VectorLookup lookup, size_t factor = 4);
 
         /**
          * @brief Persists the index to disk.
+         * In mapped mode this merges the delta into the written file and then serves that file.
+         * @param encoding Set to the encoding() of the file written, which may change right after.
+         * @return false if the index could not be written.
          */
-        void save(const std::filesystem::path& path);
+        bool save(const std::filesystem::path& path, std::string* encoding = nullptr);
 
         /**
-         * @brief Loads the index from disk.
+         * @brief Loads the index from disk, replacing the current contents.
+         * @return false if the file could not be read; the current index is kept.
          */
-        void load(const std::filesystem::path& path);
+        bool load(const std::filesystem::path& path);
 
         /**
-         * @brief Returns current number of elements.
+         * @brief Returns current number of live (not deleted) elements.
          */
         size_t count() const;
 
+        /**
+         * @brief Allocated element slots; 0 for backends without a fixed capacity (IVF-PQ, flat).
+         */
+        size_t capacity() const;
+
+        /**
+         * @brief count() / capacity(), or 0 without a fixed capacity.
+         */
+        double utilization() const;
+
+        /**
+         * @brief Calls fn with the id of every live item. Run it while no writer is active.
+         */
+        void for_each_item(const std::function<void(size_t id)>& fn) const;
+
+        size_t dimension() const { return m_dim; }
+
+        /**
+         * @brief Number of add/remove calls so far; lets snapshots skip an unchanged index.
+         */
+        uint64_t changes() const;
+
+        Metric metric() const;
+
+        /**
+         * @brief Returns true if the index is served from a memory-mapped file.
+         */
+        bool is_mapped() const;
+
+        /**
+         * @brief Storage format of the vectors in the index: "fp32", "int8", "ivfpq" or "flat".
+         */
+        std::string encoding() const;
+
+        /**
+         * @brief Trained IVF-PQ codebooks; empty for HNSW or while still untrained.
+         */
+        std::vector<uint8_t> export_codebooks() const;
+
     private:
+        bool grow();
+        void upgrade_to_graph();
+        void start_background(std::function<void()> job);
+
         struct Impl;
         std::unique_ptr<Impl> m_impl;
         size_t m_dim;
@@ -0,0 +1,332 @@
+#include "librarian_shards.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <future>
+#include <iostream>
+#include <limits>
+#include <thread>
+
+namespace kestr::engine {
+
+    /**
+     * @brief Fixed set of threads running search fan-out tasks.
+     */
+    class LibrarianShards::Pool {
+    public:
+        explicit Pool(size_t threads) {
+            for (size_t i = 0; i < threads; ++i) m_threads.emplace_back([this] { run(); });
+        }
+
+        ~Pool() {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_cv.notify_all();
+            for (auto& t : m_threads) t.join();
+        }
+
+        void submit(std::function<void()> task) {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_tasks.push_back(std::move(task));
+            }
+            m_cv.notify_one();
+        }
+
+    private:
+        void run() {
+            while (true) {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_cv.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+                    if (m_tasks.empty()) return; // Stopped and drained
+                    task = std::move(m_tasks.front());
+                    m_tasks.pop_front();
+                }
+                task();
+            }
+        }
+
+        std::vector<std::thread> m_threads;
+        std::deque<std::function<void()>> m_tasks;
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        bool m_stop = false;
+    };
+
+    std::string LibrarianShards::slug(const std::string& project_root) {
+        if (project_root.empty()) return "default";
+        uint64_t hash = 14695981039346656037ULL; // FNV-1a
+        for (unsigned char c : project_root) {
+            hash ^= c;
+            hash *= 1099511628211ULL;
+        }
+        static const char* hex = "0123456789abcdef";
+        std::string slug(16, '0');
+        for (int i = 15; i >= 0; --i, hash >>= 4) slug[i] = hex[hash & 0xF];
+        return slug;
+    }
+
+    LibrarianShards::LibrarianShards(Factory factory, std::filesystem::path snapshot_dir, size_t threads)
+        : m_factory(std::move(factory)), m_snapshot_dir(std::move(snapshot_dir)) {
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        m_pool = std::make_unique<Pool>(threads);
+    }
+
+    LibrarianShards::~LibrarianShards() = default;
+
+    uint16_t LibrarianShards::shard_index(const std::string& root) {
+        auto it = m_index.find(root);
+        if (it != m_index.end()) return it->second;
+        if (m_shards.size() >= std::numeric_limits<uint16_t>::max() - 1) return 0; // Out of routes: share the first shard
+
+        std::string name = slug(root);
+        auto shard = std::make_unique<Shard>(Shard{root, nullptr, IndexSnapshot(m_snapshot_dir / ("kestr-" + name + ".hnsw"), "snapshot_" + name)});
+        m_shards.push_back(std::move(shard));
+        uint16_t index = static_cast<uint16_t>(m_shards.size() - 1);
+        m_index.emplace(root, index);
+        return index;
+    }
+
+    Librarian& LibrarianShards::materialize(uint16_t index, size_t expected_items) {
+        auto& shard = *m_shards[index];
+        if (!shard.librarian) shard.librarian = m_factory(shard.root, expected_items);
+        return *shard.librarian;
+    }
+
+    uint16_t LibrarianShards::route(size_t id) const {
+        return id < m_routes.size() ? m_routes[id] : 0;
+    }
+
+    void LibrarianShards::add_shard(const std::string& project_root) {
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        shard_index(project_root);
+    }
+
+    void LibrarianShards::set_attributes(size_t id, const Chunk& chunk) {
+        Librarian* previous = nullptr;
+        Librarian* target;
+        {
+            std::unique_lock<std::shared_mutex> lock(m_mutex);
+            uint16_t index = shard_index(chunk.project_root);
+            uint16_t old = route(id);
+            if (old != 0 && old != index + 1) previous = m_shards[old - 1]->librarian.get();
+            if (id >= m_routes.size()) m_routes.resize(std::max(id + 1, m_routes.size() * 3 / 2), 0);
+            m_routes[id] = index + 1;
+            target = &materialize(index, 0);
+        }
+        // Librarians are never destroyed once created, so they can be used outside the lock
+        if (previous) previous->remove_item(id);
+        target->set_attributes(id, chunk);
+    }
+
+    void LibrarianShards::add_item(size_t id, const std::vector<float>& vector) {
+        Librarian* target = nullptr;
+        {
+            std::shared_lock<std::shared_mutex> lock(m_mutex);
+            uint16_t r = route(id);
+            if (r != 0) target = m_shards[r - 1]->librarian.get();
+        }
+        if (!target) {
+            std::unique_lock<std::shared_mutex> lock(m_mutex);
+            uint16_t r = route(id);
+            target = &materialize(r != 0 ? r - 1 : shard_index(""), 0);
+        }
+        target->add_item(id, vector);
+    }
+
+    void LibrarianShards::remove_item(size_t id) {
+        std::vector<Librarian*> targets;
+        {
+            std::shared_lock<std::shared_mutex> lock(m_mutex);
+            uint16_t r = route(id);
+            if (r != 0) {
+                if (auto* lib = m_shards[r - 1]->librarian.get()) targets.push_back(lib);
+            } else {
+                // Unknown owner: every shard ignores ids it does not have
+                for (const auto& shard : m_shards) {
+                    if (shard->librarian) targets.push_back(shard->librarian.get());
+                }
+            }
+        }
+        for (auto* lib : targets) lib->remove_item(id);
+    }
+
+    std::vector<SearchHit> LibrarianShards::search_scored(const std::vector<float>& query, size_t k,
+                                                          const SearchFilters& filters, size_t ef) {
+        std::vector<Librarian*> targets;
+        {
+            std::shared_lock<std::shared_mutex> lock(m_mutex);
+            if (!filters.scope.empty()) {
+                auto it = m_index.find(filters.scope);
+                if (it != m_index.end() && m_shards[it->second]->librarian) targets.push_back(m_shards[it->second]->librarian.get());
+            } else {
+                for (const auto& shard : m_shards) {
+                    if (shard->librarian) targets.push_back(shard->librarian.get());
+                }
+            }
+        }
+        if (targets.empty()) return {};
+        if (!filters.scope.empty()) {
+            // Everything in the shard belongs to the scope; skip the per-item project check
+            SearchFilters rest = filters;
+            rest.scope.clear();
+            return targets[0]->search_scored(query, k, rest, ef);
+        }
+        if (targets.size() == 1) return targets[0]->search_scored(query, k, filters, ef);
+
+        // Every shard returns its own top-k; the global top-k is among them
+        std::vector<std::vector<SearchHit>> partial(targets.size());
+        std::vector<std::future<void>> pending;
+        std::exception_ptr error;
+        try {
+            for (size_t i = 1; i < targets.size(); ++i) {
+                auto task = std::make_shared<std::packaged_task<void()>>([&, i] {
+                    partial[i] = targets[i]->search_scored(query, k, filters, ef);
+                });
+                pending.push_back(task->get_future());
+                m_pool->submit([task] { (*task)(); });
+            }
+            partial[0] = targets[0]->search_scored(query, k, filters, ef);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        // The tasks write into this frame, so all of them have to finish before an error unwinds it
+        for (auto& f : pending) {
+            try {
+                f.get();
+            } catch (...) {
+                if (!error) error = std::current_exception();
+            }
+        }
+        if (error) std::rethrow_exception(error);
+
+        std::vector<SearchHit> hits;
+        for (auto& p : partial) hits.insert(hits.end(), p.begin(), p.end());
+        size_t n = std::min(k, hits.size());
+        std::partial_sort(hits.begin(), hits.begin() + n, hits.end(), [](const auto& a, const auto& b) { return a.score > b.score; });
+        hits.resize(n);
+        return hits;
+    }
+
+    bool LibrarianShards::restore(Database& db, std::mutex& db_mutex, size_t limit) {
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+
+        // Route every stored chunk first, so each shard can be sized for its share
+        std::vector<std::pair<int64_t, Chunk>> attributes;
+        {
+            std::lock_guard<std::mutex> db_lock(db_mutex);
+            db.for_each_chunk_attributes([&](int64_t id, const Chunk& chunk) {
+                uint16_t index = shard_index(chunk.project_root);
+                if (static_cast<size_t>(id) >= m_routes.size()) m_routes.resize(std::max<size_t>(id + 1, m_routes.size() * 3 / 2), 0);
+                m_routes[id] = index + 1;
+                attributes.emplace_back(id, chunk);
+            });
+        }
+        std::vector<size_t> expected(m_shards.size(), 0);
+        for (uint16_t r : m_routes) {
+            if (r != 0) ++expected[r - 1];
+        }
+        for (uint16_t i = 0; i < m_shards.size(); ++i) materialize(i, expected[i] + expected[i] / 4);
+        for (const auto& [id, chunk] : attributes) m_shards[route(id) - 1]->librarian->set_attributes(id, chunk);
+        attributes.clear();
+
+        std::lock_guard<std::mutex> db_lock(db_mutex);
+        std::vector<bool> rebuild(m_shards.size(), false);
+        bool all_restored = true;
+        for (uint16_t i = 0; i < m_shards.size(); ++i) {
+            auto& shard = *m_shards[i];
+            uint16_t r = i + 1;
+            rebuild[i] = !shard.snapshot.restore(*shard.librarian, db, [&](int64_t id) {
+                return route(id) == r || (route(id) == 0 && shard.root.empty());
+            });
+            all_restored &= !rebuild[i];
+        }
+        if (all_restored) return true;
+
+        size_t loaded = 0;
+        for (const auto& shard : m_shards) loaded += shard->librarian->count();
+        std::cout << "[Librarian] Rebuilding shards without a usable snapshot from the database..." << std::endl;
+        db.for_each_vector([&](int64_t id, const std::vector<float>& vec) {
+            if (limit && loaded >= limit) return;
+            uint16_t r = route(id);
+            if (r == 0 || !rebuild[r - 1]) return; // Every stored vector has a chunk row, so it is routed
+            m_shards[r - 1]->librarian->add_item(id, vec);
+            ++loaded;
+        });
+        return false;
+    }
+
+    bool LibrarianShards::checkpoint(Database& db, std::mutex& db_mutex) {
+        std::vector<Shard*> shards;
+        {
+            std::shared_lock<std::shared_mutex> lock(m_mutex);
+            for (const auto& shard : m_shards) {
+                if (shard->librarian) shards.push_back(shard.get());
+            }
+        }
+
+        bool ok = true;
+        int64_t oldest = std::numeric_limits<int64_t>::max();
+        for (auto* shard : shards) {
+            ok &= shard->snapshot.checkpoint(*shard->librarian, db, db_mutex, false);
+            oldest = std::min(oldest, shard->snapshot.saved_generation());
+        }
+        // Tombstones are shared; keep every one a shard snapshot may still have to replay
+        if (!shards.empty() && oldest > 0) {
+            std::lock_guard<std::mutex> lock(db_mutex);
+            db.prune_tombstones(oldest);
+        }
+        return ok;
+    }
+
+    void LibrarianShards::discard(Database& db) {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        for (const auto& shard : m_shards) shard->snapshot.discard(db);
+
+        // Shards not declared yet have snapshot files too; without them nothing stale can be restored
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(m_snapshot_dir, ec)) {
+            auto name = entry.path().filename().string();
+            if (name.rfind("kestr-", 0) == 0 && entry.path().extension() == ".hnsw") std::filesystem::remove(entry.path(), ec);
+        }
+    }
+
+    size_t LibrarianShards::count() const {
+        size_t total = 0;
+        for_each_shard([&](const std::string&, Librarian& lib) { total += lib.count(); });
+        return total;
+    }
+
+    size_t LibrarianShards::capacity() const {
+        size_t total = 0;
+        for_each_shard([&](const std::string&, Librarian& lib) { total += lib.capacity(); });
+        return total;
+    }
+
+    double LibrarianShards::utilization() const {
+        size_t slots = capacity();
+        return slots ? static_cast<double>(count()) / slots : 0.0;
+    }
+
+    size_t LibrarianShards::shard_count() const {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        return m_shards.size();
+    }
+
+    void LibrarianShards::for_each_shard(const std::function<void(const std::string&, Librarian&)>& fn) const {
+        std::vector<std::pair<std::string, Librarian*>> shards;
+        {
+            std::shared_lock<std::shared_mutex> lock(m_mutex);
+            for (const auto& shard : m_shards) {
+                if (shard->librarian) shards.emplace_back(shard->root, shard->librarian.get());
+            }
+        }
+        for (auto& [root, lib] : shards) fn(root, *lib);
+    }
+
+}
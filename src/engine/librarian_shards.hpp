@@ -0,0 +1,116 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <functional>
+#include <filesystem>
+#include <unordered_map>
+#include "librarian.hpp"
+#include "index_snapshot.hpp"
+#include "database.hpp"
+
+namespace kestr::engine {
+
+    /**
+     * @brief One Librarian per project root, each with its own capacity and snapshot.
+     * Items are routed by the project_root passed to set_attributes(), so a reindex of one
+     * project only touches its own graph. Scoped searches go to a single shard; unscoped
+     * ones fan out over a thread pool and merge the per-shard top-k by score.
+     */
+    class LibrarianShards {
+    public:
+        /**
+         * @brief Creates the Librarian of a shard, sized for about expected_items vectors.
+         * Called with the shard list locked but never with the database lock held.
+         */
+        using Factory = std::function<std::unique_ptr<Librarian>(const std::string& project_root, size_t expected_items)>;
+
+        /**
+         * @param snapshot_dir Directory for the per-shard snapshot files.
+         * @param threads Search fan-out threads (0 = one per core).
+         */
+        LibrarianShards(Factory factory, std::filesystem::path snapshot_dir, size_t threads = 0);
+        ~LibrarianShards();
+
+        /**
+         * @brief Stable name of a project root (FNV-1a), used for its snapshot file and meta keys.
+         */
+        static std::string slug(const std::string& project_root);
+
+        /**
+         * @brief Declares a shard up front (e.g. for every watch path); others appear on first use.
+         */
+        void add_shard(const std::string& project_root);
+
+        /**
+         * @brief Routes the item to the shard of chunk.project_root and records its filter attributes.
+         * Call before add_item(); unrouted items go to the shard of the empty project root.
+         */
+        void set_attributes(size_t id, const Chunk& chunk);
+
+        void add_item(size_t id, const std::vector<float>& vector);
+        void remove_item(size_t id);
+
+        /**
+         * @brief Searches the shard of filters.scope, or all shards when unscoped.
+         * @return Up to k hits, most similar first.
+         */
+        std::vector<SearchHit> search_scored(const std::vector<float>& query, size_t k = 5,
+                                             const SearchFilters& filters = {}, size_t ef = 0);
+
+        /**
+         * @brief Routes every stored chunk, restores each shard from its snapshot and rebuilds
+         * the others from the database. Takes db_mutex itself; the factory runs without it.
+         * @param limit Stop adding rebuilt vectors once this many items are loaded (0 = no limit).
+         * @return true if every shard came from a snapshot.
+         */
+        bool restore(Database& db, std::mutex& db_mutex, size_t limit = 0);
+
+        /**
+         * @brief Snapshots every shard that changed since its last snapshot.
+         */
+        bool checkpoint(Database& db, std::mutex& db_mutex);
+
+        /**
+         * @brief Deletes all shard snapshots.
+         */
+        void discard(Database& db);
+
+        size_t count() const;
+        size_t capacity() const;
+        double utilization() const;
+        size_t shard_count() const;
+
+        /**
+         * @brief Calls fn for every shard that has a Librarian.
+         */
+        void for_each_shard(const std::function<void(const std::string& project_root, Librarian& librarian)>& fn) const;
+
+    private:
+        struct Shard {
+            std::string root;
+            std::unique_ptr<Librarian> librarian; // Created on first use
+            IndexSnapshot snapshot;
+        };
+        class Pool;
+
+        // The caller holds m_mutex (exclusive for the mutating ones)
+        uint16_t shard_index(const std::string& root);
+        Librarian& materialize(uint16_t index, size_t expected_items);
+        uint16_t route(size_t id) const;
+
+        Factory m_factory;
+        std::filesystem::path m_snapshot_dir;
+        std::unique_ptr<Pool> m_pool;
+
+        // Guards the shard list and routes; shards are only ever added.
+        mutable std::shared_mutex m_mutex;
+        std::vector<std::unique_ptr<Shard>> m_shards;
+        std::unordered_map<std::string, uint16_t> m_index;
+        std::vector<uint16_t> m_routes; // Chunk id -> shard index + 1 (0 = unrouted)
+    };
+
+}
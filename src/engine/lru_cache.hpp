@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+#include <list>
+#include <utility>
+#include <unordered_map>
+
+namespace kestr::engine {
+
+    /**
+     * @brief Fixed-capacity map that evicts the least recently used entry. Not thread-safe.
+     */
+    template <typename V>
+    class LruCache {
+    public:
+        explicit LruCache(size_t capacity) : m_capacity(capacity) {}
+
+        bool get(const std::string& key, V& out) {
+            auto it = m_index.find(key);
+            if (it == m_index.end()) return false;
+            m_lru.splice(m_lru.begin(), m_lru, it->second);
+            out = it->second->second;
+            return true;
+        }
+
+        void put(const std::string& key, V value) {
+            if (m_capacity == 0) return;
+            auto it = m_index.find(key);
+            if (it != m_index.end()) {
+                it->second->second = std::move(value);
+                m_lru.splice(m_lru.begin(), m_lru, it->second);
+                return;
+            }
+            m_lru.emplace_front(key, std::move(value));
+            m_index.emplace(key, m_lru.begin());
+            if (m_lru.size() > m_capacity) {
+                m_index.erase(m_lru.back().first);
+                m_lru.pop_back();
+            }
+        }
+
+        void erase(const std::string& key) {
+            auto it = m_index.find(key);
+            if (it == m_index.end()) return;
+            m_lru.erase(it->second);
+            m_index.erase(it);
+        }
+
+        size_t size() const { return m_lru.size(); }
+
+    private:
+        using Entry = std::pair<std::string, V>;
+
+        size_t m_capacity;
+        std::list<Entry> m_lru; // Most recently used first
+        std::unordered_map<std::string, typename std::list<Entry>::iterator> m_index;
+    };
+
+}
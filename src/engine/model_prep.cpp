@@ -0,0 +1,129 @@
+#include "model_prep.hpp"
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <cerrno>
+#include <algorithm>
+
+#ifdef KESTR_PLATFORM_WINDOWS
+#include <process.h>
+#else
+#include <spawn.h>
+#include <sys/wait.h>
+extern char** environ;
+#endif
+
+namespace kestr::engine {
+
+    namespace {
+
+        double seconds_since(std::chrono::steady_clock::time_point start) {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        double cosine(const std::vector<float>& a, const std::vector<float>& b) {
+            double dot = 0.0, na = 0.0, nb = 0.0;
+            for (size_t i = 0; i < a.size(); ++i) {
+                dot += static_cast<double>(a[i]) * b[i];
+                na += static_cast<double>(a[i]) * a[i];
+                nb += static_cast<double>(b[i]) * b[i];
+            }
+            if (na == 0.0 || nb == 0.0) return 0.0;
+            return dot / (std::sqrt(na) * std::sqrt(nb));
+        }
+
+#ifdef KESTR_PLATFORM_WINDOWS
+        // _spawnvp joins argv with spaces; quote each argument the way the C runtime splits it again
+        std::string quote_windows(const std::string& arg) {
+            std::string out = "\"";
+            size_t backslashes = 0;
+            for (char c : arg) {
+                if (c == '\\') {
+                    ++backslashes;
+                    continue;
+                }
+                // Backslashes are literal unless they precede a quote
+                out.append(c == '"' ? backslashes * 2 + 1 : backslashes, '\\');
+                backslashes = 0;
+                out += c;
+            }
+            out.append(backslashes * 2, '\\');
+            return out + "\"";
+        }
+#endif
+
+        // Runs a program with exactly these arguments, no shell in between; true if it exited with 0
+        bool run_process(const std::vector<std::string>& args) {
+#ifdef KESTR_PLATFORM_WINDOWS
+            std::vector<std::string> quoted;
+            for (const auto& arg : args) quoted.push_back(quote_windows(arg));
+            std::vector<const char*> argv;
+            for (const auto& arg : quoted) argv.push_back(arg.c_str());
+            argv.push_back(nullptr);
+            return _spawnvp(_P_WAIT, args[0].c_str(), argv.data()) == 0;
+#else
+            std::vector<char*> argv;
+            for (const auto& arg : args) argv.push_back(const_cast<char*>(arg.c_str()));
+            argv.push_back(nullptr);
+            pid_t pid;
+            if (posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ) != 0) return false;
+            int status = 0;
+            while (waitpid(pid, &status, 0) < 0) {
+                if (errno != EINTR) return false;
+            }
+            return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#endif
+        }
+
+    }
+
+    ReferenceVectors embed_reference(Embedder& reference, const std::vector<std::string>& texts) {
+        ReferenceVectors result;
+        auto start = std::chrono::steady_clock::now();
+        result.vectors = reference.embed_batch(texts);
+        result.seconds = seconds_since(start);
+        return result;
+    }
+
+    DriftReport measure_drift(Embedder& reference, Embedder& candidate, const std::vector<std::string>& texts) {
+        return measure_drift(embed_reference(reference, texts), candidate, texts);
+    }
+
+    DriftReport measure_drift(const ReferenceVectors& reference, Embedder& candidate, const std::vector<std::string>& texts) {
+        DriftReport report;
+        const auto& expected = reference.vectors;
+        report.reference_seconds = reference.seconds;
+
+        auto start = std::chrono::steady_clock::now();
+        auto actual = candidate.embed_batch(texts);
+        report.candidate_seconds = seconds_since(start);
+
+        double total = 0.0;
+        for (size_t i = 0; i < texts.size(); ++i) {
+            if (i >= expected.size() || i >= actual.size() || expected[i].empty() || expected[i].size() != actual[i].size()) {
+                ++report.failures;
+                continue;
+            }
+            double drift = 1.0 - cosine(expected[i], actual[i]);
+            total += drift;
+            report.max_drift = std::max(report.max_drift, drift);
+            ++report.samples;
+        }
+        if (report.samples > 0) report.mean_drift = total / report.samples;
+        return report;
+    }
+
+    bool quantize_model(const std::filesystem::path& input, const std::filesystem::path& output, const std::string& python) {
+        // Paths are passed as arguments, never through a shell, so any character in them is safe
+        const std::string script = "import sys; "
+                                   "from onnxruntime.quantization import quantize_dynamic, QuantType; "
+                                   "quantize_dynamic(sys.argv[1], sys.argv[2], weight_type=QuantType.QInt8)";
+        if (!run_process({python, "-c", script, input.string(), output.string()})) {
+            std::cerr << "[ModelPrep] Quantization failed. It needs ONNX Runtime for Python: "
+                      << python << " -m pip install onnxruntime onnx\n";
+            return false;
+        }
+        return std::filesystem::exists(output);
+    }
+
+}
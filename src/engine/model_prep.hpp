@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <filesystem>
+#include "embedder.hpp"
+
+namespace kestr::engine {
+
+    /**
+     * @brief How far a candidate model's vectors are from the reference model's.
+     * Drift is 1 - cosine similarity between the two embeddings of the same text.
+     */
+    struct DriftReport {
+        size_t samples = 0;        // Texts both models embedded
+        size_t failures = 0;       // Texts either model returned no vector for
+        double mean_drift = 0.0;
+        double max_drift = 0.0;
+        double reference_seconds = 0.0;
+        double candidate_seconds = 0.0;
+    };
+
+    /**
+     * @brief Vectors of the reference model, kept so the model can be unloaded before the candidate loads.
+     */
+    struct ReferenceVectors {
+        std::vector<std::vector<float>> vectors;
+        double seconds = 0.0;
+    };
+
+    ReferenceVectors embed_reference(Embedder& reference, const std::vector<std::string>& texts);
+
+    /**
+     * @brief Embeds texts with the candidate model and compares the vectors pairwise.
+     */
+    DriftReport measure_drift(const ReferenceVectors& reference, Embedder& candidate, const std::vector<std::string>& texts);
+
+    /**
+     * @brief Embeds texts with both models and compares the vectors pairwise.
+     */
+    DriftReport measure_drift(Embedder& reference, Embedder& candidate, const std::vector<std::string>& texts);
+
+    /**
+     * @brief Writes a dynamically INT8-quantized copy of an ONNX model.
+     * ONNX Runtime ships its quantizer only in the Python package, so this runs
+     * onnxruntime.quantization.quantize_dynamic through the given interpreter.
+     * @return true if the quantizer succeeded and output exists.
+     */
+    bool quantize_model(const std::filesystem::path& input, const std::filesystem::path& output, const std::string& python = "python3");
+
+}
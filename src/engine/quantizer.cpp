@@ -0,0 +1,156 @@
+#include "quantizer.hpp"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cmath>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define KESTR_QUANTIZER_AVX2 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define KESTR_QUANTIZER_NEON 1
+#endif
+
+namespace kestr::engine {
+
+    namespace {
+
+        uint32_t distance_scalar(const uint8_t* a, const uint8_t* b, size_t dim) {
+            uint32_t sum = 0;
+            for (size_t i = 0; i < dim; ++i) {
+                int d = static_cast<int>(a[i]) - static_cast<int>(b[i]);
+                sum += static_cast<uint32_t>(d * d);
+            }
+            return sum;
+        }
+
+#if defined(KESTR_QUANTIZER_AVX2)
+        __attribute__((target("avx2")))
+        uint32_t distance_avx2(const uint8_t* a, const uint8_t* b, size_t dim) {
+            __m256i acc = _mm256_setzero_si256();
+            size_t i = 0;
+            for (; i + 16 <= dim; i += 16) {
+                // Widen 16 codes to int16, subtract, and let madd square and pair-sum into int32
+                __m256i va = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+                __m256i vb = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+                __m256i d = _mm256_sub_epi16(va, vb);
+                acc = _mm256_add_epi32(acc, _mm256_madd_epi16(d, d));
+            }
+            __m128i s = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+            s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+            s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+            return static_cast<uint32_t>(_mm_cvtsi128_si32(s)) + distance_scalar(a + i, b + i, dim - i);
+        }
+#elif defined(KESTR_QUANTIZER_NEON)
+        uint32_t distance_neon(const uint8_t* a, const uint8_t* b, size_t dim) {
+            uint32x4_t acc = vdupq_n_u32(0);
+            size_t i = 0;
+            for (; i + 16 <= dim; i += 16) {
+                uint8x16_t d = vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i));
+                acc = vpadalq_u16(acc, vmull_u8(vget_low_u8(d), vget_low_u8(d)));
+                acc = vpadalq_u16(acc, vmull_u8(vget_high_u8(d), vget_high_u8(d)));
+            }
+            return vaddvq_u32(acc) + distance_scalar(a + i, b + i, dim - i);
+        }
+#endif
+
+        using DistanceFn = uint32_t (*)(const uint8_t*, const uint8_t*, size_t);
+
+        DistanceFn pick_distance() {
+#if defined(KESTR_QUANTIZER_AVX2)
+            if (__builtin_cpu_supports("avx2")) return distance_avx2;
+#elif defined(KESTR_QUANTIZER_NEON)
+            return distance_neon;
+#endif
+            return distance_scalar;
+        }
+
+    }
+
+    ScalarQuantizer::ScalarQuantizer(std::vector<float> offset, std::vector<float> scale)
+        : m_offset(std::move(offset)), m_scale(std::move(scale)) {
+        m_scale.resize(m_offset.size(), 1.0f);
+    }
+
+    ScalarQuantizer ScalarQuantizer::fit(const std::vector<std::vector<float>>& samples, float clip) {
+        if (samples.empty()) return {};
+        size_t dim = samples[0].size();
+        std::vector<float> offset(dim), scale(dim);
+
+        std::vector<float> column;
+        column.reserve(samples.size());
+        size_t cut = static_cast<size_t>(clip * samples.size());
+        for (size_t d = 0; d < dim; ++d) {
+            column.clear();
+            for (const auto& s : samples) {
+                if (s.size() == dim) column.push_back(s[d]);
+            }
+            if (column.empty()) {
+                offset[d] = -1.0f;
+                scale[d] = 2.0f / 255.0f;
+                continue;
+            }
+            size_t lo_idx = std::min(cut, column.size() - 1);
+            size_t hi_idx = column.size() - 1 - lo_idx;
+            std::nth_element(column.begin(), column.begin() + lo_idx, column.end());
+            float lo = column[lo_idx];
+            std::nth_element(column.begin(), column.begin() + hi_idx, column.end());
+            float hi = column[hi_idx];
+
+            offset[d] = lo;
+            scale[d] = (hi > lo) ? (hi - lo) / 255.0f : 1e-6f;
+        }
+        return ScalarQuantizer(std::move(offset), std::move(scale));
+    }
+
+    ScalarQuantizer ScalarQuantizer::uniform(size_t dim, float min, float max) {
+        return ScalarQuantizer(std::vector<float>(dim, min), std::vector<float>(dim, (max - min) / 255.0f));
+    }
+
+    void ScalarQuantizer::encode(const float* vector, uint8_t* codes) const {
+        for (size_t d = 0; d < m_offset.size(); ++d) {
+            float q = std::round((vector[d] - m_offset[d]) / m_scale[d]);
+            codes[d] = static_cast<uint8_t>(std::clamp(q, 0.0f, 255.0f));
+        }
+    }
+
+    std::vector<uint8_t> ScalarQuantizer::encode(const std::vector<float>& vector) const {
+        std::vector<uint8_t> codes(m_offset.size());
+        if (vector.size() == m_offset.size()) encode(vector.data(), codes.data());
+        return codes;
+    }
+
+    std::vector<float> ScalarQuantizer::decode(const uint8_t* codes) const {
+        std::vector<float> vector(m_offset.size());
+        for (size_t d = 0; d < m_offset.size(); ++d) {
+            vector[d] = m_offset[d] + codes[d] * m_scale[d];
+        }
+        return vector;
+    }
+
+    uint32_t ScalarQuantizer::distance(const uint8_t* a, const uint8_t* b, size_t dim) {
+        static const DistanceFn fn = pick_distance();
+        return fn(a, b, dim);
+    }
+
+    std::string ScalarQuantizer::serialize() const {
+        nlohmann::json j;
+        j["offset"] = m_offset;
+        j["scale"] = m_scale;
+        return j.dump();
+    }
+
+    std::optional<ScalarQuantizer> ScalarQuantizer::deserialize(const std::string& data) {
+        if (data.empty()) return std::nullopt;
+        try {
+            auto j = nlohmann::json::parse(data);
+            auto offset = j.at("offset").get<std::vector<float>>();
+            auto scale = j.at("scale").get<std::vector<float>>();
+            if (offset.empty() || offset.size() != scale.size()) return std::nullopt;
+            return ScalarQuantizer(std::move(offset), std::move(scale));
+        } catch (...) {
+            return std::nullopt;
+        }
+    }
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <optional>
+
+namespace kestr::engine {
+
+    /**
+     * @brief Per-dimension scalar quantizer mapping fp32 vectors to uint8 codes.
+     * Each dimension is mapped linearly from [offset, offset + 255 * scale] onto 0..255,
+     * so codes compare in a per-dimension normalized space. Distances between codes
+     * are squared L2 computed with integer arithmetic.
+     */
+    class ScalarQuantizer {
+    public:
+        ScalarQuantizer() = default;
+        ScalarQuantizer(std::vector<float> offset, std::vector<float> scale);
+
+        /**
+         * @brief Fits offset and scale from sample vectors.
+         * @param clip Fraction of outliers ignored at each end of every dimension.
+         */
+        static ScalarQuantizer fit(const std::vector<std::vector<float>>& samples, float clip = 0.001f);
+
+        /**
+         * @brief Same range for every dimension, used until there is data to fit on.
+         */
+        static ScalarQuantizer uniform(size_t dim, float min, float max);
+
+        size_t dimension() const { return m_offset.size(); }
+
+        void encode(const float* vector, uint8_t* codes) const;
+        std::vector<uint8_t> encode(const std::vector<float>& vector) const;
+        std::vector<float> decode(const uint8_t* codes) const;
+
+        /**
+         * @brief Squared L2 distance between two code vectors (AVX2 / NEON when available).
+         */
+        static uint32_t distance(const uint8_t* a, const uint8_t* b, size_t dim);
+
+        std::string serialize() const;
+        static std::optional<ScalarQuantizer> deserialize(const std::string& data);
+
+    private:
+        std::vector<float> m_offset;
+        std::vector<float> m_scale;
+    };
+
+}
@@ -0,0 +1,69 @@
+#include "query_cache.hpp"
+
+namespace kestr::engine {
+
+    QueryCache::QueryCache(size_t embedding_capacity, size_t result_capacity)
+        : m_embeddings(embedding_capacity), m_results(result_capacity) {}
+
+    std::string QueryCache::normalize(const std::string& query) {
+        std::string out;
+        out.reserve(query.size());
+        bool space = false;
+        for (char c : query) {
+            if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+                space = !out.empty();
+                continue;
+            }
+            if (space) out += ' ';
+            space = false;
+            out += c;
+        }
+        return out;
+    }
+
+    std::string QueryCache::result_key(const std::string& query, int limit, const SearchFilters& filters) {
+        // '\0' cannot appear in the JSON-decoded parts, so the fields cannot run into each other
+        std::string key = normalize(query);
+        for (const std::string* part : {&filters.type_filter, &filters.language, &filters.scope}) {
+            key += '\0';
+            key += *part;
+        }
+        key += '\0';
+        key += std::to_string(limit);
+        return key;
+    }
+
+    bool QueryCache::get_embedding(const std::string& query, std::vector<float>& out) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_embeddings.get(normalize(query), out)) return false;
+        ++m_embedding_hits;
+        return true;
+    }
+
+    void QueryCache::put_embedding(const std::string& query, std::vector<float> embedding) {
+        if (embedding.empty()) return;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_embeddings.put(normalize(query), std::move(embedding));
+    }
+
+    bool QueryCache::get_result(const std::string& key, uint64_t generation, Result& out) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Tagged tagged;
+        bool found = m_results.get(key, tagged);
+        if (found && tagged.generation == generation) {
+            out = std::move(tagged.result);
+            ++m_result_hits;
+            return true;
+        }
+        if (found) m_results.erase(key); // Computed before the last commit
+        ++m_misses;
+        return false;
+    }
+
+    void QueryCache::put_result(const std::string& key, uint64_t generation, Result result) {
+        if (generation != m_generation.load()) return; // Already stale
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_results.put(key, {generation, std::move(result)});
+    }
+
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include "kestr/types.hpp"
+#include "lru_cache.hpp"
+
+namespace kestr::engine {
+
+    /**
+     * @brief Caches for the query path: query text -> embedding, and
+     * (query, limit, filters) -> fused result IDs.
+     * Embeddings depend only on the text and stay valid. Results are tagged with the
+     * index generation they were computed at and ignored once it moved on. Callers
+     * read generation() before they search, and the indexer calls advance_generation()
+     * after every commit, once both the database and the vector index have it.
+     * Thread-safe.
+     */
+    class QueryCache {
+    public:
+        struct Result {
+            std::vector<int64_t> ids;
+            std::string type; // "hybrid" or "keyword"
+        };
+
+        QueryCache(size_t embedding_capacity, size_t result_capacity);
+
+        /**
+         * @brief Whitespace-trimmed and -collapsed query; tokenizers and FTS see no difference.
+         */
+        static std::string normalize(const std::string& query);
+
+        static std::string result_key(const std::string& query, int limit, const SearchFilters& filters);
+
+        bool get_embedding(const std::string& query, std::vector<float>& out);
+        void put_embedding(const std::string& query, std::vector<float> embedding);
+
+        bool get_result(const std::string& key, uint64_t generation, Result& out);
+        void put_result(const std::string& key, uint64_t generation, Result result);
+
+        uint64_t generation() const { return m_generation.load(); }
+        void advance_generation() { ++m_generation; }
+
+        size_t embedding_hits() const { return m_embedding_hits.load(); }
+        size_t result_hits() const { return m_result_hits.load(); }
+        size_t misses() const { return m_misses.load(); }
+
+    private:
+        struct Tagged {
+            uint64_t generation = 0;
+            Result result;
+        };
+
+        std::mutex m_mutex;
+        LruCache<std::vector<float>> m_embeddings;
+        LruCache<Tagged> m_results;
+        std::atomic<uint64_t> m_generation{0};
+
+        std::atomic<size_t> m_embedding_hits{0};
+        std::atomic<size_t> m_result_hits{0};
+        std::atomic<size_t> m_misses{0};
+    };
+
+}
@@ -0,0 +1,238 @@
+#include "tiered_memory.hpp"
+#include "vector_kernels.hpp"
+#include <algorithm>
+#include <cmath>
+#include <queue>
+
+namespace kestr::engine {
+
+    namespace {
+        // Cold items brought into RAM per rebalance, so one burst of queries cannot stall the writer
+        constexpr size_t kMaxPromotions = 1024;
+        // Rows scanned per hold of the database mutex, so the writer can commit between batches
+        constexpr size_t kColdScanBatch = 4096;
+    }
+
+    TieredMemory::TieredMemory(LibrarianShards& hot, Database& db, std::mutex& db_mutex, Metric metric, size_t budget)
+        : m_hot(hot), m_db(db), m_db_mutex(db_mutex), m_metric(metric), m_budget(std::max<size_t>(budget, 1)),
+          m_protected_limit(m_budget * 4 / 5), m_resident(std::make_shared<const std::vector<uint8_t>>()) {}
+
+    void TieredMemory::seed() {
+        // Chunks without a vector are in neither tier; counting them would force a cold scan per query
+        std::vector<int64_t> embedded;
+        {
+            std::lock_guard<std::mutex> lock(m_db_mutex);
+            m_db.for_each_embedded_id([&](int64_t id) { embedded.push_back(id); });
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_hot.for_each_shard([&](const std::string&, Librarian& lib) {
+            lib.for_each_item([&](size_t id) { touch(id); });
+        });
+        for (int64_t id : embedded) {
+            if (!m_entries.count(static_cast<size_t>(id))) mark_cold(static_cast<size_t>(id));
+        }
+        publish_resident();
+    }
+
+    void TieredMemory::record_insert(size_t id) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        clear_cold(id); // A cold chunk that got a new vector comes back hot
+        touch(id);
+    }
+
+    void TieredMemory::record_remove(size_t id) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // Ids that never had a vector are in neither tier and change nothing
+        if (!forget(id)) clear_cold(id);
+    }
+
+    void TieredMemory::mark_cold(size_t id) {
+        if (id >= m_cold_ids.size()) m_cold_ids.resize(std::max(id + 1, m_cold_ids.size() * 3 / 2));
+        if (m_cold_ids[id]) return;
+        m_cold_ids[id] = true;
+        ++m_cold;
+    }
+
+    bool TieredMemory::clear_cold(size_t id) {
+        if (id >= m_cold_ids.size() || !m_cold_ids[id]) return false;
+        m_cold_ids[id] = false;
+        --m_cold;
+        return true;
+    }
+
+    size_t TieredMemory::hot_count() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_entries.size();
+    }
+
+    void TieredMemory::touch(size_t id) {
+        auto it = m_entries.find(id);
+        if (it == m_entries.end()) {
+            m_probation.push_front(id);
+            m_entries.emplace(id, Entry{m_probation.begin(), false});
+            return;
+        }
+        auto& entry = it->second;
+        if (entry.is_protected) {
+            m_protected.splice(m_protected.begin(), m_protected, entry.pos);
+            return;
+        }
+        // Second access: the item has proven itself
+        m_protected.splice(m_protected.begin(), m_probation, entry.pos);
+        entry.is_protected = true;
+        if (m_protected.size() > m_protected_limit) {
+            size_t demoted = m_protected.back();
+            auto& d = m_entries[demoted];
+            m_probation.splice(m_probation.begin(), m_protected, d.pos);
+            d.is_protected = false;
+        }
+    }
+
+    bool TieredMemory::forget(size_t id) {
+        auto it = m_entries.find(id);
+        if (it == m_entries.end()) return false;
+        (it->second.is_protected ? m_protected : m_probation).erase(it->second.pos);
+        m_entries.erase(it);
+        return true;
+    }
+
+    bool TieredMemory::pop_victim(size_t& id) {
+        auto& segment = m_probation.empty() ? m_protected : m_probation;
+        if (segment.empty()) return false;
+        id = segment.back();
+        segment.pop_back();
+        m_entries.erase(id);
+        return true;
+    }
+
+    void TieredMemory::publish_resident() {
+        size_t size = 0;
+        for (const auto& [id, entry] : m_entries) size = std::max(size, id + 1);
+        auto resident = std::make_shared<std::vector<uint8_t>>(size, 0);
+        for (const auto& [id, entry] : m_entries) (*resident)[id] = 1;
+        std::atomic_store(&m_resident, std::shared_ptr<const std::vector<uint8_t>>(std::move(resident)));
+    }
+
+    std::vector<SearchHit> TieredMemory::search(const std::vector<float>& query, size_t k, const SearchFilters& filters, size_t ef) {
+        auto hits = m_hot.search_scored(query, k, filters, ef);
+        std::vector<SearchHit> cold;
+        if (m_cold.load() > 0) {
+            std::unordered_set<size_t> seen;
+            for (const auto& hit : hits) seen.insert(hit.id);
+            cold = scan_cold(query, k, filters, *std::atomic_load(&m_resident), seen);
+        }
+
+        std::unordered_set<size_t> from_cold;
+        if (!cold.empty()) {
+            for (const auto& hit : cold) from_cold.insert(hit.id);
+            hits.insert(hits.end(), cold.begin(), cold.end());
+            std::stable_sort(hits.begin(), hits.end(), [](const auto& a, const auto& b) { return a.score > b.score; });
+            if (hits.size() > k) hits.resize(k);
+        }
+
+        // Only results that made the cut count as accesses
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& hit : hits) {
+            if (from_cold.count(hit.id)) m_promote.push_back(hit.id);
+            else if (m_entries.count(hit.id)) touch(hit.id);
+        }
+        return hits;
+    }
+
+    std::vector<SearchHit> TieredMemory::scan_cold(const std::vector<float>& input, size_t k, const SearchFilters& filters,
+                                                   const std::vector<uint8_t>& resident, const std::unordered_set<size_t>& skip) {
+        // Same similarities as the Librarian reports, so both tiers merge on one scale
+        std::vector<float> query = input;
+        if (m_metric == Metric::Cosine) {
+            float norm = std::sqrt(kernels::dot(query.data(), query.data(), query.size()));
+            if (norm > 0.0f) for (float& x : query) x /= norm;
+        }
+
+        // Min-heap on score keeps the k best seen so far
+        auto worse = [](const SearchHit& a, const SearchHit& b) { return a.score > b.score; };
+        std::priority_queue<SearchHit, std::vector<SearchHit>, decltype(worse)> best(worse);
+        auto visit = [&](int64_t id, const float* vector, size_t dim) {
+            size_t key = static_cast<size_t>(id);
+            if (dim != query.size() || (key < resident.size() && resident[key]) || skip.count(key)) return;
+            float score;
+            if (m_metric == Metric::Cosine) {
+                float norm = kernels::dot(vector, vector, dim);
+                score = norm > 0.0f ? kernels::dot(query.data(), vector, dim) / std::sqrt(norm) : 0.0f;
+            } else {
+                score = 1.0f / (1.0f + kernels::l2_squared(query.data(), vector, dim));
+            }
+            if (best.size() < k) best.push({key, score});
+            else if (score > best.top().score) {
+                best.pop();
+                best.push({key, score});
+            }
+        };
+
+        // Paged by id; rows committed between two batches may or may not be seen, as with any query
+        int64_t after = 0;
+        for (;;) {
+            size_t visited;
+            {
+                std::lock_guard<std::mutex> lock(m_db_mutex);
+                visited = m_db.for_each_embedding(filters, [&](int64_t id, const float* vector, size_t dim) {
+                    after = id;
+                    visit(id, vector, dim);
+                }, after, kColdScanBatch);
+            }
+            if (visited < kColdScanBatch) break;
+        }
+
+        std::vector<SearchHit> hits;
+        hits.reserve(best.size());
+        while (!best.empty()) {
+            hits.push_back(best.top());
+            best.pop();
+        }
+        std::reverse(hits.begin(), hits.end());
+        return hits;
+    }
+
+    size_t TieredMemory::rebalance() {
+        std::vector<int64_t> promote;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            std::unordered_set<size_t> unique;
+            for (size_t id : m_promote) {
+                if (promote.size() >= kMaxPromotions) break;
+                if (!m_entries.count(id) && unique.insert(id).second) promote.push_back(static_cast<int64_t>(id));
+            }
+            m_promote.clear();
+        }
+
+        size_t moved = 0;
+        if (!promote.empty()) {
+            std::unordered_map<int64_t, std::vector<float>> vectors;
+            {
+                std::lock_guard<std::mutex> lock(m_db_mutex);
+                vectors = m_db.get_embeddings(promote);
+            }
+            for (auto& [id, vec] : vectors) {
+                m_hot.add_item(static_cast<size_t>(id), vec);
+                std::lock_guard<std::mutex> lock(m_mutex);
+                clear_cold(static_cast<size_t>(id));
+                touch(static_cast<size_t>(id));
+                ++moved;
+            }
+        }
+
+        std::vector<size_t> evicted;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            size_t id;
+            while (m_entries.size() > m_budget && pop_victim(id)) {
+                evicted.push_back(id);
+                mark_cold(id);
+            }
+            // Scans must cover the evicted items before the hot tier drops them
+            if (moved || !evicted.empty()) publish_resident();
+        }
+        for (size_t id : evicted) m_hot.remove_item(id);
+        return moved + evicted.size();
+    }
+
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include <unordered_set>
+#include "librarian_shards.hpp"
+#include "database.hpp"
+
+namespace kestr::engine {
+
+    /**
+     * @brief Two-tier vector memory for MemoryMode::HYBRID.
+     * The hot tier is the in-RAM HNSW shards, holding at most `budget` items chosen by a
+     * segmented LRU: recent edits and query hits enter a probationary segment, items hit
+     * again move to a protected one, and eviction takes the least recently used
+     * probationary item first. Everything else stays cold in SQLite and is searched by an
+     * exhaustive SIMD scan. Cold hits are promoted and the budget is enforced by
+     * rebalance(), which the daemon runs in the background.
+     */
+    class TieredMemory {
+    public:
+        TieredMemory(LibrarianShards& hot, Database& db, std::mutex& db_mutex, Metric metric, size_t budget);
+
+        /**
+         * @brief Takes over what the hot tier holds after a restore. Call before any search.
+         */
+        void seed();
+
+        /**
+         * @brief Records a vector the caller just added to the hot tier.
+         */
+        void record_insert(size_t id);
+
+        /**
+         * @brief Forgets a removed item, hot or cold.
+         */
+        void record_remove(size_t id);
+
+        /**
+         * @brief Searches both tiers and merges by score; hits count as accesses.
+         */
+        std::vector<SearchHit> search(const std::vector<float>& query, size_t k,
+                                      const SearchFilters& filters = {}, size_t ef = 0);
+
+        /**
+         * @brief Promotes recently hit cold items and evicts down to the budget.
+         * @return Number of items moved between the tiers.
+         */
+        size_t rebalance();
+
+        size_t hot_count() const;
+        size_t cold_count() const { return m_cold.load(); }
+        size_t budget() const { return m_budget; }
+
+    private:
+        // Segmented LRU over the hot ids; the caller holds m_mutex
+        void touch(size_t id);
+        bool forget(size_t id); // False if the id was not hot
+        bool pop_victim(size_t& id);
+        void mark_cold(size_t id);
+        bool clear_cold(size_t id); // False if the id was not cold
+
+        std::vector<SearchHit> scan_cold(const std::vector<float>& query, size_t k, const SearchFilters& filters,
+                                         const std::vector<uint8_t>& resident, const std::unordered_set<size_t>& skip);
+        void publish_resident();
+
+        LibrarianShards& m_hot;
+        Database& m_db;
+        std::mutex& m_db_mutex;
+        Metric m_metric;
+        size_t m_budget;
+        size_t m_protected_limit;
+
+        mutable std::mutex m_mutex;
+        std::list<size_t> m_probation; // Most recent first
+        std::list<size_t> m_protected;
+        struct Entry {
+            std::list<size_t>::iterator pos;
+            bool is_protected = false;
+        };
+        std::unordered_map<size_t, Entry> m_entries;
+        std::vector<size_t> m_promote; // Cold hits waiting for rebalance()
+
+        // Hot membership by id, replaced as a whole so scans never block the writers
+        std::shared_ptr<const std::vector<uint8_t>> m_resident;
+        std::vector<bool> m_cold_ids;  // Ids with a stored vector that are not hot, by chunk id
+        std::atomic<size_t> m_cold{0}; // Set bits of m_cold_ids; changed under m_mutex
+    };
+
+}
@@ -0,0 +1,225 @@
+#include "tokenizer.hpp"
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <deque>
+
+namespace kestr::engine {
+
+    namespace {
+
+        // Same classification as the "C" locale, without the locale lookups
+        bool is_space(unsigned char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+        bool is_punct(unsigned char c) { return c > ' ' && c < 0x7F && !((c >= '0' && c <= '9') || ((c | 0x20) >= 'a' && (c | 0x20) <= 'z')); }
+        unsigned char to_lower(unsigned char c) { return (c >= 'A' && c <= 'Z') ? c | 0x20 : c; }
+
+    }
+
+    Tokenizer::Tokenizer(const std::string& vocab_path) {
+        if (!load_vocab(vocab_path)) build({});
+    }
+
+    bool Tokenizer::load_vocab(const std::string& path) {
+        std::ifstream file(path);
+        if (!file.is_open()) {
+            std::cerr << "[Tokenizer] Failed to load vocab: " << path << "\n";
+            return false;
+        }
+        std::vector<std::string> vocab;
+        std::string line;
+        while (std::getline(file, line)) {
+            // Trim newline
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            vocab.push_back(line);
+        }
+        build(vocab);
+        return true;
+    }
+
+    void Tokenizer::build(const std::vector<std::string>& vocab) {
+        // 1. Plain pointer trie; for duplicate lines the last id wins
+        struct Node {
+            std::map<unsigned char, int32_t> children;
+            int32_t value = -1;
+        };
+        std::vector<Node> nodes(1);
+        for (size_t id = 0; id < vocab.size(); ++id) {
+            int32_t n = 0;
+            for (unsigned char c : vocab[id]) {
+                auto it = nodes[n].children.find(c);
+                if (it == nodes[n].children.end()) {
+                    nodes[n].children.emplace(c, static_cast<int32_t>(nodes.size()));
+                    n = static_cast<int32_t>(nodes.size());
+                    nodes.emplace_back();
+                } else {
+                    n = it->second;
+                }
+            }
+            nodes[n].value = static_cast<int32_t>(id);
+        }
+
+        // 2. Place it into the double array breadth-first, each state at the first base where all
+        // its edges land on free slots. skip[i] leads to the first free slot >= i (path-compressed).
+        m_base.assign(256, 0);
+        m_check.assign(256, -1);
+        m_value.assign(256, -1);
+        std::vector<int32_t> skip(256);
+        for (size_t i = 0; i < skip.size(); ++i) skip[i] = static_cast<int32_t>(i);
+        auto grow = [&](size_t size) {
+            if (size <= m_check.size()) return;
+            size_t old = skip.size();
+            m_base.resize(size, 0);
+            m_check.resize(size, -1);
+            m_value.resize(size, -1);
+            skip.resize(size);
+            for (size_t i = old; i < size; ++i) skip[i] = static_cast<int32_t>(i);
+        };
+        auto free_slot = [&](size_t i) {
+            grow(i + 1);
+            size_t root = i;
+            while (static_cast<size_t>(skip[root]) != root) root = skip[root];
+            while (i != root) {
+                size_t next = skip[i];
+                skip[i] = static_cast<int32_t>(root);
+                i = next;
+            }
+            return root;
+        };
+        auto occupy = [&](size_t t, int32_t parent) {
+            m_check[t] = parent;
+            skip[t] = static_cast<int32_t>(t + 1);
+        };
+
+        occupy(0, 0); // Root
+        m_value[0] = nodes[0].value;
+        std::deque<std::pair<int32_t, int32_t>> queue{{0, 0}}; // (trie node, state)
+        while (!queue.empty()) {
+            auto [n, s] = queue.front();
+            queue.pop_front();
+            const auto& children = nodes[n].children;
+            if (children.empty()) continue;
+
+            // Try bases that put the lowest edge on each free slot in turn
+            unsigned char lowest = children.begin()->first;
+            size_t base = 0;
+            for (size_t slot = free_slot(lowest + 1);; slot = free_slot(slot + 1)) {
+                base = slot - lowest;
+                grow(base + 256);
+                bool fits = true;
+                for (const auto& [c, child] : children) {
+                    if (m_check[base + c] != -1) {
+                        fits = false;
+                        break;
+                    }
+                }
+                if (fits) break;
+            }
+
+            m_base[s] = static_cast<int32_t>(base);
+            for (const auto& [c, child] : children) {
+                int32_t t = static_cast<int32_t>(base + c);
+                occupy(t, s);
+                m_value[t] = nodes[child].value;
+                queue.emplace_back(child, t);
+            }
+        }
+
+        // Trim the slack left for the last placements
+        size_t used = m_check.size();
+        while (used > 1 && m_check[used - 1] == -1) --used;
+        m_base.resize(used);
+        m_check.resize(used);
+        m_value.resize(used);
+        m_base.shrink_to_fit();
+        m_check.shrink_to_fit();
+        m_value.shrink_to_fit();
+
+        m_vocab_size = vocab.size();
+        m_continuation = walk(0, "##");
+        if (int64_t unk = id("[UNK]"); unk >= 0) m_unk = unk;
+        if (int64_t cls = id("[CLS]"); cls >= 0) m_cls = cls;
+        if (int64_t sep = id("[SEP]"); sep >= 0) m_sep = sep;
+    }
+
+    int32_t Tokenizer::walk(int32_t state, std::string_view bytes) const {
+        for (unsigned char c : bytes) {
+            state = next(state, c);
+            if (state < 0) return -1;
+        }
+        return state;
+    }
+
+    int64_t Tokenizer::id(std::string_view token) const {
+        int32_t s = walk(0, token);
+        return s < 0 ? -1 : m_value[s];
+    }
+
+    size_t Tokenizer::encode(std::string_view text, std::vector<int64_t>& ids, std::vector<Offset>* offsets, size_t max_length) const {
+        ids.clear();
+        if (offsets) offsets->clear();
+        // One slot stays reserved for [SEP]
+        size_t limit = max_length > 0 ? max_length - 1 : 0;
+        auto emit = [&](int64_t id, uint32_t begin, uint32_t end) {
+            ids.push_back(id);
+            if (offsets) offsets->emplace_back(begin, end);
+        };
+        emit(m_cls, 0, 0);
+
+        // Kept (lowercased, non-punctuation) bytes of the current word and where they came from
+        unsigned char word[kMaxWordBytes];
+        uint32_t position[kMaxWordBytes];
+
+        size_t i = 0;
+        while (i < text.size() && ids.size() < limit) {
+            while (i < text.size() && is_space(text[i])) ++i;
+            size_t word_begin = i;
+            size_t length = 0;
+            for (; i < text.size() && !is_space(text[i]); ++i) {
+                unsigned char c = text[i];
+                if (is_punct(c)) continue;
+                if (length < kMaxWordBytes) {
+                    word[length] = to_lower(c);
+                    position[length] = static_cast<uint32_t>(i);
+                }
+                ++length;
+            }
+            if (length == 0) continue;
+            if (length > kMaxWordBytes) {
+                emit(m_unk, static_cast<uint32_t>(word_begin), static_cast<uint32_t>(i));
+                continue;
+            }
+
+            // Greedy longest match; a word with an unmatchable piece becomes a single [UNK]
+            size_t first_piece = ids.size();
+            size_t start = 0;
+            while (start < length) {
+                int32_t s = (start == 0) ? 0 : m_continuation;
+                size_t match_end = 0;
+                int64_t match_id = -1;
+                for (size_t k = start; k < length && s >= 0; ++k) {
+                    s = next(s, word[k]);
+                    if (s >= 0 && m_value[s] >= 0) {
+                        match_end = k + 1;
+                        match_id = m_value[s];
+                    }
+                }
+                if (match_id < 0) {
+                    ids.resize(first_piece);
+                    if (offsets) offsets->resize(first_piece);
+                    emit(m_unk, static_cast<uint32_t>(word_begin), static_cast<uint32_t>(i));
+                    break;
+                }
+                emit(match_id, position[start], position[match_end - 1] + 1);
+                start = match_end;
+            }
+        }
+
+        if (ids.size() > limit) {
+            ids.resize(limit);
+            if (offsets) offsets->resize(limit);
+        }
+        emit(m_sep, 0, 0);
+        return ids.size();
+    }
+
+}
@@ -1,106 +1,77 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
-#include <unordered_map>
-#include <fstream>
-#include <iostream>
-#include <sstream>
-#include <algorithm>
+#include <cstdint>
+#include <utility>
 
 namespace kestr::engine {
 
+    /**
+     * @brief BERT WordPiece tokenizer over a vocab.txt file.
+     * The vocab is compiled into a double-array trie, so greedy longest-match is a single
+     * walk per word piece over the input: no lowercase copy, no substrings, no hashing.
+     * Words are runs of non-whitespace, ASCII-lowercased, with ASCII punctuation dropped;
+     * words longer than 100 bytes become [UNK].
+     * Immutable after construction, so one instance can be shared by several threads.
+     */
     class Tokenizer {
     public:
-        Tokenizer(const std::string& vocab_path) {
-            load_vocab(vocab_path);
-        }
-
-        std::vector<int64_t> encode(const std::string& text, size_t max_length = 512) {
-            std::vector<int64_t> ids;
-            ids.push_back(101); // [CLS]
-
-            std::string normalized = to_lower(text); // Basic normalization
-            std::stringstream ss(normalized);
-            std::string word;
-
-            while (ss >> word) {
-                // Remove basic punctuation (simplified)
-                word.erase(std::remove_if(word.begin(), word.end(), ::ispunct), word.end());
-                if (word.empty()) continue;
-
-                // Max WordPiece length check to avoid stalls
-                if (word.length() > 100) word = "[UNK]";
-
-                bool is_bad = false;
-                size_t start = 0;
-                std::vector<int64_t> sub_tokens;
-
-                while (start < word.length()) {
-                    size_t end = word.length();
-                    int64_t cur_substr = -1;
-
-                    while (start < end) {
-                        std::string substr = word.substr(start, end - start);
-                        if (start > 0) substr = "##" + substr;
+        using Offset = std::pair<uint32_t, uint32_t>; // [begin, end) byte range in the input
 
-                        if (m_vocab.count(substr)) {
-                            cur_substr = m_vocab[substr];
-                            break;
-                        }
-                        end--;
-                    }
+        explicit Tokenizer(const std::string& vocab_path);
 
-                    if (cur_substr == -1) {
-                        is_bad = true;
-                        break;
-                    }
+        /**
+         * @brief Encodes text as [CLS] pieces... [SEP], truncated to max_length ids.
+         * Both buffers are cleared and refilled, so callers that keep them around encode
+         * without allocating once they reached their high-water mark.
+         * @param offsets If given, receives the input byte range of every id ({0, 0} for [CLS] and [SEP]).
+         * @return Number of ids written.
+         */
+        size_t encode(std::string_view text, std::vector<int64_t>& ids, std::vector<Offset>* offsets = nullptr,
+                      size_t max_length = 512) const;
 
-                    sub_tokens.push_back(cur_substr);
-                    start = end;
-                }
+        std::vector<int64_t> encode(std::string_view text, size_t max_length = 512) const {
+            std::vector<int64_t> ids;
+            encode(text, ids, nullptr, max_length);
+            return ids;
+        }
 
-                if (is_bad) {
-                    ids.push_back(100); // [UNK]
-                } else {
-                    ids.insert(ids.end(), sub_tokens.begin(), sub_tokens.end());
-                }
+        /**
+         * @brief Id of an exact vocab entry, or -1.
+         */
+        int64_t id(std::string_view token) const;
 
-                if (ids.size() >= max_length - 1) break; // Reserve 1 for [SEP]
-            }
+        size_t vocab_size() const { return m_vocab_size; }
 
-            if (ids.size() >= max_length) {
-                ids.resize(max_length - 1);
-            }
-            ids.push_back(102); // [SEP]
+    private:
+        static constexpr size_t kMaxWordBytes = 100;
 
-            return ids;
-        }
+        bool load_vocab(const std::string& path);
+        void build(const std::vector<std::string>& vocab);
 
-    private:
-        std::unordered_map<std::string, int64_t> m_vocab;
+        /**
+         * @brief Walks from state over the bytes; returns the end state or -1.
+         */
+        int32_t walk(int32_t state, std::string_view bytes) const;
 
-        void load_vocab(const std::string& path) {
-            std::ifstream file(path);
-            if (!file.is_open()) {
-                std::cerr << "[Tokenizer] Failed to load vocab: " << path << "\n";
-                return;
-            }
-            std::string line;
-            int64_t id = 0;
-            while (std::getline(file, line)) {
-                // Trim newline
-                if (!line.empty() && line.back() == '\r') line.pop_back();
-                m_vocab[line] = id++;
-            }
+        int32_t next(int32_t state, unsigned char byte) const {
+            size_t t = static_cast<size_t>(m_base[state]) + byte;
+            return t < m_check.size() && m_check[t] == state ? static_cast<int32_t>(t) : -1;
         }
 
-        std::string to_lower(const std::string& s) {
-            std::string data = s;
-            std::transform(data.begin(), data.end(), data.begin(),
-                [](unsigned char c){ return std::tolower(c); });
-            return data;
-        }
+        // Double-array trie: state s has an edge on byte c to t = base[s] + c iff check[t] == s.
+        // value[t] is the token id ending at t, or -1.
+        std::vector<int32_t> m_base;
+        std::vector<int32_t> m_check;
+        std::vector<int32_t> m_value;
+        int32_t m_continuation = -1; // State after "##", where non-initial pieces start
+
+        size_t m_vocab_size = 0;
+        int64_t m_unk = 100;
+        int64_t m_cls = 101;
+        int64_t m_sep = 102;
     };
 
 }
@@ -0,0 +1,169 @@
+#include "vector_kernels.hpp"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define KESTR_KERNELS_AVX2 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define KESTR_KERNELS_NEON 1
+#endif
+
+namespace kestr::engine::kernels {
+
+    namespace {
+
+        float dot_scalar(const float* a, const float* b, size_t dim) {
+            float sum = 0.0f;
+            for (size_t i = 0; i < dim; ++i) sum += a[i] * b[i];
+            return sum;
+        }
+
+        float l2_scalar(const float* a, const float* b, size_t dim) {
+            float sum = 0.0f;
+            for (size_t i = 0; i < dim; ++i) {
+                float d = a[i] - b[i];
+                sum += d * d;
+            }
+            return sum;
+        }
+
+#if defined(KESTR_KERNELS_AVX2)
+        __attribute__((target("avx2,fma")))
+        float hsum(__m256 v) {
+            __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+            s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+            s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 0x55));
+            return _mm_cvtss_f32(s);
+        }
+
+        __attribute__((target("avx2,fma")))
+        float dot_avx2(const float* a, const float* b, size_t dim) {
+            // Two accumulators hide the FMA latency
+            __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+            size_t i = 0;
+            for (; i + 16 <= dim; i += 16) {
+                acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+                acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+            }
+            for (; i + 8 <= dim; i += 8) acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+            return hsum(_mm256_add_ps(acc0, acc1)) + dot_scalar(a + i, b + i, dim - i);
+        }
+
+        __attribute__((target("avx2,fma")))
+        float l2_avx2(const float* a, const float* b, size_t dim) {
+            __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+            size_t i = 0;
+            for (; i + 16 <= dim; i += 16) {
+                __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+                __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+                acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+                acc1 = _mm256_fmadd_ps(d1, d1, acc1);
+            }
+            for (; i + 8 <= dim; i += 8) {
+                __m256 d = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+                acc0 = _mm256_fmadd_ps(d, d, acc0);
+            }
+            return hsum(_mm256_add_ps(acc0, acc1)) + l2_scalar(a + i, b + i, dim - i);
+        }
+
+        // Adds the two 256-bit halves and finishes in hsum. GCC 12 builds _mm512_reduce_add_ps,
+        // and even the plain extracts and casts, on an undefined source that -Wall reports as
+        // uninitialized; the zero-masked extract (AVX512F, unlike extractf32x8) has none.
+        __attribute__((target("avx512f")))
+        float hsum(__m512 v) {
+            __m512d bits = _mm512_castps_pd(v);
+            __m256 low = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xF, bits, 0));
+            __m256 high = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xF, bits, 1));
+            return hsum(_mm256_add_ps(low, high));
+        }
+
+        __attribute__((target("avx512f")))
+        float dot_avx512(const float* a, const float* b, size_t dim) {
+            __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+            size_t i = 0;
+            for (; i + 32 <= dim; i += 32) {
+                acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+                acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), acc1);
+            }
+            for (; i + 16 <= dim; i += 16) acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+            return hsum(_mm512_add_ps(acc0, acc1)) + dot_scalar(a + i, b + i, dim - i);
+        }
+
+        __attribute__((target("avx512f")))
+        float l2_avx512(const float* a, const float* b, size_t dim) {
+            __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+            size_t i = 0;
+            for (; i + 32 <= dim; i += 32) {
+                __m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+                __m512 d1 = _mm512_sub_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16));
+                acc0 = _mm512_fmadd_ps(d0, d0, acc0);
+                acc1 = _mm512_fmadd_ps(d1, d1, acc1);
+            }
+            for (; i + 16 <= dim; i += 16) {
+                __m512 d = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+                acc0 = _mm512_fmadd_ps(d, d, acc0);
+            }
+            return hsum(_mm512_add_ps(acc0, acc1)) + l2_scalar(a + i, b + i, dim - i);
+        }
+#elif defined(KESTR_KERNELS_NEON)
+        float dot_neon(const float* a, const float* b, size_t dim) {
+            float32x4_t acc0 = vdupq_n_f32(0.0f), acc1 = vdupq_n_f32(0.0f);
+            size_t i = 0;
+            for (; i + 8 <= dim; i += 8) {
+                acc0 = vfmaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+                acc1 = vfmaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+            }
+            return vaddvq_f32(vaddq_f32(acc0, acc1)) + dot_scalar(a + i, b + i, dim - i);
+        }
+
+        float l2_neon(const float* a, const float* b, size_t dim) {
+            float32x4_t acc0 = vdupq_n_f32(0.0f), acc1 = vdupq_n_f32(0.0f);
+            size_t i = 0;
+            for (; i + 8 <= dim; i += 8) {
+                float32x4_t d0 = vsubq_f32(vld1q_f32(a + i), vld1q_f32(b + i));
+                float32x4_t d1 = vsubq_f32(vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+                acc0 = vfmaq_f32(acc0, d0, d0);
+                acc1 = vfmaq_f32(acc1, d1, d1);
+            }
+            return vaddvq_f32(vaddq_f32(acc0, acc1)) + l2_scalar(a + i, b + i, dim - i);
+        }
+#endif
+
+        using KernelFn = float (*)(const float*, const float*, size_t);
+
+        struct Dispatch {
+            KernelFn dot = dot_scalar;
+            KernelFn l2 = l2_scalar;
+            const char* name = "scalar";
+
+            Dispatch() {
+#if defined(KESTR_KERNELS_AVX2)
+                if (__builtin_cpu_supports("avx512f")) {
+                    dot = dot_avx512;
+                    l2 = l2_avx512;
+                    name = "avx512";
+                } else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+                    dot = dot_avx2;
+                    l2 = l2_avx2;
+                    name = "avx2";
+                }
+#elif defined(KESTR_KERNELS_NEON)
+                dot = dot_neon;
+                l2 = l2_neon;
+                name = "neon";
+#endif
+            }
+        };
+
+        const Dispatch& dispatch() {
+            static const Dispatch d;
+            return d;
+        }
+
+    }
+
+    float dot(const float* a, const float* b, size_t dim) { return dispatch().dot(a, b, dim); }
+    float l2_squared(const float* a, const float* b, size_t dim) { return dispatch().l2(a, b, dim); }
+    const char* name() { return dispatch().name; }
+
+}
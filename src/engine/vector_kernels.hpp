@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+
+namespace kestr::engine {
+
+    /**
+     * @brief fp32 vector kernels for exhaustive scans, dispatched once at startup
+     * (AVX-512 or AVX2 + FMA on x86-64 when the CPU has it, NEON on ARM64, scalar otherwise).
+     */
+    namespace kernels {
+
+        float dot(const float* a, const float* b, size_t dim);
+        float l2_squared(const float* a, const float* b, size_t dim);
+
+        /**
+         * @brief Name of the selected implementation ("avx512", "avx2", "neon" or "scalar").
+         */
+        const char* name();
+
+    }
+
+}
@@ -8,7 +8,9 @@
 #include <sstream>
 #include <mutex>
 #include <algorithm>
+#include <cmath>
 #include <map>
+#include <future>
 #ifndef KESTR_PLATFORM_WINDOWS
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -19,11 +21,14 @@
 #include "engine/scanner.hpp"
 #include "engine/database.hpp"
 #include "engine/embedder.hpp"
-#include "engine/librarian.hpp"
+#include "engine/embedding_cache.hpp"
+#include "engine/model_prep.hpp"
+#include "engine/query_cache.hpp"
+#include "engine/librarian_shards.hpp"
+#include "engine/tiered_memory.hpp"
 #include "engine/config.hpp"
 #include "engine/job_queue.hpp"
-#include "engine/text_chunker.hpp"
-#include "engine/treesitter_parser.hpp"
+#include "engine/indexing_pipeline.hpp"
 #include <nlohmann/json.hpp>
 #include <curl/curl.h>
 
@@ -31,7 +36,20 @@
 std::atomic<bool> g_running{true};
 std::mutex g_db_mutex;
 
-std::string get_observability_json(kestr::engine::Database& db, std::shared_ptr<kestr::engine::Librarian> librarian, kestr::engine::JobQueue& queue, const kestr::engine::Config& config) {
+nlohmann::json pipeline_json(const kestr::engine::IndexingPipeline& pipeline) {
+    auto s = pipeline.stats();
+    return {
+        {"read", s.read_queue},
+        {"parse", s.parse_queue},
+        {"embed", s.embed_queue},
+        {"write", s.write_queue},
+        {"files_indexed", s.files_indexed},
+        {"chunks_embedded", s.chunks_embedded},
+        {"chunks_reused", s.chunks_reused}
+    };
+}
+
+std::string get_observability_json(kestr::engine::Database& db, std::shared_ptr<kestr::engine::LibrarianShards> librarian, kestr::engine::JobQueue& queue, const kestr::engine::IndexingPipeline& pipeline, const kestr::engine::Config& config) {
     nlohmann::json stats;
     {
         std::lock_guard<std::mutex> lock(g_db_mutex);
@@ -39,7 +57,10 @@ std::string get_observability_json(kestr::engine::Database& db, std::shared_ptr<
         stats["total_chunks"] = db.count_chunks();
     }
     stats["memory_items"] = librarian ? librarian->count() : 0;
+    stats["index_capacity"] = librarian ? librarian->capacity() : 0;
+    stats["index_utilization"] = librarian ? librarian->utilization() : 0.0;
     stats["queue_size"] = queue.size();
+    stats["pipeline"] = pipeline_json(pipeline);
     stats["watch_paths"] = config.watch_paths;
     return stats.dump();
 }
@@ -50,7 +71,7 @@ void signal_handler(int signum) {
 }
 
 #ifndef KESTR_PLATFORM_WINDOWS
-void start_web_server(int port, kestr::engine::Database& db, std::shared_ptr<kestr::engine::Librarian> librarian, kestr::engine::JobQueue& queue, const kestr::engine::Config& config) {
+void start_web_server(int port, kestr::engine::Database& db, std::shared_ptr<kestr::engine::LibrarianShards> librarian, kestr::engine::JobQueue& queue, const kestr::engine::IndexingPipeline& pipeline, const kestr::engine::Config& config) {
     int server_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (server_fd == -1) return;
 
@@ -89,6 +110,8 @@ void start_web_server(int port, kestr::engine::Database& db, std::shared_ptr<kes
                     document.getElementById('chunks').innerText = data.total_chunks;
                     document.getElementById('mem').innerText = data.memory_items;
                     document.getElementById('queue').innerText = data.queue_size;
+                    const p = data.pipeline;
+                    document.getElementById('stages').innerText = `read ${p.read} / parse ${p.parse} / embed ${p.embed} / write ${p.write}`;
                     document.getElementById('paths').innerText = data.watch_paths.join(', ');
                 } catch (e) { console.error(e); }
             }
@@ -103,6 +126,7 @@ void start_web_server(int port, kestr::engine::Database& db, std::shared_ptr<kes
             <div class="card"><div class="label">Total Chunks</div><div id="chunks" class="stat">0</div></div>
             <div class="card"><div class="label">Items in RAM</div><div id="mem" class="stat">0</div></div>
             <div class="card"><div class="label">Queue Size</div><div id="queue" class="stat">0</div></div>
+            <div class="card"><div class="label">Stage Queues</div><div id="stages">-</div></div>
         </div>
         <div class="card" style="margin-top: 20px;">
             <div class="label">Watched Paths</div>
@@ -121,7 +145,7 @@ void start_web_server(int port, kestr::engine::Database& db, std::shared_ptr<kes
         std::string request(buffer);
 
         if (request.find("GET /api/stats") != std::string::npos) {
-            std::string json = get_observability_json(db, librarian, queue, config);
+            std::string json = get_observability_json(db, librarian, queue, pipeline, config);
             std::string response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " + std::to_string(json.size()) + "\r\n\r\n" + json;
             send(new_socket, response.c_str(), response.size(), 0);
         } else {
@@ -134,32 +158,81 @@ void start_web_server(int port, kestr::engine::Database& db, std::shared_ptr<kes
 }
 #endif
 
-// Helper to determine if a file should use tree-sitter
-bool should_use_treesitter(const std::filesystem::path& path) {
-    std::string ext = path.extension().string();
-    return ext == ".py" || ext == ".cpp" || ext == ".hpp" || ext == ".h" || ext == ".cc" || 
-           ext == ".go" || ext == ".rs" || ext == ".js" || ext == ".ts" || 
-           ext == ".java" || ext == ".cs" || ext == ".php" || ext == ".rb";
-}
+/**
+ * @brief `kestrd prepare-model`: writes model.int8.onnx next to the downloaded model, but only
+ * if its vectors stay close to the fp32 model's on a sample of the user's own indexed chunks.
+ */
+int prepare_model(const std::vector<std::string>& args, const std::filesystem::path& data_dir, kestr::engine::Database& db, kestr::engine::OnnxOptions options) {
+    double max_drift = 0.02;
+    size_t samples = 256;
+    std::string python = "python3";
+    bool usage = (args.size() % 2 != 0);
+    try {
+        for (size_t i = 0; !usage && i + 1 < args.size(); i += 2) {
+            if (args[i] == "--max-drift") max_drift = std::stod(args[i + 1]);
+            else if (args[i] == "--samples") samples = std::stoul(args[i + 1]);
+            else if (args[i] == "--python") python = args[i + 1];
+            else usage = true;
+        }
+    } catch (const std::exception&) {
+        usage = true;
+    }
+    if (usage) {
+        std::cerr << "Usage: kestrd prepare-model [--max-drift 0.02] [--samples 256] [--python python3]" << std::endl;
+        return 2;
+    }
 
-// Helper to map extension to language string
-std::string extension_to_language(const std::filesystem::path& path) {
-    std::string ext = path.extension().string();
-    if (ext == ".cpp" || ext == ".hpp" || ext == ".h" || ext == ".cc") return "cpp";
-    if (ext == ".py") return "python";
-    if (ext == ".js" || ext == ".jsx") return "javascript";
-    if (ext == ".ts" || ext == ".tsx") return "typescript";
-    if (ext == ".go") return "go";
-    if (ext == ".rs") return "rust";
-    if (ext == ".java") return "java";
-    if (ext == ".cs") return "c_sharp";
-    if (ext == ".php") return "php";
-    if (ext == ".rb") return "ruby";
-    if (ext == ".md") return "markdown";
-    if (ext == ".json") return "json";
-    if (ext == ".txt") return "text";
-    if (!ext.empty() && ext[0] == '.') return ext.substr(1);
-    return "unknown";
+    auto model_path = data_dir / "model.onnx";
+    auto vocab_path = data_dir / "vocab.txt";
+    auto output = data_dir / "model.int8.onnx";
+    auto candidate = data_dir / "model.int8.onnx.tmp";
+    if (!std::filesystem::exists(model_path) || !std::filesystem::exists(vocab_path)) {
+        std::cerr << "[Kestr] No local model in " << data_dir << ". Start kestrd once with the onnx backend to download it." << std::endl;
+        return 1;
+    }
+    auto texts = db.sample_chunk_contents(samples);
+    if (texts.empty()) {
+        std::cerr << "[Kestr] Nothing indexed yet to verify the quantized model against. Index a project first." << std::endl;
+        return 1;
+    }
+
+    std::cout << "[Kestr] Quantizing " << model_path << " to int8..." << std::endl;
+    if (!kestr::engine::quantize_model(model_path, candidate, python)) return 1;
+
+    // Only one model at a time is resident; a single worker keeps the timings comparable
+    options.workers = 1;
+    kestr::engine::ReferenceVectors expected;
+    {
+        auto reference = kestr::engine::create_onnx_embedder(model_path.string(), vocab_path.string(), options);
+        expected = kestr::engine::embed_reference(*reference, texts);
+    }
+    auto quantized = kestr::engine::create_onnx_embedder(candidate.string(), vocab_path.string(), options);
+    auto report = kestr::engine::measure_drift(expected, *quantized, texts);
+
+    std::cout << "[Kestr] Compared " << report.samples << " chunks: mean drift " << report.mean_drift
+              << ", max drift " << report.max_drift << " (1 - cosine similarity)." << std::endl;
+    if (report.candidate_seconds > 0) {
+        std::cout << "[Kestr] fp32 " << report.reference_seconds << "s, int8 " << report.candidate_seconds << "s ("
+                  << report.reference_seconds / report.candidate_seconds << "x)." << std::endl;
+    }
+    std::error_code ec;
+    if (report.samples == 0 || report.failures > 0) {
+        std::cerr << "[Kestr] " << report.failures << " chunks could not be embedded by both models. Keeping the fp32 model." << std::endl;
+        std::filesystem::remove(candidate, ec);
+        return 1;
+    }
+    if (report.mean_drift > max_drift) {
+        std::cerr << "[Kestr] Drift exceeds --max-drift " << max_drift << ". Keeping the fp32 model." << std::endl;
+        std::filesystem::remove(candidate, ec);
+        return 1;
+    }
+    std::filesystem::rename(candidate, output, ec);
+    if (ec) {
+        std::cerr << "[Kestr] Could not write " << output << ": " << ec.message() << std::endl;
+        return 1;
+    }
+    std::cout << "[Kestr] Wrote " << output << ". kestrd uses it from the next start and re-indexes once." << std::endl;
+    return 0;
 }
 
 int main(int argc, char* argv[]) {
@@ -194,6 +267,20 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    kestr::engine::OnnxOptions onnx_options;
+    onnx_options.intra_op_threads = config.onnx_intra_op_threads;
+    onnx_options.inter_op_threads = config.onnx_inter_op_threads;
+    onnx_options.allow_spinning = config.onnx_allow_spinning;
+    onnx_options.memory_arena = config.onnx_memory_arena;
+    onnx_options.workers = config.onnx_workers;
+    onnx_options.max_tokens = config.onnx_max_tokens;
+
+    if (argc > 1 && std::string(argv[1]) == "prepare-model") {
+        int rc = prepare_model(std::vector<std::string>(argv + 2, argv + argc), data_dir, db, onnx_options);
+        curl_global_cleanup();
+        return rc;
+    }
+
     // 3. Initialize Embedder with Smart Detection & Auto-Download
     std::unique_ptr<kestr::engine::Embedder> embedder;
     const char* env_openai_key = std::getenv("OPENAI_API_KEY");
@@ -220,8 +307,13 @@ int main(int argc, char* argv[]) {
         }
 
         if (local_found) {
+            auto quantized = model_path.parent_path() / "model.int8.onnx";
+            if (config.onnx_quantized && std::filesystem::exists(quantized)) model_path = quantized;
+            if (config.onnx_save_optimized) {
+                onnx_options.optimized_model_dir = data_dir.string();
+            }
             std::cout << "[Kestr] Using Local ONNX Embedder (" << model_path << ")." << std::endl;
-            embedder = kestr::engine::create_onnx_embedder(model_path.string(), vocab_path.string());
+            embedder = kestr::engine::create_onnx_embedder(model_path.string(), vocab_path.string(), onnx_options);
         } else {
             bool ollama_up = false;
             CURL* curl = curl_easy_init();
@@ -246,8 +338,9 @@ int main(int argc, char* argv[]) {
                 std::string cmd_v = "curl -L -o " + vocab_path.string() + " https://huggingface.co/Xenova/all-MiniLM-L6-v2/resolve/main/vocab.txt";
                 
                 if (std::system(cmd_m.c_str()) == 0 && std::system(cmd_v.c_str()) == 0) {
-                    std::cout << "[Kestr] Download complete." << std::endl;
-                    embedder = kestr::engine::create_onnx_embedder(model_path.string(), vocab_path.string());
+                    std::cout << "[Kestr] Download complete. Run `kestrd prepare-model` once some code is indexed for a faster int8 model." << std::endl;
+                    if (config.onnx_save_optimized) onnx_options.optimized_model_dir = data_dir.string();
+                    embedder = kestr::engine::create_onnx_embedder(model_path.string(), vocab_path.string(), onnx_options);
                 } else {
                     std::cerr << "[Kestr] Download failed. Falling back to Ollama stub." << std::endl;
                     embedder = kestr::engine::create_ollama_embedder(config.embedding_model);
@@ -264,112 +357,204 @@ int main(int argc, char* argv[]) {
         std::cout << "[Kestr] WARNING: Dimension mismatch (DB: " << stored_dim << ", Model: " << current_dim << "). Triggering re-index..." << std::endl;
         db.wipe_all_chunks();
     }
-
+    // Same dimension but another model (e.g. the int8 copy from prepare-model): the old vectors don't compare
+    if (embedder && !embedder->model_id().empty()) {
+        std::string stored_model = db.get_meta("embedding_model");
+        if (!stored_model.empty() && stored_model != embedder->model_id()) {
+            std::cout << "[Kestr] WARNING: Embedding model changed (DB: " << stored_model << ", Model: " << embedder->model_id() << "). Triggering re-index..." << std::endl;
+            db.wipe_all_chunks();
+        }
+        if (stored_model != embedder->model_id()) db.set_meta("embedding_model", embedder->model_id());
+    }
+    // Identical chunks anywhere (vendored copies, other worktrees) are embedded once per model
+    std::unique_ptr<kestr::engine::CachingEmbedder> embedding_cache;
+    if (embedder && config.embedding_cache_limit > 0 && !embedder->model_id().empty()) {
+        size_t trimmed;
+        {
+            std::lock_guard<std::mutex> lock(g_db_mutex);
+            trimmed = db.trim_embedding_cache(config.embedding_cache_limit);
+        }
+        if (trimmed > 0) std::cout << "[Kestr] Embedding cache: dropped " << trimmed << " old entries." << std::endl;
+        embedding_cache = std::make_unique<kestr::engine::CachingEmbedder>(*embedder, db, g_db_mutex, config.embedding_cache_size);
+    }
     size_t dim = embedder ? embedder->dimension() : 384; 
     if (dim == 0) dim = 384; 
     
     // 4. Initialize Librarian
-    std::shared_ptr<kestr::engine::Librarian> librarian;
-    if (config.memory_mode != kestr::engine::Config::MemoryMode::DISK) {
-        size_t max_items = (config.memory_mode == kestr::engine::Config::MemoryMode::HYBRID) ? config.hybrid_limit : 100000;
-        librarian = std::make_shared<kestr::engine::Librarian>(dim, max_items);
-        std::lock_guard<std::mutex> lock(g_db_mutex);
-        db.for_each_vector([&](int64_t id, const std::vector<float>& vec) {
-            if (config.memory_mode == kestr::engine::Config::MemoryMode::HYBRID && librarian->count() >= config.hybrid_limit) return;
-            if (vec.size() == dim) { 
-                librarian->add_item(id, vec); 
-            }
-        });
-        std::cout << "[Kestr] Librarian ready with " << librarian->count() << " items." << std::endl;
-    }
+    // One Librarian per project root, so reindexing or growing one project leaves the others alone.
+    // DISK mode serves the persisted graphs from memory mappings; new vectors go to a small delta.
+    // The IVF-PQ backend keeps compact codes in RAM and its trained codebooks in the database.
+    std::shared_ptr<kestr::engine::LibrarianShards> librarian;
+    // HYBRID: the shards hold the hot items only; the rest is scanned from the database
+    std::unique_ptr<kestr::engine::TieredMemory> tiers;
+    bool ivfpq = (config.index_backend == "ivfpq");
+    kestr::engine::Metric metric = kestr::engine::Metric::Cosine;
+    if (config.vector_metric == "l2") metric = kestr::engine::Metric::L2;
+    else if (config.vector_metric == "auto" && embedder) metric = embedder->metric();
+    std::string metric_name = (metric == kestr::engine::Metric::Cosine) ? "cosine" : "l2";
+    // Per-shard meta key of the IVF-PQ codebooks
+    auto codebooks_key = [](const std::string& root) {
+        return "ivfpq_codebooks_" + kestr::engine::LibrarianShards::slug(root);
+    };
+    {
+        bool mapped = !ivfpq && (config.memory_mode == kestr::engine::Config::MemoryMode::DISK);
+        bool hybrid = (config.memory_mode == kestr::engine::Config::MemoryMode::HYBRID);
+        bool discard_snapshots = (stored_dim != 0 && stored_dim != current_dim);
 
-    // 5. Worker Logic
-    kestr::engine::JobQueue queue;
-    std::vector<std::thread> workers;
-    size_t num_workers = std::max(1u, std::thread::hardware_concurrency());
-    std::cout << "[Kestr] Spawning " << num_workers << " worker threads." << std::endl;
-
-    for (size_t i = 0; i < num_workers; ++i) {
-        workers.emplace_back([&]() {
-            kestr::engine::Scanner hasher_scanner; 
-
-            while (g_running) {
-                kestr::engine::FileInfo info;
-                bool got_job = queue.pop(info);
-
-                if (got_job) {
-                    std::string ext = info.path.extension().string();
-                    if (ext != ".cpp" && ext != ".hpp" && ext != ".h" && ext != ".md" && ext != ".txt" && ext != ".json" && ext != ".py" && ext != ".js" && ext != ".ts" && ext != ".go" && ext != ".rs" && ext != ".java" && ext != ".cs" && ext != ".php" && ext != ".rb") continue;
-                    
-                    std::string current_hash = hasher_scanner.hash_file(info.path);
-                    if (current_hash.empty()) continue;
-
-                    info.hash = current_hash;
-
-                    std::string content;
-                    try {
-                        std::ifstream file(info.path, std::ios::binary);
-                        if (!file.is_open()) continue;
-                        auto size = std::filesystem::file_size(info.path);
-                        content.resize(size);
-                        file.read(&content[0], size);
-                    } catch (...) {
-                        continue;
+        std::optional<kestr::engine::ScalarQuantizer> quantizer;
+        if (!ivfpq && config.vector_quantization == "int8") {
+            std::lock_guard<std::mutex> lock(g_db_mutex);
+            quantizer = kestr::engine::ScalarQuantizer::deserialize(db.get_meta("quantizer"));
+            if (!quantizer || quantizer->dimension() != dim || db.get_meta("quantizer_metric", "l2") != metric_name) {
+                auto samples = db.sample_vectors(10000);
+                samples.erase(std::remove_if(samples.begin(), samples.end(), [&](const auto& v) { return v.size() != dim; }), samples.end());
+                if (metric == kestr::engine::Metric::Cosine) {
+                    // The librarian quantizes normalized vectors, so fit on those
+                    for (auto& v : samples) {
+                        float norm = 0.0f;
+                        for (float x : v) norm += x * x;
+                        if (norm > 0.0f) for (float& x : v) x /= std::sqrt(norm);
                     }
+                }
+                if (samples.empty()) {
+                    // Nothing to fit on yet; unit-norm embeddings stay within [-1, 1]. Refit on the next start.
+                    quantizer = kestr::engine::ScalarQuantizer::uniform(dim, -1.0f, 1.0f);
+                } else {
+                    quantizer = kestr::engine::ScalarQuantizer::fit(samples);
+                    db.set_meta("quantizer", quantizer->serialize());
+                    db.set_meta("quantizer_metric", metric_name);
+                    std::cout << "[Kestr] Fitted int8 quantizer on " << samples.size() << " vectors." << std::endl;
+                }
+                // Codes from another quantizer are meaningless
+                discard_snapshots = true;
+            }
+        }
 
-                    std::string lang = extension_to_language(info.path);
-                    std::vector<kestr::engine::Chunk> chunks;
-                    std::vector<std::pair<uint32_t, std::string>> calls;
-                    if (should_use_treesitter(info.path)) {
-                        kestr::engine::TreeSitterParser ts_parser;
-                        chunks = ts_parser.parse(content, lang);
-                        calls = ts_parser.extract_calls(content, lang);
-                    } else {
-                        chunks = kestr::engine::TextChunker::chunk(content, 4000, 0.15f);
-                    }
+        auto factory = [&, mapped, hybrid, quantizer](const std::string& root, size_t expected) {
+            // Size each shard for its stored chunks plus headroom; it doubles if it still runs full
+            size_t max_items = std::max<size_t>(10000, expected);
+            if (hybrid) max_items = std::min(max_items, config.hybrid_limit);
+
+            std::unique_ptr<kestr::engine::Librarian> lib;
+            if (ivfpq) {
+                kestr::engine::IvfPqOptions ivf_options;
+                ivf_options.nlist = config.ivf_nlist;
+                ivf_options.nprobe = config.ivf_nprobe;
+                ivf_options.m = config.pq_m;
+                {
+                    std::lock_guard<std::mutex> lock(g_db_mutex);
+                    ivf_options.codebooks = db.get_meta_blob(codebooks_key(root));
+                }
+                lib = std::make_unique<kestr::engine::Librarian>(dim, ivf_options, metric);
+            } else {
+                lib = std::make_unique<kestr::engine::Librarian>(dim, max_items, mapped, quantizer, metric);
+                // Small projects: a scan is exact and needs no graph until they outgrow it
+                if (config.exact_search_limit > 0 && expected < config.exact_search_limit) lib->use_exact_search(config.exact_search_limit);
+            }
+            if ((quantizer || ivfpq) && config.rerank_factor > 1) {
+                lib->set_rerank([&db](const std::vector<size_t>& ids) {
+                    std::vector<int64_t> keys(ids.begin(), ids.end());
+                    std::unordered_map<size_t, std::vector<float>> vectors;
+                    std::lock_guard<std::mutex> lock(g_db_mutex);
+                    for (auto& [id, vec] : db.get_embeddings(keys)) vectors.emplace(id, std::move(vec));
+                    return vectors;
+                }, config.rerank_factor);
+            }
+            return lib;
+        };
+        librarian = std::make_shared<kestr::engine::LibrarianShards>(factory, data_dir, config.search_threads);
+        for (const auto& path : config.watch_paths) librarian->add_shard(path);
 
-                    if (chunks.empty()) {
-                        chunks = kestr::engine::TextChunker::chunk(content, 4000, 0.15f);
-                    }
-                    
-                    std::vector<std::vector<float>> embeddings;
-                    for (auto& c : chunks) {
-                        c.language = lang;
-                        c.project_root = info.project_root;
-                        if (embedder) embeddings.push_back(embedder->embed(c.content));
-                        else embeddings.push_back({});
-                    }
+        if (discard_snapshots) {
+            std::lock_guard<std::mutex> lock(g_db_mutex);
+            librarian->discard(db);
+        }
+        bool restored = librarian->restore(db, g_db_mutex, hybrid ? config.hybrid_limit : 0);
+        // Snapshot of the single index used before sharding
+        std::error_code ec;
+        if (std::filesystem::remove(data_dir / "kestr.hnsw", ec)) std::cout << "[Kestr] Removed unsharded index snapshot." << std::endl;
+        // A rebuilt mapped index lives in RAM until its first checkpoint; write it out right away
+        if (!restored && mapped) librarian->checkpoint(db, g_db_mutex);
+
+        if (hybrid && !ivfpq) {
+            tiers = std::make_unique<kestr::engine::TieredMemory>(*librarian, db, g_db_mutex, metric, config.hybrid_limit);
+            tiers->seed();
+            std::cout << "[Kestr] Hybrid memory: " << tiers->hot_count() << " hot items (budget " << config.hybrid_limit
+                      << "), about " << tiers->cold_count() << " cold in the database." << std::endl;
+        }
 
-                    {
-                        std::lock_guard<std::mutex> lock(g_db_mutex);
-                        db.begin_transaction();
-                        
-                        db.update_file(info);
-                        auto ids = db.insert_chunks(info.path, chunks, embeddings);
-                        
-                        for (const auto& call : calls) {
-                            if (!ids.empty()) {
-                                db.add_symbol_link(ids[0], call.second, "call");
-                            }
-                        }
-                        
-                        if (librarian) {
-                            for (size_t i = 0; i < ids.size(); ++i) {
-                                if (i < embeddings.size() && !embeddings[i].empty()) {
-                                    librarian->add_item(ids[i], embeddings[i]);
-                                }
-                            }
-                        }
+        std::string encoding = "fp32";
+        librarian->for_each_shard([&](const std::string&, kestr::engine::Librarian& lib) { encoding = lib.encoding(); });
+        std::cout << "[Kestr] Librarian ready with " << librarian->count() << " items in " << librarian->shard_count() << " shard(s)"
+                  << " (" << encoding << ", " << metric_name << (mapped ? ", memory-mapped)." : ").") << std::endl;
+    }
 
-                        db.set_indexed_status(info.path, true);
-                        db.commit_transaction();
-                    }
-                } else {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    // 5. Indexing Pipeline
+    kestr::engine::JobQueue queue;
+    size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    kestr::engine::PipelineOptions pipeline_options;
+    pipeline_options.read_threads = config.read_threads ? config.read_threads : 2;
+    pipeline_options.parse_threads = config.parse_threads ? config.parse_threads : std::max<size_t>(1, cores / 2);
+    pipeline_options.embed_threads = config.embed_threads ? config.embed_threads : std::max<size_t>(1, cores / 2);
+    std::cout << "[Kestr] Pipeline threads: read=" << pipeline_options.read_threads
+              << " parse=" << pipeline_options.parse_threads
+              << " embed=" << pipeline_options.embed_threads << " write=1" << std::endl;
+
+    // IVF-PQ trains itself once enough vectors arrived; keep its codebooks with the data
+    auto store_codebooks = [&]() {
+        if (!ivfpq || !librarian) return;
+        librarian->for_each_shard([&](const std::string& root, kestr::engine::Librarian& lib) {
+            auto codebooks = lib.export_codebooks();
+            if (codebooks.empty()) return;
+            std::lock_guard<std::mutex> lock(g_db_mutex);
+            if (db.get_meta_blob(codebooks_key(root)) != codebooks) db.set_meta_blob(codebooks_key(root), codebooks);
+        });
+    };
+    store_codebooks();
+
+    // Serializes librarian writers against snapshot checkpoints
+    std::mutex librarian_mutex;
+    auto checkpoint = [&]() {
+        if (!librarian) return;
+        std::lock_guard<std::mutex> lock(librarian_mutex);
+        librarian->checkpoint(db, g_db_mutex);
+        store_codebooks();
+    };
+
+    // Repeated queries skip the embedder, and the search too until the next commit
+    kestr::engine::QueryCache query_cache(config.query_cache_size, config.result_cache_size);
+
+    kestr::engine::DatabaseWriter writer(db, g_db_mutex);
+    writer.set_commit_hook([&](const std::vector<kestr::engine::WriteBatch>& batches, const std::vector<kestr::engine::WriteResult>& results) {
+        if (librarian) {
+            std::lock_guard<std::mutex> lock(librarian_mutex);
+            for (size_t b = 0; b < batches.size(); ++b) {
+                for (int64_t stale : results[b].removed_ids) {
+                    librarian->remove_item(stale);
+                    if (tiers) tiers->record_remove(stale);
+                }
+
+                const auto& ids = results[b].chunk_ids;
+                const auto& embeddings = batches[b].embeddings;
+                for (size_t i = 0; i < ids.size() && i < embeddings.size(); ++i) {
+                    if (ids[i] < 0) continue;
+                    // Attributes first, so a filtered search never sees the vector without them
+                    librarian->set_attributes(ids[i], batches[b].chunks[i]);
+                    if (embeddings[i].empty()) continue;
+                    librarian->add_item(ids[i], embeddings[i]);
+                    if (tiers) tiers->record_insert(ids[i]); // Recent edits start out hot
                 }
             }
-        });
-    }
+        }
+        // Cached results go stale only once the vector index caught up with the commit as well
+        query_cache.advance_generation();
+    });
+    writer.set_requeue_hook([&](const kestr::engine::FileInfo& info) { queue.push(info); });
+    writer.start();
+
+    kestr::engine::Embedder* index_embedder = embedding_cache ? embedding_cache.get() : embedder.get();
+    kestr::engine::IndexingPipeline pipeline(queue, db, g_db_mutex, writer, index_embedder, pipeline_options);
+    pipeline.start();
 
     kestr::engine::Scanner scanner;
     auto scan_directory = [&](const std::filesystem::path& root) {
@@ -405,7 +590,27 @@ int main(int argc, char* argv[]) {
                 nlohmann::json res;
                 { std::lock_guard<std::mutex> lock(g_db_mutex); res["total_files"] = db.count_files(); res["total_chunks"] = db.count_chunks(); }
                 res["memory_items"] = librarian ? librarian->count() : 0;
+                res["index_capacity"] = librarian ? librarian->capacity() : 0;
+                res["index_utilization"] = librarian ? librarian->utilization() : 0.0;
+                if (tiers) {
+                    res["hot_items"] = tiers->hot_count();
+                    res["cold_items"] = tiers->cold_count();
+                }
+                if (embedding_cache) {
+                    res["embedding_cache"] = {
+                        {"memory_hits", embedding_cache->memory_hits()},
+                        {"disk_hits", embedding_cache->disk_hits()},
+                        {"misses", embedding_cache->misses()}
+                    };
+                }
+                res["query_cache"] = {
+                    {"embedding_hits", query_cache.embedding_hits()},
+                    {"result_hits", query_cache.result_hits()},
+                    {"misses", query_cache.misses()},
+                    {"generation", query_cache.generation()}
+                };
                 res["queue_size"] = queue.size();
+                res["pipeline"] = pipeline_json(pipeline);
                 res["watch_paths"] = config.watch_paths;
                 return nlohmann::json({{"result", res}}).dump();
             }
@@ -422,6 +627,7 @@ int main(int argc, char* argv[]) {
                     config.watch_paths.push_back(path_s);
                     config.save(config_path);
                     sentry->add_watch(p);
+                    if (librarian) librarian->add_shard(path_s);
                     std::thread([=]() { scan_directory(p); }).detach();
                     return "{\"result\": \"added: " + path_s + "\"}";
                 }
@@ -479,22 +685,10 @@ int main(int argc, char* argv[]) {
                 if (params.empty()) return "{\"error\": \"missing path\"}";
                 std::string path = params[0];
                 
-                std::lock_guard<std::mutex> lock(g_db_mutex);
-                const char* sql = "SELECT symbol_name, symbol_type, start_line FROM chunks c "
-                                  "JOIN files f ON c.file_id = f.id "
-                                  "WHERE f.path = ? AND symbol_name IS NOT NULL ORDER BY start_line;";
-                sqlite3_stmt* stmt;
                 nlohmann::json symbols = nlohmann::json::array();
-                if (sqlite3_prepare_v2(db.get_internal_db(), sql, -1, &stmt, nullptr) == SQLITE_OK) {
-                    sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_STATIC);
-                    while (sqlite3_step(stmt) == SQLITE_ROW) {
-                        symbols.push_back({
-                            {"name", reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0))},
-                            {"type", reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1))},
-                            {"line", sqlite3_column_int(stmt, 2)}
-                        });
-                    }
-                    sqlite3_finalize(stmt);
+                std::lock_guard<std::mutex> lock(g_db_mutex);
+                for (const auto& c : db.list_symbols(path)) {
+                    symbols.push_back({{"name", c.symbol_name}, {"type", c.symbol_type}, {"line", c.start_line}});
                 }
                 return nlohmann::json({{"result", symbols}}).dump();
             }
@@ -520,51 +714,135 @@ int main(int argc, char* argv[]) {
                 if (params.size() > 3 && params[3].is_string()) filters.language = params[3];
                 if (params.size() > 4 && params[4].is_string()) filters.scope = params[4];
                 
-                nlohmann::json res_json = nlohmann::json::array();
-                if (embedder && librarian) {
-                    auto vec = embedder->embed(q);
-                    if (!vec.empty()) {
-                        int candidate_limit = limit * 2;
-                        auto semantic_ids = librarian->search(vec, candidate_limit);
-                        
+                using Clock = std::chrono::steady_clock;
+                auto ms_since = [](Clock::time_point start) {
+                    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+                };
+                auto query_start = Clock::now();
+                auto to_json = [](const std::string& type, const kestr::engine::Chunk& c) {
+                    return nlohmann::json{{"type", type}, {"content", c.content}, {"lines", {c.start_line, c.end_line}}, {"symbol", c.symbol_name}, {"symbol_type", c.symbol_type}};
+                };
+
+                // Read the generation before searching: a commit landing meanwhile makes this result stale
+                uint64_t generation = query_cache.generation();
+                std::string cache_key = kestr::engine::QueryCache::result_key(q, limit, filters);
+                kestr::engine::QueryCache::Result cached;
+                if (query_cache.get_result(cache_key, generation, cached)) {
+                    nlohmann::json res_json = nlohmann::json::array();
+                    auto hydrate_start = Clock::now();
+                    std::vector<kestr::engine::Chunk> chunks;
+                    if (!cached.ids.empty()) {
                         std::lock_guard<std::mutex> lock(g_db_mutex);
-                        auto keyword_results = db.query(q, candidate_limit, filters);
-                        
-                        std::map<int64_t, double> rrf_scores;
-                        const double k = 60.0;
-                        
-                        for (size_t i = 0; i < semantic_ids.size(); ++i) {
-                            rrf_scores[semantic_ids[i]] += 1.0 / (k + i + 1);
-                        }
-                        for (size_t i = 0; i < keyword_results.size(); ++i) {
-                            rrf_scores[keyword_results[i].first] += 1.0 / (k + i + 1);
-                        }
-                        
-                        std::vector<std::pair<int64_t, double>> sorted_candidates(rrf_scores.begin(), rrf_scores.end());
-                        std::sort(sorted_candidates.begin(), sorted_candidates.end(), [](const auto& a, const auto& b) {
-                            return a.second > b.second;
-                        });
-                        
-                        for (size_t i = 0; i < sorted_candidates.size() && i < (size_t)limit; ++i) {
-                            int64_t id = sorted_candidates[i].first;
-                            auto c = db.get_chunk(id);
-                            
-                            if (!filters.type_filter.empty() && c.symbol_type != filters.type_filter) continue;
-                            if (!filters.language.empty() && c.language != filters.language) continue;
-                            if (!filters.scope.empty() && c.project_root != filters.scope) continue;
-                            
-                            res_json.push_back({{"type", "hybrid"}, {"content", c.content}, {"lines", {c.start_line, c.end_line}}, {"symbol", c.symbol_name}, {"symbol_type", c.symbol_type}});
+                        chunks = db.get_chunks(cached.ids);
+                    }
+                    double hydrate_ms = ms_since(hydrate_start);
+                    for (const auto& c : chunks) {
+                        if (!c.content.empty()) res_json.push_back(to_json(cached.type, c)); // Deleted since
+                    }
+                    nlohmann::json timings = {{"cached", true}, {"hydrate_ms", hydrate_ms}, {"total_ms", ms_since(query_start)}};
+                    return nlohmann::json({{"result", res_json}, {"timings", timings}}).dump();
+                }
+                int candidate_limit = limit * 2;
+
+                // Embedding and vector search run on their own thread while FTS runs here
+                double embed_ms = 0.0, vector_ms = 0.0;
+                bool embed_failed = false;
+                std::future<std::vector<kestr::engine::SearchHit>> semantic;
+                if (embedder && librarian) {
+                    semantic = std::async(std::launch::async, [&] {
+                        auto start = Clock::now();
+                        std::vector<float> vec;
+                        if (!query_cache.get_embedding(q, vec)) {
+                            vec = embedder->embed(q);
+                            query_cache.put_embedding(q, vec);
                         }
+                        embed_ms = ms_since(start);
+                        embed_failed = vec.empty();
+                        if (vec.empty()) return std::vector<kestr::engine::SearchHit>();
+                        start = Clock::now();
+                        auto hits = tiers ? tiers->search(vec, candidate_limit, filters)
+                                          : librarian->search_scored(vec, candidate_limit, filters);
+                        vector_ms = ms_since(start);
+                        return hits;
+                    });
+                }
+
+                auto keyword_start = Clock::now();
+                std::vector<std::pair<int64_t, kestr::engine::Chunk>> keyword_results;
+                {
+                    std::lock_guard<std::mutex> lock(g_db_mutex);
+                    keyword_results = db.query(q, candidate_limit, filters);
+                }
+                double keyword_ms = ms_since(keyword_start);
+                std::vector<kestr::engine::SearchHit> semantic_hits;
+                if (semantic.valid()) semantic_hits = semantic.get();
+
+                nlohmann::json res_json = nlohmann::json::array();
+                kestr::engine::QueryCache::Result computed;
+                double hydrate_ms = 0.0;
+                if (!semantic_hits.empty()) {
+                    std::map<int64_t, double> rrf_scores;
+                    const double k = 60.0;
+
+                    // Weight semantic ranks by similarity relative to the best hit, so a weak
+                    // tail of near-misses does not outvote strong keyword matches
+                    double best = semantic_hits[0].score;
+                    for (size_t i = 0; i < semantic_hits.size(); ++i) {
+                        double weight = best > 0.0 ? std::max(0.0, semantic_hits[i].score / best) : 1.0;
+                        rrf_scores[semantic_hits[i].id] += weight / (k + i + 1);
+                    }
+                    for (size_t i = 0; i < keyword_results.size(); ++i) {
+                        rrf_scores[keyword_results[i].first] += 1.0 / (k + i + 1);
+                    }
+
+                    std::vector<std::pair<int64_t, double>> sorted_candidates(rrf_scores.begin(), rrf_scores.end());
+                    std::sort(sorted_candidates.begin(), sorted_candidates.end(), [](const auto& a, const auto& b) {
+                        return a.second > b.second;
+                    });
+                    if (sorted_candidates.size() > (size_t)limit) sorted_candidates.resize(limit);
+
+                    // FTS rows already carry their chunk; the rest is fetched in one batch.
+                    // Both sources already applied the filters.
+                    std::map<int64_t, const kestr::engine::Chunk*> known;
+                    for (const auto& [id, chunk] : keyword_results) known.emplace(id, &chunk);
+                    std::vector<int64_t> missing;
+                    for (const auto& [id, score] : sorted_candidates) {
+                        if (!known.count(id)) missing.push_back(id);
+                    }
+                    auto hydrate_start = Clock::now();
+                    std::vector<kestr::engine::Chunk> fetched;
+                    if (!missing.empty()) {
+                        std::lock_guard<std::mutex> lock(g_db_mutex);
+                        fetched = db.get_chunks(missing);
+                    }
+                    hydrate_ms = ms_since(hydrate_start);
+                    for (size_t i = 0; i < missing.size(); ++i) known.emplace(missing[i], &fetched[i]);
+
+                    computed.type = "hybrid";
+                    for (const auto& [id, score] : sorted_candidates) {
+                        // The vector index can still hold a chunk whose row was deleted meanwhile
+                        if (known[id]->content.empty()) continue;
+                        res_json.push_back(to_json(computed.type, *known[id]));
+                        computed.ids.push_back(id);
                     }
                 }
                 if (res_json.empty()) {
-                    std::lock_guard<std::mutex> lock(g_db_mutex);
-                    for (const auto& pair : db.query(q, limit, filters)) {
-                        const auto& c = pair.second;
-                        res_json.push_back({{"type", "keyword"}, {"content", c.content}, {"lines", {c.start_line, c.end_line}}, {"symbol", c.symbol_name}, {"symbol_type", c.symbol_type}});
+                    computed.type = "keyword";
+                    for (size_t i = 0; i < keyword_results.size() && i < (size_t)limit; ++i) {
+                        res_json.push_back(to_json(computed.type, keyword_results[i].second));
+                        computed.ids.push_back(keyword_results[i].first);
                     }
                 }
-                return nlohmann::json({{"result", res_json}}).dump();
+                // A keyword-only fallback after a failed embedding is not the answer to cache
+                if (!embed_failed) query_cache.put_result(cache_key, generation, std::move(computed));
+                nlohmann::json timings = {
+                    {"embed_ms", embed_ms},
+                    {"vector_ms", vector_ms},
+                    {"keyword_ms", keyword_ms},
+                    {"hydrate_ms", hydrate_ms},
+                    {"total_ms", ms_since(query_start)}
+                };
+                return nlohmann::json({{"result", res_json}, {"timings", timings}}).dump();
             }
         } catch (...) { return "{\"error\": \"error\"}"; }
         return "{\"error\": \"unknown\"}";
@@ -601,8 +879,19 @@ int main(int argc, char* argv[]) {
                 }
             } catch (...) {} 
          } else {
-            std::lock_guard<std::mutex> lock(g_db_mutex);
-            db.remove_file(event.path);
+            std::vector<int64_t> removed_ids;
+            {
+                std::lock_guard<std::mutex> lock(g_db_mutex);
+                db.remove_file(event.path, &removed_ids);
+            }
+            if (librarian) {
+                std::lock_guard<std::mutex> lock(librarian_mutex);
+                for (int64_t id : removed_ids) {
+                    librarian->remove_item(id);
+                    if (tiers) tiers->record_remove(id);
+                }
+            }
+            query_cache.advance_generation();
          }
     });
 
@@ -615,12 +904,27 @@ int main(int argc, char* argv[]) {
     std::thread bridge_thread([&]() { bridge->listen("kestr.sock"); bridge->run(); });
     std::thread sentry_thread([&]() { sentry->start(); });
 #ifndef KESTR_PLATFORM_WINDOWS
-    std::thread web_thread([&]() { start_web_server(8080, db, librarian, queue, config); });
+    std::thread web_thread([&]() { start_web_server(8080, db, librarian, queue, pipeline, config); });
 #endif
 
-    while (g_running) std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    auto last_checkpoint = std::chrono::steady_clock::now();
+    auto last_rebalance = last_checkpoint;
+    while (g_running) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (tiers && std::chrono::steady_clock::now() - last_rebalance >= std::chrono::seconds(1)) {
+            std::lock_guard<std::mutex> lock(librarian_mutex);
+            tiers->rebalance();
+            last_rebalance = std::chrono::steady_clock::now();
+        }
+        if (config.snapshot_interval > 0 &&
+            std::chrono::steady_clock::now() - last_checkpoint >= std::chrono::seconds(config.snapshot_interval)) {
+            checkpoint();
+            last_checkpoint = std::chrono::steady_clock::now();
+        }
+    }
 
-    queue.stop(); sentry->stop(); bridge->stop();
+    pipeline.stop(); writer.stop(); sentry->stop(); bridge->stop();
+    checkpoint();
     if (bridge_thread.joinable()) bridge_thread.join();
     if (sentry_thread.joinable()) sentry_thread.join();
 #ifndef KESTR_PLATFORM_WINDOWS
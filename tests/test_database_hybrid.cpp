@@ -82,10 +82,131 @@ void test_migration() {
     std::filesystem::remove(db_path);
 }
 
+void test_statement_reuse() {
+    std::cout << "Testing cached statement reuse..." << std::endl;
+    std::filesystem::path db_path = "test_reuse.db";
+    if (std::filesystem::exists(db_path)) std::filesystem::remove(db_path);
+
+    Database db;
+    assert(db.open(db_path));
+
+    FileInfo info;
+    info.path = "shapes.py";
+    info.hash = "ghi";
+    info.size = 10;
+    info.last_write_time = std::filesystem::file_time_type::clock::now();
+    assert(db.update_file(info));
+
+    Chunk square{"def area_square(): pass", 1, 1, "area_square", "function", "/tmp/a", "python"};
+    Chunk circle{"class area_circle: pass", 2, 2, "area_circle", "class", "/tmp/b", "python"};
+    auto ids = db.insert_chunks("shapes.py", {square, circle}, {{}, {}});
+    assert(ids.size() == 2);
+    assert(db.set_indexed_status("shapes.py", true));
+
+    // The same statements are re-bound on every call; stale bindings must not leak
+    for (int i = 0; i < 3; ++i) {
+        SearchFilters functions;
+        functions.type_filter = "function";
+        auto results = db.query("area_square OR area_circle", 5, functions);
+        assert(results.size() == 1 && results[0].second.symbol_name == "area_square");
+
+        SearchFilters scoped;
+        scoped.scope = "/tmp/b";
+        results = db.query("area_square OR area_circle", 5, scoped);
+        assert(results.size() == 1 && results[0].second.symbol_name == "area_circle");
+
+        assert(db.query("area_square OR area_circle", 5).size() == 2);
+        assert(db.get_chunk(ids[1]).symbol_name == "area_circle");
+        assert(!db.check_metadata("shapes.py", 10, std::chrono::duration_cast<std::chrono::milliseconds>(info.last_write_time.time_since_epoch()).count()));
+    }
+
+    auto symbols = db.list_symbols("shapes.py");
+    assert(symbols.size() == 2 && symbols[0].symbol_name == "area_square");
+
+    std::cout << "Statement reuse test passed!" << std::endl;
+    db.close();
+    std::filesystem::remove(db_path);
+}
+
+void test_wipe_requeues_files() {
+    std::cout << "Testing that a wipe re-queues every file..." << std::endl;
+    std::filesystem::path db_path = "test_wipe.db";
+    if (std::filesystem::exists(db_path)) std::filesystem::remove(db_path);
+
+    Database db;
+    assert(db.open(db_path));
+
+    auto now = std::filesystem::file_time_type::clock::now();
+    int64_t mtime = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+    std::vector<std::string> paths{"a.py", "b.py", "c.py"};
+    for (const auto& path : paths) {
+        FileInfo info;
+        info.path = path;
+        info.hash = "h";
+        info.size = 10;
+        info.last_write_time = now;
+        assert(db.update_file(info));
+        // Written but not committed as indexed yet: the next scan must pick it up
+        assert(db.check_metadata(path, 10, mtime));
+        Chunk chunk{"def " + path.substr(0, 1) + "(): pass", 1, 1, path.substr(0, 1), "function", "/tmp/a", "python"};
+        assert(db.insert_chunks(path, {chunk}, {{0.5f, 0.5f}}).size() == 1);
+        assert(db.set_indexed_status(path, true));
+        assert(!db.check_metadata(path, 10, mtime));
+    }
+
+    // A model change wipes every chunk; unchanged files must still be queued again
+    db.wipe_all_chunks();
+    assert(db.count_chunks() == 0);
+    for (const auto& path : paths) assert(db.check_metadata(path, 10, mtime));
+
+    std::cout << "Wipe re-queue test passed!" << std::endl;
+    db.close();
+    std::filesystem::remove(db_path);
+}
+
+void test_get_chunks() {
+    std::cout << "Testing batched chunk retrieval..." << std::endl;
+    std::filesystem::path db_path = "test_get_chunks.db";
+    if (std::filesystem::exists(db_path)) std::filesystem::remove(db_path);
+
+    Database db;
+    assert(db.open(db_path));
+
+    FileInfo info;
+    info.path = "many.py";
+    info.hash = "jkl";
+    info.size = 10;
+    info.last_write_time = std::filesystem::file_time_type::clock::now();
+    assert(db.update_file(info));
+
+    // More chunks than one statement takes, so the lookup spans several
+    std::vector<Chunk> chunks;
+    for (int i = 0; i < 70; ++i) chunks.push_back({"def f" + std::to_string(i) + "(): pass", i, i, "f" + std::to_string(i), "function", "/tmp/a", "python"});
+    auto ids = db.insert_chunks("many.py", chunks, std::vector<std::vector<float>>(chunks.size()));
+    assert(ids.size() == 70);
+
+    std::vector<int64_t> wanted{ids[69], ids[3], -1, ids[3]};
+    for (int i = 0; i < 40; ++i) wanted.push_back(ids[i]);
+    auto fetched = db.get_chunks(wanted);
+    assert(fetched.size() == wanted.size());
+    assert(fetched[0].symbol_name == "f69" && fetched[0].start_line == 69);
+    assert(fetched[1].symbol_name == "f3" && fetched[3].symbol_name == "f3");
+    assert(fetched[2].content.empty()); // Unknown ID
+    for (int i = 0; i < 40; ++i) assert(fetched[4 + i].symbol_name == "f" + std::to_string(i));
+    assert(db.get_chunks({}).empty());
+
+    std::cout << "Batched retrieval test passed!" << std::endl;
+    db.close();
+    std::filesystem::remove(db_path);
+}
+
 int main() {
     try {
         test_new_db();
         test_migration();
+        test_statement_reuse();
+        test_get_chunks();
+        test_wipe_requeues_files();
         std::cout << "All hybrid database tests passed!" << std::endl;
     } catch (const std::exception& e) {
         std::cerr << "Test failed: " << e.what() << std::endl;
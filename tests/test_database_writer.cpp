@@ -0,0 +1,398 @@
+#include <iostream>
+#include <filesystem>
+#include <cassert>
+#include <mutex>
+#include <vector>
+#include <sqlite3.h>
+#include "engine/database.hpp"
+#include "engine/database_writer.hpp"
+
+using namespace kestr::engine;
+
+WriteBatch make_batch(const std::string& path, const std::string& symbol) {
+    WriteBatch batch;
+    batch.info.path = path;
+    batch.info.hash = "hash_" + symbol;
+    batch.info.size = 10;
+    batch.info.last_write_time = std::filesystem::file_time_type::clock::now();
+
+    Chunk chunk;
+    chunk.content = "int " + symbol + "() { return 0; }";
+    chunk.start_line = 1;
+    chunk.end_line = 1;
+    chunk.symbol_name = symbol;
+    chunk.symbol_type = "function";
+    batch.chunks.push_back(chunk);
+    batch.embeddings.push_back({0.1f, 0.2f, 0.3f});
+    batch.calls.push_back({0, "helper"});
+    return batch;
+}
+
+void test_group_commit() {
+    std::cout << "Testing group commit..." << std::endl;
+    std::filesystem::path db_path = "test_writer.db";
+    if (std::filesystem::exists(db_path)) std::filesystem::remove(db_path);
+
+    Database db;
+    assert(db.open(db_path));
+    std::mutex db_mutex;
+
+    WriterOptions options;
+    options.max_group_files = 16;
+    options.max_latency = std::chrono::milliseconds(200);
+    DatabaseWriter writer(db, db_mutex, options);
+
+    size_t hooked = 0;
+    writer.set_commit_hook([&](const std::vector<WriteBatch>& batches, const std::vector<WriteResult>& results) {
+        assert(batches.size() == results.size());
+        hooked += batches.size();
+    });
+    writer.start();
+
+    std::vector<std::future<WriteResult>> futures;
+    for (int i = 0; i < 40; ++i) {
+        futures.push_back(writer.submit(make_batch("file" + std::to_string(i) + ".cpp", "func" + std::to_string(i))));
+    }
+    for (auto& f : futures) {
+        auto result = f.get();
+        assert(result.ok);
+        assert(result.chunk_ids.size() == 1);
+    }
+
+    assert(writer.files_written() == 40);
+    assert(hooked == 40);
+    // 40 files with groups of up to 16 must not need one commit per file
+    assert(writer.commits() < 40);
+
+    {
+        std::lock_guard<std::mutex> lock(db_mutex);
+        assert(db.count_files() == 40);
+        assert(db.count_chunks() == 40);
+        assert(db.find_references("helper").size() == 40);
+    }
+
+    writer.stop();
+    std::cout << "Group commit test passed!" << std::endl;
+    db.close();
+    std::filesystem::remove(db_path);
+}
+
+void test_latency_flush() {
+    std::cout << "Testing latency-bound flush..." << std::endl;
+    std::filesystem::path db_path = "test_writer_latency.db";
+    if (std::filesystem::exists(db_path)) std::filesystem::remove(db_path);
+
+    Database db;
+    assert(db.open(db_path));
+    std::mutex db_mutex;
+
+    WriterOptions options;
+    options.max_group_files = 1000;
+    options.max_latency = std::chrono::milliseconds(20);
+    DatabaseWriter writer(db, db_mutex, options);
+    writer.start();
+
+    // A single file must still be committed once the latency budget expires
+    auto result = writer.submit(make_batch("single.cpp", "single")).get();
+    assert(result.ok);
+    assert(writer.commits() == 1);
+
+    writer.stop();
+    std::cout << "Latency-bound flush test passed!" << std::endl;
+    db.close();
+    std::filesystem::remove(db_path);
+}
+
+void test_reindex_replaces_chunks() {
+    std::cout << "Testing re-index replaces stale chunks..." << std::endl;
+    std::filesystem::path db_path = "test_writer_reindex.db";
+    if (std::filesystem::exists(db_path)) std::filesystem::remove(db_path);
+
+    Database db;
+    assert(db.open(db_path));
+    std::mutex db_mutex;
+    DatabaseWriter writer(db, db_mutex);
+    writer.start();
+
+    auto first = writer.submit(make_batch("edit.cpp", "before_edit")).get();
+    assert(first.ok && first.removed_ids.empty());
+
+    auto second = writer.submit(make_batch("edit.cpp", "after_edit")).get();
+    assert(second.ok);
+    assert(second.removed_ids == first.chunk_ids);
+
+    {
+        std::lock_guard<std::mutex> lock(db_mutex);
+        assert(db.count_chunks() == 1);
+        assert(db.query("before_edit", 5).empty());
+        assert(db.query("after_edit", 5).size() == 1);
+        assert(db.find_references("helper").size() == 1);
+
+        std::vector<int64_t> removed;
+        assert(db.remove_file("edit.cpp", &removed));
+        assert(removed == second.chunk_ids);
+        assert(db.count_chunks() == 0);
+        assert(db.count_files() == 0);
+        assert(db.query("after_edit", 5).empty());
+    }
+
+    writer.stop();
+    std::cout << "Re-index replacement test passed!" << std::endl;
+    db.close();
+    std::filesystem::remove(db_path);
+}
+
+void test_unchanged_chunks_reused() {
+    std::cout << "Testing unchanged chunks keep their rows..." << std::endl;
+    std::filesystem::path db_path = "test_writer_reuse.db";
+    if (std::filesystem::exists(db_path)) std::filesystem::remove(db_path);
+
+    Database db;
+    assert(db.open(db_path));
+    std::mutex db_mutex;
+    DatabaseWriter writer(db, db_mutex);
+    writer.start();
+
+    auto batch = make_batch("reuse.cpp", "stable");
+    batch.chunks[0].content_hash = "h_stable";
+    auto extra = make_batch("reuse.cpp", "dropped");
+    extra.chunks[0].content_hash = "h_dropped";
+    batch.chunks.push_back(extra.chunks[0]);
+    batch.embeddings.push_back({0.4f, 0.5f, 0.6f});
+    auto first = writer.submit(batch).get();
+    assert(first.ok && first.chunk_ids.size() == 2);
+
+    {
+        std::lock_guard<std::mutex> lock(db_mutex);
+        auto known = db.get_embedded_chunk_hashes("reuse.cpp");
+        assert(known.size() == 2 && known["h_stable"] == 1 && known["h_dropped"] == 1);
+    }
+
+    // Second version: "stable" moved down and is sent without a vector, "dropped" is gone, one new chunk
+    auto edit = make_batch("reuse.cpp", "stable");
+    edit.chunks[0].content_hash = "h_stable";
+    edit.chunks[0].start_line = 10;
+    edit.chunks[0].end_line = 12;
+    edit.embeddings[0].clear();
+    auto added = make_batch("reuse.cpp", "added");
+    added.chunks[0].content_hash = "h_added";
+    edit.chunks.push_back(added.chunks[0]);
+    edit.embeddings.push_back({0.7f, 0.8f, 0.9f});
+    auto second = writer.submit(edit).get();
+    assert(second.ok && second.chunk_ids.size() == 2);
+    assert(second.chunk_ids[0] == first.chunk_ids[0]);
+    assert(second.chunk_ids[1] != first.chunk_ids[1]);
+    assert(second.removed_ids == std::vector<int64_t>{first.chunk_ids[1]});
+
+    {
+        std::lock_guard<std::mutex> lock(db_mutex);
+        assert(db.count_chunks() == 2);
+        Chunk kept = db.get_chunk(first.chunk_ids[0]);
+        assert(kept.start_line == 10 && kept.end_line == 12);
+        assert(db.query("dropped", 5).empty());
+        assert(db.query("added", 5).size() == 1);
+        assert(db.find_references("helper").size() == 1);
+
+        size_t vectors = 0;
+        db.for_each_vector([&](int64_t id, const std::vector<float>& v) {
+            if (id == first.chunk_ids[0]) assert(v.size() == 3 && v[0] == 0.1f);
+            ++vectors;
+        });
+        assert(vectors == 2);
+    }
+
+    writer.stop();
+    std::cout << "Chunk reuse test passed!" << std::endl;
+    db.close();
+    std::filesystem::remove(db_path);
+}
+
+void test_duplicate_chunks_keep_vectors() {
+    std::cout << "Testing duplicated content gets a vector per copy..." << std::endl;
+    std::filesystem::path db_path = "test_writer_dup.db";
+    if (std::filesystem::exists(db_path)) std::filesystem::remove(db_path);
+
+    Database db;
+    assert(db.open(db_path));
+    std::mutex db_mutex;
+    DatabaseWriter writer(db, db_mutex);
+    std::vector<std::filesystem::path> requeued;
+    writer.set_requeue_hook([&](const FileInfo& info) { requeued.push_back(info.path); });
+    writer.start();
+
+    auto one = make_batch("dup.cpp", "twin");
+    one.chunks[0].content_hash = "h_twin";
+    assert(writer.submit(one).get().ok);
+
+    // Second version holds the same content twice; like the embed stage, skip only as
+    // many copies as there are stored vectors and embed the rest
+    auto two = make_batch("dup.cpp", "twin");
+    two.chunks[0].content_hash = "h_twin";
+    two.chunks.push_back(two.chunks[0]);
+    two.embeddings.push_back({0.4f, 0.5f, 0.6f});
+    two.reused.assign(2, false);
+    {
+        std::lock_guard<std::mutex> lock(db_mutex);
+        auto known = db.get_embedded_chunk_hashes("dup.cpp");
+        assert(known.size() == 1 && known["h_twin"] == 1);
+        size_t skip = known["h_twin"];
+        for (size_t i = 0; i < two.embeddings.size() && skip > 0; ++i, --skip) {
+            two.embeddings[i].clear();
+            two.reused[i] = true;
+        }
+    }
+    auto second = writer.submit(two).get();
+    assert(second.ok && second.chunk_ids.size() == 2 && second.missing_vectors == 0);
+    {
+        std::lock_guard<std::mutex> lock(db_mutex);
+        auto known = db.get_embedded_chunk_hashes("dup.cpp");
+        assert(known["h_twin"] == 2);
+    }
+
+    // Back to one copy sent without a vector: the row that keeps its vector is the one kept
+    {
+        std::lock_guard<std::mutex> lock(db_mutex);
+        sqlite3* raw = nullptr;
+        assert(sqlite3_open(db_path.string().c_str(), &raw) == SQLITE_OK);
+        std::string sql = "UPDATE chunks SET embedding = NULL WHERE id = " + std::to_string(second.chunk_ids[0]) + ";";
+        assert(sqlite3_exec(raw, sql.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK);
+        sqlite3_close(raw);
+    }
+    auto three = make_batch("dup.cpp", "twin");
+    three.chunks[0].content_hash = "h_twin";
+    three.embeddings[0].clear();
+    three.reused = {true};
+    auto third = writer.submit(three).get();
+    assert(third.ok && third.missing_vectors == 0);
+    assert(third.chunk_ids[0] == second.chunk_ids[1]);
+    assert(third.removed_ids == std::vector<int64_t>{second.chunk_ids[0]});
+
+    // A copy whose stored vector is gone by the time it is written goes round again
+    auto four = make_batch("dup.cpp", "twin");
+    four.chunks[0].content_hash = "h_twin";
+    four.chunks.push_back(four.chunks[0]);
+    four.embeddings = {{}, {}};
+    four.reused = {true, true};
+    auto fourth = writer.submit(four).get();
+    assert(fourth.ok && fourth.missing_vectors == 1);
+    assert(requeued == std::vector<std::filesystem::path>{"dup.cpp"});
+
+    // A chunk the embedder failed on is not sent round again, it would only fail again
+    auto five = make_batch("dup.cpp", "failed");
+    five.chunks[0].content_hash = "h_failed";
+    five.embeddings[0].clear();
+    five.reused = {false};
+    auto fifth = writer.submit(five).get();
+    assert(fifth.ok && fifth.missing_vectors == 0);
+    assert(requeued.size() == 1);
+
+    writer.stop();
+    std::cout << "Duplicate chunk test passed!" << std::endl;
+    db.close();
+    std::filesystem::remove(db_path);
+}
+
+void test_failed_file_rolls_back() {
+    std::cout << "Testing a failed file leaves no partial rows..." << std::endl;
+    std::filesystem::path db_path = "test_writer_rollback.db";
+    if (std::filesystem::exists(db_path)) std::filesystem::remove(db_path);
+
+    Database db;
+    assert(db.open(db_path));
+    std::mutex db_mutex;
+    WriterOptions options;
+    options.max_group_files = 2;
+    options.max_latency = std::chrono::milliseconds(200);
+    DatabaseWriter writer(db, db_mutex, options);
+    writer.start();
+    assert(writer.submit(make_batch("bad.cpp", "original")).get().ok);
+
+    // Make the second chunk insert of the next version fail
+    sqlite3* raw = nullptr;
+    assert(sqlite3_open(db_path.string().c_str(), &raw) == SQLITE_OK);
+    assert(sqlite3_exec(raw, "CREATE TRIGGER poison BEFORE INSERT ON chunks WHEN NEW.content LIKE '%poison%' "
+                             "BEGIN SELECT RAISE(ABORT, 'poison'); END;", nullptr, nullptr, nullptr) == SQLITE_OK);
+    sqlite3_close(raw);
+
+    auto bad = make_batch("bad.cpp", "replacement");
+    bad.info.size = 20;
+    bad.chunks.push_back(make_batch("bad.cpp", "poison").chunks[0]);
+    bad.embeddings.push_back({0.4f, 0.5f, 0.6f});
+    auto bad_future = writer.submit(bad);
+    auto good_future = writer.submit(make_batch("good.cpp", "good"));
+    assert(!bad_future.get().ok);
+    assert(good_future.get().ok); // Same group, still committed
+
+    {
+        std::lock_guard<std::mutex> lock(db_mutex);
+        assert(db.count_files() == 2);
+        assert(db.count_chunks() == 2);
+        assert(db.query("original", 5).size() == 1);
+        assert(db.query("replacement", 5).empty());
+        // The old version stays on record, so the file is picked up again
+        int64_t mtime = std::chrono::duration_cast<std::chrono::milliseconds>(bad.info.last_write_time.time_since_epoch()).count();
+        assert(db.check_metadata("bad.cpp", 20, mtime));
+    }
+
+    writer.stop();
+    std::cout << "Rollback test passed!" << std::endl;
+    db.close();
+    std::filesystem::remove(db_path);
+}
+
+void test_refused_commit_requeues() {
+    std::cout << "Testing a refused group commit hands the files back..." << std::endl;
+    std::filesystem::path db_path = "test_writer_refused.db";
+    if (std::filesystem::exists(db_path)) std::filesystem::remove(db_path);
+
+    Database db;
+    assert(db.open(db_path));
+    std::mutex db_mutex;
+    DatabaseWriter writer(db, db_mutex);
+    std::vector<std::filesystem::path> requeued;
+    writer.set_requeue_hook([&](const FileInfo& info) { requeued.push_back(info.path); });
+    writer.start();
+
+    // Every COMMIT turns into a rollback while the hook refuses it
+    {
+        std::lock_guard<std::mutex> lock(db_mutex);
+        sqlite3_commit_hook(db.get_internal_db(), [](void*) { return 1; }, nullptr);
+    }
+    assert(!writer.submit(make_batch("refused.cpp", "refused")).get().ok);
+    assert(requeued == std::vector<std::filesystem::path>{"refused.cpp"});
+
+    // A database that keeps refusing does not get the file back forever
+    for (int round = 0; round < 3; ++round) {
+        assert(!writer.submit(make_batch("refused.cpp", "refused")).get().ok);
+    }
+    assert(requeued.size() == 3);
+    {
+        std::lock_guard<std::mutex> lock(db_mutex);
+        sqlite3_commit_hook(db.get_internal_db(), nullptr, nullptr);
+        assert(db.count_files() == 0);
+    }
+
+    // Once the database takes commits again the file goes through
+    assert(writer.submit(make_batch("refused.cpp", "refused")).get().ok);
+    writer.stop();
+    std::cout << "Refused commit test passed!" << std::endl;
+    db.close();
+    std::filesystem::remove(db_path);
+}
+
+int main() {
+    try {
+        test_group_commit();
+        test_latency_flush();
+        test_reindex_replaces_chunks();
+        test_unchanged_chunks_reused();
+        test_duplicate_chunks_keep_vectors();
+        test_failed_file_rolls_back();
+        test_refused_commit_requeues();
+        std::cout << "All DatabaseWriter tests passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
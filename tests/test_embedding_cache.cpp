@@ -0,0 +1,139 @@
+#include <iostream>
+#include <filesystem>
+#include <cassert>
+#include <mutex>
+#include <vector>
+#include "engine/database.hpp"
+#include "engine/embedding_cache.hpp"
+
+using namespace kestr::engine;
+
+// Counts how many texts actually reach the backend
+class CountingEmbedder : public Embedder {
+public:
+    explicit CountingEmbedder(std::string model) : m_model(std::move(model)) {}
+
+    std::vector<float> embed(const std::string& text) override {
+        ++calls;
+        if (text == "fail") return {};
+        return {static_cast<float>(text.size()), static_cast<float>(m_model.size()), 1.0f};
+    }
+    size_t dimension() const override { return 3; }
+    std::string model_id() const override { return m_model; }
+
+    size_t calls = 0;
+
+private:
+    std::string m_model;
+};
+
+void test_normalize_and_keys() {
+    std::cout << "Testing normalization and keys..." << std::endl;
+    assert(CachingEmbedder::normalize("a  \r\nb\t\n\n\n") == "a\nb");
+    assert(CachingEmbedder::normalize("  indented\n") == "  indented"); // Leading whitespace is meaningful
+    assert(CachingEmbedder::cache_key("m", "x\r\ny\n") == CachingEmbedder::cache_key("m", "x\ny"));
+    assert(CachingEmbedder::cache_key("m", "x") != CachingEmbedder::cache_key("n", "x"));
+    assert(CachingEmbedder::cache_key("a", "bc") != CachingEmbedder::cache_key("ab", "c"));
+    std::cout << "Normalization test passed!" << std::endl;
+}
+
+void test_memory_disk_and_dedup() {
+    std::cout << "Testing cache tiers and in-batch dedup..." << std::endl;
+    std::filesystem::path db_path = "test_embedding_cache.db";
+    if (std::filesystem::exists(db_path)) std::filesystem::remove(db_path);
+    Database db;
+    assert(db.open(db_path));
+    std::mutex db_mutex;
+
+    CountingEmbedder backend("test:model");
+    {
+        CachingEmbedder cache(backend, db, db_mutex, 2);
+        // Duplicates within one batch reach the backend once
+        auto first = cache.embed_batch({"license header", "license header\r\n", "main()", "fail"});
+        assert(backend.calls == 3);
+        assert(first[0] == first[1] && !first[0].empty());
+        assert(first[3].empty());
+        assert(cache.misses() == 3);
+
+        // Served from memory now; failures are retried
+        auto again = cache.embed_batch({"license header", "main()", "fail"});
+        assert(backend.calls == 4);
+        assert(again[0] == first[0] && again[1] == first[2]);
+        assert(cache.memory_hits() == 2);
+    }
+
+    // A fresh process only has the database
+    {
+        CachingEmbedder cache(backend, db, db_mutex, 2);
+        auto vec = cache.embed("license header  \n");
+        assert(backend.calls == 4 && vec.size() == 3);
+        assert(cache.disk_hits() == 1 && cache.memory_hits() == 0);
+    }
+
+    // Another model never sees these vectors
+    CountingEmbedder other("test:other");
+    CachingEmbedder other_cache(other, db, db_mutex);
+    other_cache.embed("license header");
+    assert(other.calls == 1);
+
+    // Trimming keeps the newest rows
+    {
+        std::lock_guard<std::mutex> lock(db_mutex);
+        assert(db.trim_embedding_cache(1) == 2);
+        assert(db.get_cached_embeddings({CachingEmbedder::cache_key("test:other", "license header")}).size() == 1);
+    }
+
+    // Re-written keys leave rowid gaps; the limit still counts rows
+    {
+        std::lock_guard<std::mutex> lock(db_mutex);
+        assert(db.put_cached_embeddings({{"a", {1.0f}}, {"b", {2.0f}}, {"c", {3.0f}}}));
+        assert(db.put_cached_embeddings({{"a", {1.0f}}}));
+        assert(db.put_cached_embeddings({{"a", {1.0f}}}));
+        assert(db.trim_embedding_cache(2) == 2);
+        auto kept = db.get_cached_embeddings({"a", "b", "c"});
+        assert(kept.size() == 2 && kept.count("a") && kept.count("c"));
+    }
+
+    db.close();
+    std::filesystem::remove(db_path);
+    std::cout << "Cache tier test passed!" << std::endl;
+}
+
+void test_uncached_backend() {
+    std::cout << "Testing backends without a model id..." << std::endl;
+    Database db;
+    assert(db.open(":memory:"));
+    std::mutex db_mutex;
+    CountingEmbedder backend("");
+    CachingEmbedder cache(backend, db, db_mutex);
+    cache.embed("same");
+    cache.embed("same");
+    assert(backend.calls == 2 && cache.misses() == 0);
+    std::cout << "Uncached backend test passed!" << std::endl;
+}
+
+void test_request_batches() {
+    std::cout << "Testing request batch planning..." << std::endl;
+    std::vector<std::string> texts{"aaaa", "bb", "cccccccccc", "d", "e", "f"};
+    using Ranges = std::vector<std::pair<size_t, size_t>>;
+    assert(plan_request_batches(texts, 100, 1000) == (Ranges{{0, 6}}));
+    assert(plan_request_batches(texts, 2, 1000) == (Ranges{{0, 2}, {2, 4}, {4, 6}}));
+    // The oversized text goes alone, nothing is dropped
+    assert(plan_request_batches(texts, 100, 6) == (Ranges{{0, 2}, {2, 3}, {3, 6}}));
+    assert(plan_request_batches({}, 10, 10).empty());
+    std::cout << "Request batch test passed!" << std::endl;
+}
+
+int main() {
+    try {
+        test_normalize_and_keys();
+        test_memory_disk_and_dedup();
+        test_uncached_backend();
+        test_request_batches();
+        std::cout << "All EmbeddingCache tests passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
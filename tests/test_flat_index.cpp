@@ -0,0 +1,207 @@
+#include <iostream>
+#include <filesystem>
+#include <fstream>
+#include <cassert>
+#include <cmath>
+#include <random>
+#include <algorithm>
+#include <thread>
+#include "engine/flat_index.hpp"
+#include "engine/librarian.hpp"
+
+using namespace kestr::engine;
+
+std::vector<std::vector<float>> random_vectors(size_t n, size_t dim, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    std::vector<std::vector<float>> out(n, std::vector<float>(dim));
+    for (auto& v : out) for (auto& x : v) x = dist(rng);
+    return out;
+}
+
+// Reference top-k by squared L2 in plain double precision
+std::vector<size_t> brute_force(const std::vector<std::vector<float>>& data, const std::vector<float>& q, size_t k) {
+    std::vector<std::pair<double, size_t>> all;
+    for (size_t i = 0; i < data.size(); ++i) {
+        double d = 0.0;
+        for (size_t j = 0; j < q.size(); ++j) d += (data[i][j] - q[j]) * (data[i][j] - q[j]);
+        all.emplace_back(d, i);
+    }
+    std::partial_sort(all.begin(), all.begin() + k, all.end());
+    std::vector<size_t> ids;
+    for (size_t i = 0; i < k; ++i) ids.push_back(all[i].second);
+    return ids;
+}
+
+std::vector<size_t> ids_of(const std::vector<std::pair<float, size_t>>& hits) {
+    std::vector<size_t> ids;
+    for (const auto& h : hits) ids.push_back(h.second);
+    return ids;
+}
+
+void test_exact_results() {
+    std::cout << "Testing exact search..." << std::endl;
+    auto data = random_vectors(2000, 37, 1);
+    FlatIndex index(37, Metric::L2, 1);
+    for (size_t i = 0; i < data.size(); ++i) index.add(i, data[i]);
+    assert(index.size() == 2000);
+
+    auto queries = random_vectors(20, 37, 2);
+    for (const auto& q : queries) {
+        auto hits = index.search(q.data(), 10);
+        assert(hits.size() == 10);
+        assert(ids_of(hits) == brute_force(data, q, 10));
+        for (size_t i = 1; i < hits.size(); ++i) assert(hits[i - 1].first <= hits[i].first);
+    }
+
+    // Filtered scans only return accepted ids
+    auto even = index.search(queries[0].data(), 5, [](size_t id) { return id % 2 == 0; });
+    assert(even.size() == 5);
+    for (const auto& [d, id] : even) assert(id % 2 == 0);
+    std::cout << "Exact search test passed!" << std::endl;
+}
+
+void test_update_remove_persist() {
+    std::cout << "Testing remove, update and persistence..." << std::endl;
+    FlatIndex index(4, Metric::Cosine, 1);
+    index.add(1, std::vector<float>{1, 0, 0, 0});
+    index.add(2, std::vector<float>{0, 1, 0, 0});
+    index.add(3, std::vector<float>{0, 0, 1, 0});
+    index.remove(1);
+    assert(index.size() == 2);
+    assert(!index.find(1) && index.find(3));
+
+    std::vector<float> q{1, 0, 0, 0};
+    auto hits = index.search(q.data(), 3);
+    auto ids = ids_of(hits);
+    assert(ids.size() == 2 && std::find(ids.begin(), ids.end(), 1) == ids.end());
+
+    index.add(3, std::vector<float>{1, 0, 0, 0}); // Update in place
+    assert(index.size() == 2);
+    hits = index.search(q.data(), 1);
+    assert(hits[0].second == 3 && std::abs(hits[0].first) < 1e-6f);
+
+    std::filesystem::path path = "test_flat.idx";
+    assert(index.save(path));
+    FlatIndex loaded(4, Metric::Cosine, 1);
+    assert(loaded.load(path));
+    assert(loaded.size() == 2 && loaded.search(q.data(), 1)[0].second == 3);
+    FlatIndex other(4, Metric::L2, 1);
+    assert(!other.load(path)); // Another metric must not pick it up
+
+    // A count the file cannot hold is rejected before anything is allocated
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(3 * sizeof(uint64_t));
+        uint64_t count = UINT64_MAX / 2;
+        file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    }
+    assert(!loaded.load(path));
+    assert(loaded.size() == 2);
+    std::filesystem::remove(path);
+    std::cout << "Remove/update/persistence test passed!" << std::endl;
+}
+
+void test_parallel_scan() {
+    std::cout << "Testing parallel scan..." << std::endl;
+    auto data = random_vectors(40000, 16, 3);
+    FlatIndex serial(16, Metric::L2, 1), parallel(16, Metric::L2, 4);
+    for (size_t i = 0; i < data.size(); ++i) {
+        serial.add(i, data[i]);
+        parallel.add(i, data[i]);
+    }
+    auto q = random_vectors(1, 16, 4)[0];
+    assert(ids_of(serial.search(q.data(), 20)) == ids_of(parallel.search(q.data(), 20)));
+    std::cout << "Parallel scan test passed!" << std::endl;
+}
+
+void test_librarian_upgrade_and_recall() {
+    std::cout << "Testing exact Librarian upgrade and HNSW recall..." << std::endl;
+    const size_t dim = 32, n = 3000, k = 10;
+    auto data = random_vectors(n, dim, 5);
+    auto queries = random_vectors(50, dim, 6);
+
+    Librarian lib(dim, 100, false, std::nullopt, Metric::Cosine);
+    lib.use_exact_search(1000);
+    assert(lib.encoding() == "flat");
+    for (size_t i = 0; i < 1000; ++i) lib.add_item(i, data[i]);
+    assert(lib.encoding() == "flat" && lib.count() == 1000);
+    auto exact_hit = lib.search_scored(data[10], 1);
+    assert(exact_hit.size() == 1 && exact_hit[0].id == 10 && std::abs(exact_hit[0].score - 1.0f) < 1e-4f);
+
+    // Growing past the limit builds the graph in the background; everything stays searchable
+    for (size_t i = 1000; i < n; ++i) lib.add_item(i, data[i]);
+    assert(lib.count() == n);
+    lib.wait_for_background();
+    assert(lib.encoding() == "fp32");
+    assert(lib.count() == n);
+    lib.remove_item(10);
+    assert(lib.count() == n - 1);
+
+    // The flat index is the ground truth for the graph's recall
+    FlatIndex truth(dim, Metric::Cosine);
+    for (size_t i = 0; i < n; ++i) {
+        if (i == 10) continue;
+        auto v = data[i];
+        float norm = 0.0f;
+        for (float x : v) norm += x * x;
+        for (float& x : v) x /= std::sqrt(norm);
+        truth.add(i, v);
+    }
+    double recall = 0.0;
+    for (auto q : queries) {
+        auto approximate = lib.search(q, k);
+        float norm = 0.0f;
+        for (float x : q) norm += x * x;
+        for (float& x : q) x /= std::sqrt(norm);
+        recall += recall_at_k(approximate, ids_of(truth.search(q.data(), k)));
+    }
+    recall /= queries.size();
+    std::cout << "  recall@" << k << " = " << recall << std::endl;
+    assert(recall > 0.9);
+    std::cout << "Exact Librarian upgrade and recall test passed!" << std::endl;
+}
+
+void test_upgrade_with_concurrent_writes() {
+    std::cout << "Testing writes during the graph upgrade..." << std::endl;
+    const size_t dim = 16;
+    auto data = random_vectors(3500, dim, 7);
+    Librarian lib(dim, 100);
+    lib.use_exact_search(500);
+    for (size_t i = 0; i < 500; ++i) lib.add_item(i, data[i]);
+
+    // The graph is built without the lock, so these land while it is being built and get replayed
+    std::thread writer([&] {
+        for (size_t i = 0; i < 500; i += 2) {
+            lib.remove_item(i);
+            lib.add_item(3000 + i, data[3000 + i]);
+        }
+    });
+    for (size_t i = 500; i < 3000; ++i) lib.add_item(i, data[i]);
+    writer.join();
+    lib.wait_for_background();
+
+    assert(lib.encoding() == "fp32");
+    assert(lib.count() == 3000);
+    for (size_t i = 0; i < 500; i += 2) {
+        auto gone = lib.search(data[i], 5);
+        assert(std::find(gone.begin(), gone.end(), i) == gone.end());
+        assert(lib.search(data[3000 + i], 1) == std::vector<size_t>{3000 + i});
+    }
+    std::cout << "Concurrent upgrade test passed!" << std::endl;
+}
+
+int main() {
+    try {
+        test_exact_results();
+        test_update_remove_persist();
+        test_parallel_scan();
+        test_librarian_upgrade_and_recall();
+        test_upgrade_with_concurrent_writes();
+        std::cout << "All FlatIndex tests passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
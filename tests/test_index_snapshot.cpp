@@ -0,0 +1,226 @@
+#include <iostream>
+#include <filesystem>
+#include <cassert>
+#include <mutex>
+#include <algorithm>
+#include "engine/database.hpp"
+#include "engine/librarian.hpp"
+#include "engine/index_snapshot.hpp"
+
+using namespace kestr::engine;
+
+std::vector<int64_t> add_file(Database& db, const std::string& path, const std::vector<std::vector<float>>& vectors) {
+    FileInfo info;
+    info.path = path;
+    info.hash = "hash_" + path;
+    info.size = 10;
+    info.last_write_time = std::filesystem::file_time_type::clock::now();
+    assert(db.update_file(info));
+
+    std::vector<Chunk> chunks(vectors.size());
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        chunks[i].content = path + " chunk " + std::to_string(i);
+        chunks[i].start_line = static_cast<int>(i) + 1;
+        chunks[i].end_line = static_cast<int>(i) + 1;
+    }
+    return db.insert_chunks(path, chunks, vectors);
+}
+
+void test_restore_replays_changes() {
+    std::cout << "Testing snapshot restore with replay..." << std::endl;
+    std::filesystem::path db_path = "test_snapshot.db";
+    std::filesystem::path snap_path = "test_snapshot.hnsw";
+    std::filesystem::remove(db_path);
+    std::filesystem::remove(snap_path);
+
+    Database db;
+    assert(db.open(db_path));
+    std::mutex db_mutex;
+
+    auto a_ids = add_file(db, "a.cpp", {{1, 0, 0, 0}, {0, 1, 0, 0}});
+    assert(a_ids.size() == 2);
+
+    Librarian librarian(4, 100);
+    db.for_each_vector([&](int64_t id, const std::vector<float>& vec) { librarian.add_item(id, vec); });
+
+    IndexSnapshot snapshot(snap_path);
+    assert(!snapshot.restore(librarian, db)); // Nothing saved yet
+    assert(snapshot.checkpoint(librarian, db, db_mutex));
+    assert(std::filesystem::exists(snap_path));
+
+    // Nothing changed: no new generation is opened
+    int64_t generation = db.generation();
+    assert(snapshot.checkpoint(librarian, db, db_mutex));
+    assert(db.generation() == generation);
+
+    // Changes after the checkpoint must come back through replay
+    auto b_ids = add_file(db, "b.cpp", {{0, 0, 1, 0}});
+    std::vector<int64_t> removed;
+    assert(db.remove_file("a.cpp", &removed));
+    assert(removed == a_ids);
+
+    Librarian restored(4, 100);
+    IndexSnapshot reopened(snap_path);
+    assert(reopened.restore(restored, db));
+    assert(restored.count() == 1);
+    auto hits = restored.search({0, 0, 1, 0}, 1);
+    assert(hits.size() == 1 && hits[0] == static_cast<size_t>(b_ids[0]));
+
+    // A librarian of another dimension must not pick the snapshot up
+    Librarian other(8, 100);
+    assert(!reopened.restore(other, db));
+
+    // Wiping chunks invalidates the snapshot tag
+    db.wipe_all_chunks();
+    Librarian wiped(4, 100);
+    assert(!reopened.restore(wiped, db));
+
+    std::cout << "Snapshot restore test passed!" << std::endl;
+    db.close();
+    std::filesystem::remove(db_path);
+    std::filesystem::remove(snap_path);
+}
+
+void test_mapped_librarian() {
+    std::cout << "Testing memory-mapped librarian..." << std::endl;
+    std::filesystem::path index_path = "test_mapped.hnsw";
+    std::filesystem::remove(index_path);
+
+    Librarian heap(4, 100);
+    heap.add_item(1, {1, 0, 0, 0});
+    heap.add_item(2, {0, 1, 0, 0});
+    heap.add_item(3, {0, 0, 1, 0});
+    assert(heap.save(index_path));
+
+    Librarian mapped(4, 100, true);
+    assert(mapped.is_mapped());
+    assert(mapped.load(index_path));
+    assert(mapped.count() == 3);
+    assert(mapped.search({0, 1, 0, 0}, 1) == std::vector<size_t>{2});
+
+    // Inserts land in the delta, updates and deletes shadow the mapped base
+    mapped.add_item(4, {0, 0, 0, 1});
+    mapped.add_item(1, {0.9f, 0, 0, 0.1f});
+    mapped.remove_item(3);
+    assert(mapped.count() == 3);
+    assert(mapped.search({0, 0, 0, 1}, 1) == std::vector<size_t>{4});
+    assert(mapped.search({0, 0, 1, 0}, 3).size() == 3);
+    auto hits = mapped.search({0, 0, 1, 0}, 3);
+    assert(std::find(hits.begin(), hits.end(), 3) == hits.end());
+
+    // The original file is untouched by copy-on-write deletes
+    Librarian reread(4, 100);
+    assert(reread.load(index_path));
+    assert(reread.count() == 3);
+
+    // Merging writes base + delta out and serves the result from a new mapping
+    std::filesystem::path merged_path = "test_mapped_merged.hnsw";
+    assert(mapped.save(merged_path));
+    assert(mapped.count() == 3);
+    assert(mapped.search({0, 0, 0, 1}, 1) == std::vector<size_t>{4});
+
+    Librarian reopened(4, 100, true);
+    assert(reopened.load(merged_path));
+    assert(reopened.count() == 3);
+    assert(reopened.search({1, 0, 0, 0}, 1) == std::vector<size_t>{1});
+    hits = reopened.search({0, 0, 1, 0}, 3);
+    assert(std::find(hits.begin(), hits.end(), 3) == hits.end());
+
+    // A delta growing past its initial capacity keeps accepting items
+    for (size_t id = 100; id < 5100; ++id) reopened.add_item(id, {0.5f, 0.5f, 0, static_cast<float>(id)});
+    assert(reopened.count() == 5003);
+
+    std::cout << "Memory-mapped librarian test passed!" << std::endl;
+    std::filesystem::remove(index_path);
+    std::filesystem::remove(merged_path);
+}
+
+void test_snapshot_metric() {
+    std::cout << "Testing snapshots keep their metric..." << std::endl;
+    // A snapshot of normalized vectors is not restored into an L2 index
+    std::filesystem::path db_path = "test_snapshot_metric.db";
+    std::filesystem::path snap_path = "test_snapshot_metric.hnsw";
+    std::filesystem::remove(db_path);
+    std::filesystem::remove(snap_path);
+    {
+        Database db;
+        assert(db.open(db_path));
+        std::mutex db_mutex;
+        auto ids = add_file(db, "a.cpp", {{10, 0, 0, 0}, {0, 2, 0, 0}});
+        Librarian saved(4, 100, false, std::nullopt, Metric::Cosine);
+        for (size_t i = 0; i < ids.size(); ++i) saved.add_item(ids[i], i == 0 ? std::vector<float>{10, 0, 0, 0} : std::vector<float>{0, 2, 0, 0});
+        IndexSnapshot snapshot(snap_path);
+        assert(snapshot.checkpoint(saved, db, db_mutex));
+
+        Librarian wrong(4, 100);
+        assert(!IndexSnapshot(snap_path).restore(wrong, db));
+        Librarian right(4, 100, false, std::nullopt, Metric::Cosine);
+        assert(IndexSnapshot(snap_path).restore(right, db));
+        assert(right.count() == 2);
+        assert(right.search({1, 0, 0, 0}, 1) == std::vector<size_t>{static_cast<size_t>(ids[0])});
+    }
+    std::filesystem::remove(db_path);
+    std::filesystem::remove(snap_path);
+    std::cout << "Snapshot metric test passed!" << std::endl;
+}
+
+void test_filtered_search() {
+    std::cout << "Testing filtered search..." << std::endl;
+    Librarian lib(4, 100);
+    auto chunk = [](const std::string& type, const std::string& language, const std::string& project) {
+        Chunk c;
+        c.symbol_type = type;
+        c.language = language;
+        c.project_root = project;
+        return c;
+    };
+    // The 50 nearest items are Python; the C++ ones are all farther away
+    for (size_t id = 0; id < 50; ++id) {
+        lib.set_attributes(id, chunk("function", "python", "/a"));
+        lib.add_item(id, {static_cast<float>(id), 0, 0, 0});
+    }
+    for (size_t id = 50; id < 60; ++id) {
+        lib.set_attributes(id, chunk(id % 2 ? "class" : "function", "cpp", id < 55 ? "/a" : "/b"));
+        lib.add_item(id, {static_cast<float>(id), 0, 0, 0});
+    }
+    lib.add_item(60, {0, 0, 0, 0}); // No attributes
+
+    SearchFilters cpp;
+    cpp.language = "cpp";
+    auto hits = lib.search({0, 0, 0, 0}, 5, cpp);
+    assert((hits == std::vector<size_t>{50, 51, 52, 53, 54}));
+
+    SearchFilters narrow = cpp;
+    narrow.type_filter = "class";
+    narrow.scope = "/b";
+    hits = lib.search({0, 0, 0, 0}, 5, narrow);
+    assert((hits == std::vector<size_t>{55, 57, 59}));
+
+    SearchFilters unknown;
+    unknown.language = "rust";
+    assert(lib.search({0, 0, 0, 0}, 5, unknown).empty());
+
+    // Unfiltered search still sees the item without attributes
+    assert(lib.search({0, 0, 0, 0}, 1).size() == 1);
+    hits = lib.search({0, 0, 0, 0}, 61, cpp);
+    assert(std::find(hits.begin(), hits.end(), 60) == hits.end());
+
+    // Attributes follow updates
+    lib.set_attributes(3, chunk("function", "cpp", "/a"));
+    assert(lib.search({0, 0, 0, 0}, 1, cpp) == std::vector<size_t>{3});
+    std::cout << "Filtered search test passed!" << std::endl;
+}
+
+int main() {
+    try {
+        test_restore_replays_changes();
+        test_mapped_librarian();
+        test_snapshot_metric();
+        test_filtered_search();
+        std::cout << "All IndexSnapshot tests passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
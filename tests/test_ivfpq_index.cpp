@@ -0,0 +1,244 @@
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <random>
+#include <algorithm>
+#include <unordered_set>
+#include <filesystem>
+#include "engine/ivfpq_index.hpp"
+#include "engine/librarian.hpp"
+
+using namespace kestr::engine;
+
+// Unit vectors around a few dozen topics, roughly what code embeddings look like
+std::vector<std::vector<float>> clustered_vectors(size_t count, size_t dim, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    std::vector<std::vector<float>> topics(40, std::vector<float>(dim));
+    for (auto& t : topics) for (auto& x : t) x = dist(rng);
+
+    std::vector<std::vector<float>> out(count, std::vector<float>(dim));
+    for (size_t i = 0; i < count; ++i) {
+        const auto& topic = topics[rng() % topics.size()];
+        float norm = 0.0f;
+        for (size_t d = 0; d < dim; ++d) {
+            out[i][d] = topic[d] + 0.5f * dist(rng);
+            norm += out[i][d] * out[i][d];
+        }
+        for (auto& x : out[i]) x /= std::sqrt(norm);
+    }
+    return out;
+}
+
+std::vector<size_t> brute_force(const std::vector<std::vector<float>>& data, const std::vector<float>& q, size_t k) {
+    std::vector<std::pair<float, size_t>> scored;
+    for (size_t i = 0; i < data.size(); ++i) {
+        float sum = 0.0f;
+        for (size_t d = 0; d < q.size(); ++d) sum += (data[i][d] - q[d]) * (data[i][d] - q[d]);
+        scored.emplace_back(sum, i);
+    }
+    std::partial_sort(scored.begin(), scored.begin() + k, scored.end());
+    std::vector<size_t> ids;
+    for (size_t i = 0; i < k; ++i) ids.push_back(scored[i].second);
+    return ids;
+}
+
+IvfPqOptions small_options() {
+    IvfPqOptions options;
+    options.nlist = 32;
+    options.nprobe = 8;
+    options.m = 16;
+    options.train_size = 2000;
+    return options;
+}
+
+void test_untrained_is_exact() {
+    std::cout << "Testing exhaustive search before training..." << std::endl;
+    auto data = clustered_vectors(300, 64, 1);
+    IvfPqIndex index(64, small_options());
+    for (size_t i = 0; i < data.size(); ++i) index.add(i, data[i]);
+    assert(!index.trained());
+    assert(index.size() == 300);
+    assert(index.export_codebooks().empty());
+
+    auto hits = index.search(data[42], 5);
+    assert(hits.size() == 5);
+    assert(hits[0].second == 42);
+    auto exact = brute_force(data, data[42], 5);
+    for (size_t i = 0; i < 5; ++i) assert(hits[i].second == exact[i]);
+    std::cout << "Untrained test passed!" << std::endl;
+}
+
+void test_recall_with_rerank() {
+    std::cout << "Testing recall after training..." << std::endl;
+    const size_t dim = 64;
+    auto data = clustered_vectors(6000, dim, 2);
+    Librarian librarian(dim, small_options());
+    librarian.set_rerank([&](const std::vector<size_t>& ids) {
+        std::unordered_map<size_t, std::vector<float>> out;
+        for (size_t id : ids) out.emplace(id, data[id]);
+        return out;
+    }, 4);
+    for (size_t i = 0; i < data.size(); ++i) librarian.add_item(i, data[i]);
+    librarian.wait_for_background();
+    assert(librarian.count() == data.size());
+    assert(librarian.encoding() == "ivfpq");
+    assert(!librarian.export_codebooks().empty());
+
+    auto queries = clustered_vectors(50, dim, 3);
+    size_t found = 0;
+    for (const auto& q : queries) {
+        auto exact = brute_force(data, q, 10);
+        auto got = librarian.search(q, 10);
+        std::unordered_set<size_t> got_set(got.begin(), got.end());
+        for (size_t id : exact) found += got_set.count(id);
+    }
+    double recall = double(found) / (queries.size() * 10);
+    std::cout << "  recall@10 = " << recall << std::endl;
+    assert(recall >= 0.8);
+
+    // Filters apply while the lists are scanned, so k matches come back
+    for (size_t id = 0; id < data.size(); ++id) {
+        Chunk chunk;
+        chunk.language = id % 10 == 0 ? "cpp" : "python";
+        librarian.set_attributes(id, chunk);
+    }
+    SearchFilters cpp;
+    cpp.language = "cpp";
+    auto hits = librarian.search(queries[0], 10, cpp);
+    assert(hits.size() == 10);
+    for (size_t id : hits) assert(id % 10 == 0);
+    std::cout << "Recall test passed!" << std::endl;
+}
+
+void test_remove_and_update() {
+    std::cout << "Testing remove and update..." << std::endl;
+    auto data = clustered_vectors(3000, 64, 4);
+    IvfPqIndex index(64, small_options());
+    for (size_t i = 0; i < data.size(); ++i) index.add(i, data[i]);
+    assert(index.trained());
+    assert(index.size() == 3000);
+
+    // Removals swap entries around inside the lists; everything else must stay reachable
+    for (size_t i = 0; i < data.size(); i += 3) index.remove(i);
+    index.remove(0);     // Twice
+    index.remove(99999); // Never added
+    assert(index.size() == 2000);
+    for (size_t i = 1; i < 200; i += 3) {
+        auto hits = index.search(data[i], 20);
+        bool present = false;
+        for (const auto& hit : hits) {
+            assert(hit.second % 3 != 0);
+            present |= hit.second == i;
+        }
+        assert(present);
+    }
+
+    // Re-adding an id replaces its vector
+    index.add(1, data[2]);
+    assert(index.size() == 2000);
+    auto hits = index.search(data[2], 2);
+    assert(hits[0].second == 1 || hits[0].second == 2);
+    std::cout << "Remove/update test passed!" << std::endl;
+}
+
+void test_persistence() {
+    std::cout << "Testing save/load and stored codebooks..." << std::endl;
+    auto path = std::filesystem::temp_directory_path() / "kestr_test_ivfpq.idx";
+    auto data = clustered_vectors(2500, 64, 5);
+    IvfPqIndex index(64, small_options());
+    for (size_t i = 0; i < data.size(); ++i) index.add(i * 2, data[i]);
+    index.remove(10);
+    assert(index.save(path));
+
+    IvfPqIndex loaded(64, small_options());
+    assert(loaded.load(path));
+    assert(loaded.size() == index.size());
+    for (size_t i = 0; i < 20; ++i) assert(loaded.search(data[i], 10) == index.search(data[i], 10));
+    loaded.remove(2); // Locations were rebuilt
+    assert(loaded.size() == index.size() - 1);
+
+    IvfPqIndex wrong_dim(32, small_options());
+    assert(!wrong_dim.load(path));
+    assert(wrong_dim.size() == 0);
+
+    // A cut-off file is rejected by its counts before they size anything
+    auto cut = path;
+    cut += ".cut";
+    std::filesystem::copy_file(path, cut, std::filesystem::copy_options::overwrite_existing);
+    std::filesystem::resize_file(cut, std::filesystem::file_size(path) / 2);
+    assert(!loaded.load(cut));
+    assert(loaded.size() == index.size() - 1);
+    std::filesystem::remove(cut);
+
+    // Codebooks from the database make a fresh index usable without retraining
+    auto options = small_options();
+    options.codebooks = index.export_codebooks();
+    IvfPqIndex warm(64, options);
+    assert(warm.trained());
+    for (size_t i = 0; i < 100; ++i) warm.add(i, data[i]);
+    assert(warm.export_codebooks() == index.export_codebooks());
+    assert(warm.search(data[7], 1)[0].second == 7);
+
+    // Codebooks of another shape are ignored
+    auto other = small_options();
+    other.m = 8;
+    other.codebooks = options.codebooks;
+    IvfPqIndex cold(64, other);
+    assert(!cold.trained());
+
+    std::filesystem::remove(path);
+    std::cout << "Persistence test passed!" << std::endl;
+}
+
+void test_deferred_training() {
+    std::cout << "Testing training outside the index..." << std::endl;
+    auto path = std::filesystem::temp_directory_path() / "kestr_test_ivfpq_deferred.idx";
+    auto data = clustered_vectors(2100, 64, 6);
+    IvfPqIndex index(64, small_options());
+    index.defer_training(true);
+    for (size_t i = 0; i < 2000; ++i) index.add(i, data[i]);
+    assert(!index.trained());
+    auto training = index.take_training();
+    assert(training && training->ids.size() == 2000);
+    assert(!index.take_training()); // One at a time
+
+    // Changes while the copy is trained must survive the install
+    index.add(5, data[2050]);
+    index.remove(6);
+    index.add(2099, data[2099]);
+    index.train(*training);
+    assert(!index.trained());
+    index.install(std::move(*training));
+    assert(index.trained());
+    assert(index.size() == 2000);
+    assert(index.search(data[2050], 1)[0].second == 5);
+    assert(index.search(data[2099], 1)[0].second == 2099);
+    for (const auto& hit : index.search(data[6], 20)) assert(hit.second != 6);
+
+    // A load in between voids the training
+    IvfPqIndex other(64, small_options());
+    other.defer_training(true);
+    for (size_t i = 0; i < 2000; ++i) other.add(i, data[i]);
+    assert(other.save(path));
+    training = other.take_training();
+    assert(training);
+    other.train(*training);
+    assert(other.load(path));
+    other.install(std::move(*training));
+    assert(!other.trained());
+    assert(other.take_training()); // The loaded buffer can be trained again
+
+    std::filesystem::remove(path);
+    std::cout << "Deferred training test passed!" << std::endl;
+}
+
+int main() {
+    test_untrained_is_exact();
+    test_recall_with_rerank();
+    test_remove_and_update();
+    test_persistence();
+    test_deferred_training();
+    std::cout << "All IVF-PQ tests passed!" << std::endl;
+    return 0;
+}
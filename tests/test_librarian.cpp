@@ -0,0 +1,173 @@
+#include <iostream>
+#include <filesystem>
+#include <cassert>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include "engine/librarian.hpp"
+
+using namespace kestr::engine;
+
+void test_cosine_metric() {
+    std::cout << "Testing cosine metric and scores..." << std::endl;
+    // Same directions, very different lengths: L2 and cosine disagree on the nearest item
+    Librarian l2(4, 100);
+    Librarian cosine(4, 100, false, std::nullopt, Metric::Cosine);
+    for (Librarian* lib : {&l2, &cosine}) {
+        lib->add_item(1, {10, 0, 0, 0});
+        lib->add_item(2, {1, 1, 0, 0});
+        lib->add_item(3, {0, 0, 0, 3});
+    }
+    assert(l2.search({1, 0, 0, 0}, 1) == std::vector<size_t>{2});
+    auto hits = cosine.search_scored({2, 0, 0, 0}, 3);
+    assert(hits.size() == 3);
+    assert(hits[0].id == 1 && std::abs(hits[0].score - 1.0f) < 1e-5f);
+    assert(hits[1].id == 2 && std::abs(hits[1].score - 0.70710678f) < 1e-5f);
+    assert(hits[2].id == 3 && std::abs(hits[2].score) < 1e-5f);
+
+    // Quantized hits are scored from their decoded codes
+    Librarian int8(4, 100, false, ScalarQuantizer::uniform(4, -1.0f, 1.0f), Metric::Cosine);
+    int8.add_item(1, {10, 0, 0, 0});
+    int8.add_item(2, {0, 5, 0, 0});
+    hits = int8.search_scored({1, 0, 0, 0}, 2);
+    assert(hits[0].id == 1 && std::abs(hits[0].score - 1.0f) < 0.02f);
+    assert(hits[1].id == 2 && std::abs(hits[1].score) < 0.02f);
+    std::cout << "Cosine metric test passed!" << std::endl;
+}
+
+void test_librarian_growth() {
+    std::cout << "Testing librarian capacity growth..." << std::endl;
+    Librarian lib(4, 10);
+    assert(lib.capacity() == 10);
+
+    // Writers race for the last free slots while the index doubles under them
+    std::vector<std::thread> writers;
+    for (size_t t = 0; t < 4; ++t) {
+        writers.emplace_back([&lib, t] {
+            for (size_t i = 0; i < 1000; ++i) {
+                size_t id = t * 1000 + i;
+                lib.add_item(id, {static_cast<float>(id), 1, 0, 0});
+            }
+        });
+    }
+    for (auto& w : writers) w.join();
+    assert(lib.count() == 4000);
+    assert(lib.capacity() >= 4000);
+    assert(lib.utilization() > 0.0 && lib.utilization() <= 1.0);
+    assert(lib.search({2500, 1, 0, 0}, 1) == std::vector<size_t>{2500});
+
+    // Removed slots are reused before the index grows again
+    size_t capacity = lib.capacity();
+    for (size_t id = 0; id < 100; ++id) lib.remove_item(id);
+    for (size_t id = 10000; id < 10100; ++id) lib.add_item(id, {static_cast<float>(id), 1, 0, 0});
+    assert(lib.capacity() == capacity);
+    assert(lib.count() == 4000);
+
+    // Deletions survive a grown copy, and its free slots are still taken first
+    for (size_t id = 200; id < 300; ++id) lib.remove_item(id);
+    size_t fill = capacity - 3900 + 1;
+    for (size_t id = 20000; id < 20000 + fill; ++id) lib.add_item(id, {static_cast<float>(id), 1, 0, 0});
+    assert(lib.capacity() > capacity);
+    assert(lib.count() == 3900 + fill);
+    assert(lib.search({250, 1, 0, 0}, 1) != std::vector<size_t>{250});
+    assert(lib.search({2500, 1, 0, 0}, 1) == std::vector<size_t>{2500});
+    std::cout << "Librarian growth test passed!" << std::endl;
+}
+
+void test_concurrent_search_and_insert() {
+    std::cout << "Testing concurrent search and insert..." << std::endl;
+    std::filesystem::path index_path = "test_concurrent.hnsw";
+    std::filesystem::remove(index_path);
+
+    for (bool mapped : {false, true}) {
+        Librarian lib(4, 16, mapped);
+        lib.add_item(0, {0, 0, 0, 0});
+        if (mapped) assert(lib.save(index_path));
+
+        std::atomic<bool> done{false};
+        std::atomic<size_t> searches{0};
+        std::vector<std::thread> readers;
+        for (size_t t = 0; t < 3; ++t) {
+            readers.emplace_back([&] {
+                while (!done) {
+                    // Item 0 is never touched again, so every search must still find it
+                    auto hits = lib.search({0, 0, 0, 0}, 1, {}, 16 + searches % 64);
+                    assert(hits == std::vector<size_t>{0});
+                    ++searches;
+                }
+            });
+        }
+
+        // Inserts force several grow-and-publish cycles (and merges in mapped mode) under the readers
+        for (size_t id = 1; id <= 3000; ++id) {
+            lib.add_item(id, {static_cast<float>(id), 1, 1, 1});
+            if (id % 500 == 0) lib.remove_item(id - 1);
+            if (mapped && id % 1000 == 0) assert(lib.save(index_path));
+        }
+        done = true;
+        for (auto& r : readers) r.join();
+        assert(searches > 0);
+        assert(lib.count() == 3001 - 6);
+    }
+    std::filesystem::remove(index_path);
+    std::cout << "Concurrent search test passed!" << std::endl;
+}
+
+void test_readd_existing_ids() {
+    std::cout << "Testing re-adding ids while deleted slots exist..." << std::endl;
+    std::filesystem::path index_path = "test_readd.hnsw";
+    std::filesystem::remove(index_path);
+
+    auto check_unique = [](Librarian& lib, size_t live) {
+        auto hits = lib.search({0, 0, 0, 0}, 20);
+        assert(hits.size() == live);
+        std::sort(hits.begin(), hits.end());
+        assert(std::adjacent_find(hits.begin(), hits.end()) == hits.end());
+    };
+
+    for (bool mapped : {false, true}) {
+        Librarian lib(4, 100, mapped);
+        for (size_t id = 1; id <= 10; ++id) lib.add_item(id, {static_cast<float>(id), 0, 0, 0});
+        if (mapped) {
+            assert(lib.save(index_path));
+        }
+        lib.remove_item(9);
+        lib.remove_item(10);
+
+        // A live id must be updated in place, not copied into one of the freed slots
+        lib.add_item(1, {0, 1, 0, 0});
+        assert(lib.count() == 8);
+        check_unique(lib, 8);
+        // A deleted id comes back once
+        lib.add_item(9, {0, 2, 0, 0});
+        assert(lib.count() == 9);
+        check_unique(lib, 9);
+
+        if (mapped) {
+            // Merging the delta into a base image that still holds the old slots
+            assert(lib.save(index_path));
+            check_unique(lib, 9);
+        }
+        lib.remove_item(1);
+        auto hits = lib.search({0, 1, 0, 0}, 20);
+        assert(std::find(hits.begin(), hits.end(), 1) == hits.end());
+        assert(lib.count() == 8);
+    }
+    std::filesystem::remove(index_path);
+    std::cout << "Re-add test passed!" << std::endl;
+}
+
+int main() {
+    try {
+        test_cosine_metric();
+        test_librarian_growth();
+        test_concurrent_search_and_insert();
+        test_readd_existing_ids();
+        std::cout << "All Librarian tests passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,229 @@
+#include <iostream>
+#include <filesystem>
+#include <cassert>
+#include <mutex>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+#include "engine/database.hpp"
+#include "engine/librarian_shards.hpp"
+
+using namespace kestr::engine;
+
+std::vector<int64_t> add_file(Database& db, const std::string& project, const std::string& path, const std::vector<std::vector<float>>& vectors) {
+    FileInfo info;
+    info.path = path;
+    info.hash = "hash_" + path;
+    info.size = 10;
+    info.last_write_time = std::filesystem::file_time_type::clock::now();
+    info.project_root = project;
+    assert(db.update_file(info));
+
+    std::vector<Chunk> chunks(vectors.size());
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        chunks[i].content = path + " chunk " + std::to_string(i);
+        chunks[i].start_line = static_cast<int>(i) + 1;
+        chunks[i].end_line = static_cast<int>(i) + 1;
+        chunks[i].project_root = project;
+        chunks[i].language = "cpp";
+    }
+    return db.insert_chunks(path, chunks, vectors);
+}
+
+// Indexes what add_file stored, the way the daemon's commit hook does
+void index_file(LibrarianShards& shards, Database& db, const std::vector<int64_t>& ids) {
+    auto stored = db.get_embeddings(ids);
+    for (auto& [id, vec] : stored) {
+        auto chunk = db.get_chunk(id);
+        shards.set_attributes(id, chunk);
+        shards.add_item(id, vec);
+    }
+}
+
+LibrarianShards::Factory make_factory(std::vector<std::string>* created = nullptr) {
+    return [created](const std::string& root, size_t expected) {
+        if (created) created->push_back(root);
+        return std::make_unique<Librarian>(4, std::max<size_t>(16, expected));
+    };
+}
+
+void test_routing_and_search() {
+    std::cout << "Testing shard routing and fan-out search..." << std::endl;
+    std::filesystem::path db_path = "test_shards.db";
+    std::filesystem::path snap_dir = "test_shards_snapshots";
+    std::filesystem::remove(db_path);
+    std::filesystem::remove_all(snap_dir);
+    std::filesystem::create_directories(snap_dir);
+
+    Database db;
+    assert(db.open(db_path));
+    std::mutex db_mutex;
+
+    std::vector<std::string> created;
+    LibrarianShards shards(make_factory(&created), snap_dir, 2);
+    shards.add_shard("/a");
+    shards.add_shard("/b");
+    assert(shards.shard_count() == 2);
+    assert(created.empty()); // Librarians appear on first use
+
+    auto a_ids = add_file(db, "/a", "/a/x.cpp", {{1, 0, 0, 0}, {0.9f, 0.1f, 0, 0}});
+    auto b_ids = add_file(db, "/b", "/b/y.cpp", {{0.95f, 0, 0.05f, 0}, {0, 0, 0, 1}});
+    index_file(shards, db, a_ids);
+    index_file(shards, db, b_ids);
+    assert(created.size() == 2);
+    assert(shards.count() == 4);
+
+    // Unscoped queries merge the shards by score
+    auto hits = shards.search_scored({1, 0, 0, 0}, 3);
+    assert(hits.size() == 3);
+    assert(hits[0].id == static_cast<size_t>(a_ids[0]));
+    assert(hits[1].id == static_cast<size_t>(b_ids[0]));
+    assert(hits[2].id == static_cast<size_t>(a_ids[1]));
+    assert(hits[0].score >= hits[1].score && hits[1].score >= hits[2].score);
+
+    // Scoped queries only see their project
+    SearchFilters scoped;
+    scoped.scope = "/b";
+    hits = shards.search_scored({1, 0, 0, 0}, 5, scoped);
+    assert(hits.size() == 2);
+    for (const auto& hit : hits) assert(std::find(b_ids.begin(), b_ids.end(), static_cast<int64_t>(hit.id)) != b_ids.end());
+    scoped.scope = "/unknown";
+    assert(shards.search_scored({1, 0, 0, 0}, 5, scoped).empty());
+
+    // Other filters still apply inside the shards
+    SearchFilters rust;
+    rust.language = "rust";
+    assert(shards.search_scored({1, 0, 0, 0}, 5, rust).empty());
+
+    shards.remove_item(b_ids[0]);
+    hits = shards.search_scored({1, 0, 0, 0}, 2);
+    assert(hits.size() == 2 && hits[1].id == static_cast<size_t>(a_ids[1]));
+
+    // Each shard keeps its own snapshot
+    assert(shards.checkpoint(db, db_mutex));
+    size_t files = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(snap_dir)) files += entry.path().extension() == ".hnsw";
+    assert(files == 2);
+    std::cout << "Shard routing and fan-out search test passed!" << std::endl;
+}
+
+void test_restore() {
+    std::cout << "Testing per-shard restore..." << std::endl;
+    std::filesystem::path db_path = "test_shards.db";
+    std::filesystem::path snap_dir = "test_shards_snapshots";
+
+    Database db;
+    assert(db.open(db_path));
+    std::mutex db_mutex;
+
+    // Removed from the database after the checkpoint of the previous test
+    std::vector<int64_t> removed;
+    assert(db.remove_file("/a/x.cpp", &removed));
+    assert(removed.size() == 2);
+
+    LibrarianShards shards(make_factory(), snap_dir, 2);
+    shards.add_shard("/a"); // Watched, but without chunks now
+    shards.add_shard("/b");
+    assert(shards.restore(db, db_mutex));
+    assert(shards.shard_count() == 2);
+    assert(shards.count() == 1); // /a replayed its removals, /b only has one vector left
+
+    SearchFilters scoped;
+    scoped.scope = "/a";
+    assert(shards.search_scored({1, 0, 0, 0}, 5, scoped).empty());
+    scoped.scope = "/b";
+    assert(shards.search_scored({0, 0, 0, 1}, 5, scoped).size() == 1);
+
+    // A lost shard snapshot is rebuilt from the database without touching the other
+    auto c_ids = add_file(db, "/c", "/c/z.cpp", {{0, 1, 0, 0}});
+    LibrarianShards fresh(make_factory(), snap_dir, 2);
+    fresh.add_shard("/a");
+    assert(!fresh.restore(db, db_mutex));
+    assert(fresh.shard_count() == 3);
+    assert(fresh.count() == 2);
+    auto hits = fresh.search_scored({0, 1, 0, 0}, 1);
+    assert(hits.size() == 1 && hits[0].id == static_cast<size_t>(c_ids[0]));
+
+    // Discarded snapshots are not restored
+    {
+        std::lock_guard<std::mutex> lock(db_mutex);
+        fresh.discard(db);
+    }
+    LibrarianShards rebuilt(make_factory(), snap_dir, 2);
+    assert(!rebuilt.restore(db, db_mutex));
+    assert(rebuilt.count() == 3); // Includes the vector only removed from the index earlier
+
+    std::filesystem::remove(db_path);
+    std::filesystem::remove_all(snap_dir);
+    std::cout << "Per-shard restore test passed!" << std::endl;
+}
+
+void test_failing_shard_search() {
+    std::cout << "Testing a failing shard search waits for the others..." << std::endl;
+    std::filesystem::path snap_dir = "test_shards_failing";
+    std::filesystem::remove_all(snap_dir);
+    std::filesystem::create_directories(snap_dir);
+
+    // int8 shards rerank through the lookup; the one of /bad throws like a failing database read
+    std::unordered_map<size_t, std::vector<float>> vectors;
+    LibrarianShards shards([&vectors](const std::string& root, size_t expected) {
+        auto lib = std::make_unique<Librarian>(4, std::max<size_t>(16, expected), false, ScalarQuantizer::uniform(4, -1.0f, 1.0f));
+        lib->set_rerank([&vectors, root](const std::vector<size_t>& ids) {
+            if (root == "/bad") throw std::runtime_error("lookup failed");
+            std::unordered_map<size_t, std::vector<float>> out;
+            for (size_t id : ids) out.emplace(id, vectors.at(id));
+            return out;
+        });
+        return lib;
+    }, snap_dir, 2);
+
+    size_t id = 1;
+    for (const std::string root : {"/bad", "/a", "/b", "/c"}) {
+        for (int i = 0; i < 8; ++i, ++id) {
+            Chunk chunk;
+            chunk.project_root = root;
+            vectors[id] = {0.1f * i, 0.5f, 0.0f, root == "/bad" ? 1.0f : 0.0f};
+            shards.set_attributes(id, chunk);
+            shards.add_item(id, vectors[id]);
+        }
+    }
+
+    // The error reaches the caller only once every other shard is done with the shared frame
+    for (int round = 0; round < 50; ++round) {
+        bool thrown = false;
+        try {
+            shards.search_scored({0.2f, 0.5f, 0.0f, 0.0f}, 5);
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        assert(thrown);
+    }
+    SearchFilters scoped;
+    scoped.scope = "/a";
+    assert(shards.search_scored({0.2f, 0.5f, 0.0f, 0.0f}, 5, scoped).size() == 5);
+
+    std::filesystem::remove_all(snap_dir);
+    std::cout << "Failing shard search test passed!" << std::endl;
+}
+
+void test_stable_slug() {
+    std::cout << "Testing shard slugs are stable..." << std::endl;
+    // Persisted in file names and meta keys, so it must not depend on the standard library
+    assert(LibrarianShards::slug("") == "default");
+    assert(LibrarianShards::slug("/src/app") == "36118851a1fd8860");
+    std::cout << "Stable slug test passed!" << std::endl;
+}
+
+int main() {
+    try {
+        test_routing_and_search();
+        test_restore();
+        test_failing_shard_search();
+        test_stable_slug();
+        std::cout << "All LibrarianShards tests passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include <iostream>
+#include <filesystem>
+#include <cassert>
+#include <cmath>
+#include <vector>
+#include "engine/model_prep.hpp"
+
+using namespace kestr::engine;
+
+// Vectors depend on the text length and the model name, so two names give two models
+class FakeEmbedder : public Embedder {
+public:
+    explicit FakeEmbedder(std::string model) : m_model(std::move(model)) {}
+
+    std::vector<float> embed(const std::string& text) override {
+        if (text == "fail") return {};
+        return {static_cast<float>(text.size()), static_cast<float>(m_model.size()), 1.0f};
+    }
+    size_t dimension() const override { return 3; }
+    std::string model_id() const override { return m_model; }
+
+private:
+    std::string m_model;
+};
+
+void test_measure_drift() {
+    std::cout << "Testing model drift measurement..." << std::endl;
+    FakeEmbedder reference("m"), same("m"), other("mm");
+    std::vector<std::string> texts{"a", "bbbb", "cccccccc"};
+
+    auto report = measure_drift(reference, same, texts);
+    assert(report.samples == 3 && report.failures == 0);
+    assert(report.mean_drift < 1e-9 && report.max_drift < 1e-9);
+
+    report = measure_drift(reference, other, texts);
+    assert(report.samples == 3 && report.mean_drift > 0.0);
+    assert(report.max_drift >= report.mean_drift);
+
+    texts.push_back("fail");
+    report = measure_drift(reference, other, texts);
+    assert(report.samples == 3 && report.failures == 1);
+
+    // Reference vectors taken up front give the same result as both models side by side
+    auto expected = embed_reference(reference, texts);
+    auto split = measure_drift(expected, other, texts);
+    assert(split.samples == report.samples && split.failures == report.failures);
+    assert(std::abs(split.mean_drift - report.mean_drift) < 1e-12);
+    std::cout << "Drift test passed!" << std::endl;
+}
+
+void test_quantize_arguments() {
+    std::cout << "Testing quantizer arguments are not run through a shell..." << std::endl;
+    auto dir = std::filesystem::temp_directory_path() / "kestr_model_prep";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    auto marker = dir / "injected";
+    auto input = dir / ("model\"; touch " + marker.string() + "; \".onnx");
+
+    assert(!quantize_model(input, dir / "out.onnx", "kestr-no-such-interpreter"));
+    // Whether or not Python and its onnxruntime are installed, nothing but the quantizer may run
+    quantize_model(input, dir / "out.onnx");
+    assert(!std::filesystem::exists(marker));
+
+    std::filesystem::remove_all(dir);
+    std::cout << "Quantizer argument test passed!" << std::endl;
+}
+
+int main() {
+    try {
+        test_measure_drift();
+        test_quantize_arguments();
+        std::cout << "All ModelPrep tests passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
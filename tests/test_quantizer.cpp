@@ -0,0 +1,113 @@
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <random>
+#include "engine/quantizer.hpp"
+#include "engine/librarian.hpp"
+
+using namespace kestr::engine;
+
+std::vector<std::vector<float>> random_vectors(size_t count, size_t dim, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    std::vector<std::vector<float>> out(count, std::vector<float>(dim));
+    for (auto& v : out) {
+        float norm = 0.0f;
+        for (auto& x : v) { x = dist(rng); norm += x * x; }
+        for (auto& x : v) x /= std::sqrt(norm);
+    }
+    return out;
+}
+
+void test_round_trip() {
+    std::cout << "Testing encode/decode round trip..." << std::endl;
+    auto samples = random_vectors(500, 64, 1);
+    auto q = ScalarQuantizer::fit(samples, 0.0f);
+    assert(q.dimension() == 64);
+
+    for (const auto& v : samples) {
+        auto codes = q.encode(v);
+        auto back = q.decode(codes.data());
+        for (size_t d = 0; d < v.size(); ++d) {
+            // Without clipping every sample is in range, so the error is at most half a step
+            assert(std::fabs(back[d] - v[d]) < 0.02f);
+        }
+    }
+
+    auto restored = ScalarQuantizer::deserialize(q.serialize());
+    assert(restored && restored->dimension() == 64);
+    assert(restored->encode(samples[0]) == q.encode(samples[0]));
+    assert(!ScalarQuantizer::deserialize("not json"));
+    std::cout << "Round trip test passed!" << std::endl;
+}
+
+void test_distance_kernel() {
+    std::cout << "Testing integer distance kernel..." << std::endl;
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> byte(0, 255);
+    // Odd sizes exercise the scalar tail after the SIMD body
+    for (size_t dim : {1, 15, 16, 17, 384, 1536}) {
+        std::vector<uint8_t> a(dim), b(dim);
+        for (size_t i = 0; i < dim; ++i) { a[i] = byte(rng); b[i] = byte(rng); }
+        uint32_t expected = 0;
+        for (size_t i = 0; i < dim; ++i) {
+            int d = int(a[i]) - int(b[i]);
+            expected += d * d;
+        }
+        assert(ScalarQuantizer::distance(a.data(), b.data(), dim) == expected);
+    }
+    std::cout << "Distance kernel test passed!" << std::endl;
+}
+
+void test_quantized_librarian() {
+    std::cout << "Testing quantized librarian with rerank..." << std::endl;
+    const size_t dim = 32;
+    auto vectors = random_vectors(300, dim, 3);
+    auto q = ScalarQuantizer::fit(vectors);
+
+    Librarian librarian(dim, 1000, false, q);
+    assert(librarian.encoding() == "int8");
+    for (size_t i = 0; i < vectors.size(); ++i) librarian.add_item(i, vectors[i]);
+    assert(librarian.count() == vectors.size());
+
+    // Every stored vector finds itself
+    for (size_t i = 0; i < vectors.size(); i += 37) {
+        auto hits = librarian.search(vectors[i], 1);
+        assert(hits.size() == 1 && hits[0] == i);
+    }
+
+    size_t lookups = 0;
+    librarian.set_rerank([&](const std::vector<size_t>& ids) {
+        ++lookups;
+        std::unordered_map<size_t, std::vector<float>> out;
+        for (size_t id : ids) out[id] = vectors[id];
+        return out;
+    }, 4);
+
+    auto hits = librarian.search(vectors[5], 10);
+    assert(lookups == 1);
+    assert(hits.size() == 10 && hits[0] == 5);
+
+    // Reranked order follows exact fp32 distances
+    auto dist = [&](size_t id) {
+        float s = 0.0f;
+        for (size_t d = 0; d < dim; ++d) { float t = vectors[id][d] - vectors[5][d]; s += t * t; }
+        return s;
+    };
+    for (size_t i = 1; i < hits.size(); ++i) assert(dist(hits[i - 1]) <= dist(hits[i]));
+
+    std::cout << "Quantized librarian test passed!" << std::endl;
+}
+
+int main() {
+    try {
+        test_round_trip();
+        test_distance_kernel();
+        test_quantized_librarian();
+        std::cout << "All quantizer tests passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
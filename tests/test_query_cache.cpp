@@ -0,0 +1,101 @@
+#include <iostream>
+#include <cassert>
+#include <vector>
+#include "engine/query_cache.hpp"
+
+using namespace kestr::engine;
+
+void test_lru() {
+    std::cout << "Testing LRU eviction..." << std::endl;
+    LruCache<int> lru(2);
+    int v = 0;
+    lru.put("a", 1);
+    lru.put("b", 2);
+    assert(lru.get("a", v) && v == 1); // "b" is now the oldest
+    lru.put("c", 3);
+    assert(lru.size() == 2 && !lru.get("b", v));
+    assert(lru.get("a", v) && lru.get("c", v) && v == 3);
+    lru.put("a", 4);
+    assert(lru.get("a", v) && v == 4 && lru.size() == 2);
+    lru.erase("a");
+    assert(!lru.get("a", v) && lru.size() == 1);
+
+    LruCache<int> off(0);
+    off.put("a", 1);
+    assert(!off.get("a", v));
+    std::cout << "LRU test passed!" << std::endl;
+}
+
+void test_keys() {
+    std::cout << "Testing query keys..." << std::endl;
+    assert(QueryCache::normalize("  file   watcher\n") == "file watcher");
+    assert(QueryCache::normalize("") == "");
+
+    SearchFilters none, functions, python;
+    functions.type_filter = "function";
+    python.language = "python";
+    std::string key = QueryCache::result_key("file watcher", 5, none);
+    assert(key == QueryCache::result_key(" file\twatcher ", 5, none));
+    assert(key != QueryCache::result_key("file watcher", 10, none));
+    assert(QueryCache::result_key("x", 5, functions) != QueryCache::result_key("x", 5, python));
+    std::cout << "Key test passed!" << std::endl;
+}
+
+void test_embeddings() {
+    std::cout << "Testing the embedding cache..." << std::endl;
+    QueryCache cache(10, 10);
+    std::vector<float> vec;
+    assert(!cache.get_embedding("how does it work", vec));
+    cache.put_embedding("how does it work", {1.0f, 2.0f});
+    cache.put_embedding("failed", {}); // Failed embeddings are not kept
+    assert(cache.get_embedding("how  does it work ", vec) && vec == (std::vector<float>{1.0f, 2.0f}));
+    assert(!cache.get_embedding("failed", vec));
+
+    // Embeddings outlive commits
+    cache.advance_generation();
+    assert(cache.get_embedding("how does it work", vec) && cache.embedding_hits() == 2);
+    std::cout << "Embedding cache test passed!" << std::endl;
+}
+
+void test_results_and_generations() {
+    std::cout << "Testing result invalidation..." << std::endl;
+    QueryCache cache(10, 10);
+    std::string key = QueryCache::result_key("parse config", 5, {});
+    QueryCache::Result result;
+
+    uint64_t generation = cache.generation();
+    assert(!cache.get_result(key, generation, result));
+    cache.put_result(key, generation, {{3, 1, 2}, "hybrid"});
+    assert(cache.get_result(key, generation, result));
+    assert(result.ids == (std::vector<int64_t>{3, 1, 2}) && result.type == "hybrid");
+
+    // A commit makes every cached result stale
+    cache.advance_generation();
+    assert(cache.generation() == generation + 1);
+    assert(!cache.get_result(key, cache.generation(), result));
+
+    // A search that started before a commit must not be cached
+    uint64_t before = cache.generation();
+    cache.advance_generation();
+    cache.put_result(key, before, {{7}, "keyword"});
+    assert(!cache.get_result(key, cache.generation(), result));
+
+    cache.put_result(key, cache.generation(), {{7}, "keyword"});
+    assert(cache.get_result(key, cache.generation(), result) && result.ids == (std::vector<int64_t>{7}));
+    assert(cache.result_hits() == 2 && cache.misses() == 3);
+    std::cout << "Result cache test passed!" << std::endl;
+}
+
+int main() {
+    try {
+        test_lru();
+        test_keys();
+        test_embeddings();
+        test_results_and_generations();
+        std::cout << "All QueryCache tests passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
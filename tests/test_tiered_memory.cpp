@@ -0,0 +1,148 @@
+#include <iostream>
+#include <filesystem>
+#include <cassert>
+#include <cmath>
+#include <mutex>
+#include <random>
+#include "engine/database.hpp"
+#include "engine/tiered_memory.hpp"
+#include "engine/vector_kernels.hpp"
+
+using namespace kestr::engine;
+
+void test_kernels() {
+    std::cout << "Testing vector kernels (" << kernels::name() << ")..." << std::endl;
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    for (size_t dim : {1, 7, 8, 15, 16, 33, 384}) {
+        std::vector<float> a(dim), b(dim);
+        for (size_t i = 0; i < dim; ++i) { a[i] = dist(rng); b[i] = dist(rng); }
+        double dot = 0.0, l2 = 0.0;
+        for (size_t i = 0; i < dim; ++i) {
+            dot += a[i] * b[i];
+            l2 += (a[i] - b[i]) * (a[i] - b[i]);
+        }
+        assert(std::abs(kernels::dot(a.data(), b.data(), dim) - dot) < 1e-3);
+        assert(std::abs(kernels::l2_squared(a.data(), b.data(), dim) - l2) < 1e-3);
+    }
+    std::cout << "Vector kernel test passed!" << std::endl;
+}
+
+void test_tiers() {
+    std::cout << "Testing hot/cold tiers..." << std::endl;
+    std::filesystem::path db_path = "test_tiers.db";
+    std::filesystem::path snap_dir = "test_tiers_snapshots";
+    std::filesystem::remove(db_path);
+    std::filesystem::remove_all(snap_dir);
+    std::filesystem::create_directories(snap_dir);
+
+    Database db;
+    assert(db.open(db_path));
+    std::mutex db_mutex;
+
+    // 20 chunks along distinct directions; the first 4 go to RAM
+    FileInfo info;
+    info.path = "/p/a.cpp";
+    info.hash = "h";
+    info.size = 1;
+    info.last_write_time = std::filesystem::file_time_type::clock::now();
+    info.project_root = "/p";
+    assert(db.update_file(info));
+    std::vector<Chunk> chunks(20);
+    std::vector<std::vector<float>> vectors(20, std::vector<float>(20, 0.0f));
+    for (size_t i = 0; i < 20; ++i) {
+        chunks[i].content = "chunk " + std::to_string(i);
+        chunks[i].start_line = chunks[i].end_line = static_cast<int>(i) + 1;
+        chunks[i].project_root = "/p";
+        vectors[i][i] = 1.0f;
+    }
+    auto ids = db.insert_chunks(info.path, chunks, vectors);
+    assert(ids.size() == 20);
+
+    // Paged scans visit every row once
+    std::vector<int64_t> paged;
+    int64_t after = 0;
+    size_t pages = 0;
+    for (size_t visited = 7; visited == 7; ++pages) {
+        visited = db.for_each_embedding({}, [&](int64_t id, const float*, size_t) { paged.push_back(after = id); }, after, 7);
+    }
+    assert(pages == 3 && paged == ids);
+
+    // A chunk the embedder failed on is in neither tier
+    Chunk bare;
+    bare.content = "no vector";
+    bare.project_root = "/p";
+    auto bare_ids = db.insert_chunks(info.path, {bare}, {{}});
+    assert(bare_ids.size() == 1);
+
+    LibrarianShards shards([](const std::string&, size_t) { return std::make_unique<Librarian>(20, 16, false, std::nullopt, Metric::Cosine); }, snap_dir, 2);
+    for (size_t i = 0; i < 20; ++i) shards.set_attributes(ids[i], chunks[i]);
+    for (size_t i = 0; i < 4; ++i) shards.add_item(ids[i], vectors[i]);
+
+    TieredMemory tiers(shards, db, db_mutex, Metric::Cosine, 4);
+    tiers.seed();
+    assert(tiers.hot_count() == 4);
+    assert(tiers.cold_count() == 16);
+
+    // A cold item is found by the scan, with the score the hot tier would give it
+    auto hits = tiers.search(vectors[10], 1);
+    assert(hits.size() == 1 && hits[0].id == static_cast<size_t>(ids[10]));
+    assert(std::abs(hits[0].score - 1.0f) < 1e-4);
+    auto hot_hit = tiers.search(vectors[1], 1);
+    assert(hot_hit.size() == 1 && hot_hit[0].id == static_cast<size_t>(ids[1]));
+    assert(std::abs(hot_hit[0].score - 1.0f) < 1e-4);
+
+    // Filters apply to the cold scan as well
+    SearchFilters other;
+    other.scope = "/q";
+    assert(tiers.search(vectors[10], 1, other).empty());
+
+    // Item 1 was hit twice (seed + query), so the promotion of 10 evicts another one
+    assert(tiers.rebalance() == 2);
+    assert(tiers.hot_count() == 4);
+    assert(shards.count() == 4);
+    hits = shards.search_scored(vectors[10], 1);
+    assert(hits.size() == 1 && hits[0].id == static_cast<size_t>(ids[10]));
+    hits = shards.search_scored(vectors[1], 1);
+    assert(hits.size() == 1 && hits[0].id == static_cast<size_t>(ids[1]));
+
+    // Evicted items are still found through the cold tier
+    size_t found = 0;
+    for (size_t i = 0; i < 20; ++i) {
+        hits = tiers.search(vectors[i], 1);
+        found += hits.size() == 1 && hits[0].id == static_cast<size_t>(ids[i]);
+    }
+    assert(found == 20);
+
+    // Removals leave the policy
+    tiers.record_remove(ids[10]);
+    shards.remove_item(ids[10]);
+    assert(tiers.hot_count() == 3);
+    tiers.rebalance();
+    assert(tiers.hot_count() <= 4);
+    assert(tiers.hot_count() + tiers.cold_count() == 19);
+
+    // So do cold ones
+    size_t cold_index = 0;
+    while (shards.search_scored(vectors[cold_index], 1)[0].id == static_cast<size_t>(ids[cold_index])) ++cold_index;
+    tiers.record_remove(ids[cold_index]);
+    assert(tiers.hot_count() + tiers.cold_count() == 18);
+    tiers.record_remove(bare_ids[0]);
+    assert(tiers.hot_count() + tiers.cold_count() == 18);
+
+    std::filesystem::remove(db_path);
+    std::filesystem::remove_all(snap_dir);
+    std::cout << "Hot/cold tier test passed!" << std::endl;
+}
+
+int main() {
+    try {
+        test_kernels();
+        test_tiers();
+        std::cout << "All TieredMemory tests passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,156 @@
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <cassert>
+#include <random>
+#include <sstream>
+#include <algorithm>
+#include <unordered_map>
+#include "engine/tokenizer.hpp"
+
+using namespace kestr::engine;
+
+// The hash-map tokenizer this one replaced, kept as the reference for its output
+std::vector<int64_t> reference_encode(const std::unordered_map<std::string, int64_t>& vocab, const std::string& text, size_t max_length) {
+    std::vector<int64_t> ids{101};
+    std::string normalized = text;
+    std::transform(normalized.begin(), normalized.end(), normalized.begin(), [](unsigned char c) { return std::tolower(c); });
+    std::stringstream ss(normalized);
+    std::string word;
+    while (ss >> word) {
+        word.erase(std::remove_if(word.begin(), word.end(), ::ispunct), word.end());
+        if (word.empty()) continue;
+        if (word.length() > 100) word = "[UNK]";
+        bool is_bad = false;
+        size_t start = 0;
+        std::vector<int64_t> sub_tokens;
+        while (start < word.length()) {
+            size_t end = word.length();
+            int64_t cur = -1;
+            while (start < end) {
+                std::string substr = word.substr(start, end - start);
+                if (start > 0) substr = "##" + substr;
+                auto it = vocab.find(substr);
+                if (it != vocab.end()) {
+                    cur = it->second;
+                    break;
+                }
+                end--;
+            }
+            if (cur == -1) {
+                is_bad = true;
+                break;
+            }
+            sub_tokens.push_back(cur);
+            start = end;
+        }
+        if (is_bad) ids.push_back(100);
+        else ids.insert(ids.end(), sub_tokens.begin(), sub_tokens.end());
+        if (ids.size() >= max_length - 1) break;
+    }
+    if (ids.size() >= max_length) ids.resize(max_length - 1);
+    ids.push_back(102);
+    return ids;
+}
+
+std::vector<std::string> make_vocab() {
+    std::vector<std::string> vocab{"[PAD]"};
+    for (int i = 1; i < 100; ++i) vocab.push_back("[unused" + std::to_string(i) + "]");
+    vocab.insert(vocab.end(), {"[UNK]", "[CLS]", "[SEP]", "[MASK]"});
+    for (const char* w : {"the", "token", "tokenizer", "izer", "int", "return", "class", "struct", "a", "b", "c",
+                          "un", "##s", "##izer", "##ize", "##r", "##a", "##b", "##c", "##ab", "##abc", "##2", "1", "2",
+                          "foo", "##foo", "bar", "##bar", "caf\xc3\xa9", "##\xc3\xa9"}) {
+        vocab.push_back(w);
+    }
+    return vocab;
+}
+
+std::filesystem::path write_vocab(const std::vector<std::string>& vocab) {
+    std::filesystem::path path = "test_vocab.txt";
+    std::ofstream out(path);
+    for (const auto& w : vocab) out << w << "\r\n"; // CRLF like the downloaded vocab files
+    return path;
+}
+
+void test_matches_reference() {
+    std::cout << "Testing against the reference tokenizer..." << std::endl;
+    auto vocab = make_vocab();
+    auto path = write_vocab(vocab);
+    Tokenizer tokenizer(path.string());
+    assert(tokenizer.vocab_size() == vocab.size());
+    assert(tokenizer.id("tokenizer") == 106 && tokenizer.id("token") == 105 && tokenizer.id("tok") == -1);
+
+    std::unordered_map<std::string, int64_t> map;
+    for (size_t i = 0; i < vocab.size(); ++i) map[vocab[i]] = static_cast<int64_t>(i);
+
+    std::vector<std::string> fixed{
+        "", "   ", "The Tokenizer", "tokenizers tokenize", "int foo(bar) { return a.b; }", "un-abc abcabc",
+        "Caf\xc3\xa9 caf\xc3\xa9\xc3\xa9", "zzz foo", std::string(150, 'a'), std::string(100, 'b') + "!!!",
+        "foo\tbar\nbaz\r\n", "\xff\xfe weird bytes"};
+
+    const char alphabet[] = "abcABCfoobar12 .,;(){}#\t\n\xc3\xa9";
+    std::mt19937 rng(7);
+    std::vector<std::string> texts = fixed;
+    for (int n = 0; n < 2000; ++n) {
+        std::string t(rng() % 300, ' ');
+        for (char& c : t) c = alphabet[rng() % (sizeof(alphabet) - 1)];
+        texts.push_back(t);
+    }
+
+    std::vector<int64_t> ids;
+    for (const auto& text : texts) {
+        for (size_t max_length : {512, 8, 2}) {
+            tokenizer.encode(text, ids, nullptr, max_length);
+            assert(ids == reference_encode(map, text, max_length));
+        }
+    }
+    std::filesystem::remove(path);
+    std::cout << "Reference test passed!" << std::endl;
+}
+
+void test_offsets() {
+    std::cout << "Testing offsets..." << std::endl;
+    auto path = write_vocab(make_vocab());
+    Tokenizer tokenizer(path.string());
+
+    std::string text = "  Tokenizers, zzz foo.bar";
+    std::vector<int64_t> ids;
+    std::vector<Tokenizer::Offset> offsets;
+    size_t n = tokenizer.encode(text, ids, &offsets);
+    assert(n == ids.size() && offsets.size() == ids.size());
+
+    // [CLS] tokenizer ##s [UNK] foo ##bar [SEP]
+    assert(ids == (std::vector<int64_t>{101, 106, 116, 100, 128, 131, 102}));
+    assert(offsets[0] == Tokenizer::Offset(0, 0) && offsets.back() == Tokenizer::Offset(0, 0));
+    auto piece = [&](size_t i) { return text.substr(offsets[i].first, offsets[i].second - offsets[i].first); };
+    assert(piece(1) == "Tokenizer" && piece(2) == "s" && piece(3) == "zzz");
+    // Pieces skip the dropped punctuation
+    assert(piece(4) == "foo" && piece(5) == "bar");
+
+    // The buffers are reused, not appended to
+    tokenizer.encode("foo", ids, &offsets);
+    assert(ids.size() == 3 && offsets.size() == 3);
+    std::filesystem::remove(path);
+    std::cout << "Offset test passed!" << std::endl;
+}
+
+void test_missing_vocab() {
+    std::cout << "Testing a missing vocab..." << std::endl;
+    Tokenizer tokenizer("does_not_exist.txt");
+    assert(tokenizer.vocab_size() == 0);
+    assert(tokenizer.encode("hello world") == (std::vector<int64_t>{101, 100, 100, 102}));
+    std::cout << "Missing vocab test passed!" << std::endl;
+}
+
+int main() {
+    try {
+        test_matches_reference();
+        test_offsets();
+        test_missing_vocab();
+        std::cout << "All Tokenizer tests passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}